@@ -1,89 +1,117 @@
 #include "Arduino.h"
 #include "AT24C32.h"
-#include <Wire.h>
 
 AT24C32::AT24C32(int device)
+: _job(0x50 + (device & 0x07), &(AT24C32::_next), this),
+_address(0),
+_data(NULL),
+_count(0),
+_offset(0),
+_byte(0),
+_busy(false),
+_restart(false),
+_status(TWI_IDLE)
 {
-  device_address = 0x50 + (device & 0x07);
+  _job.regLen = 2;
+  _job.retries = AT24C32_RETRIES;
 }
 
-void
-AT24C32::setAddress(uint16_t address)
+uint8_t
+AT24C32::readByte(uint16_t address)
 {
-  Wire.beginTransmission(device_address);
-  Wire.write(address >> 8);
-  Wire.write(address & 0xff);
+  uint8_t data = 0xff;
+  readBytes(address, &data, 1);
+  return data;
 }
 
+/*
+ * Reads count bytes, waiting for them.  Sequential reads run on
+ * across pages.  Returns the number read, 0 on an error.
+ */
 uint8_t
-AT24C32::readNextByte(void)
+AT24C32::readBytes(uint16_t address, void * data, uint8_t count)
 {
-  uint16_t data = WIRE_ERROR;
-  uint8_t rdata;
-  Wire.requestFrom(device_address, (uint8_t)1);
-  if (Wire.available()) {
-    rdata = Wire.read();
-    data = rdata;
+  TwiJob job(_job.address);
+  while (_busy)
+    ;
+  job.reg[0] = address >> 8;
+  job.reg[1] = address & 0xff;
+  job.regLen = 2;
+  job.rx = (uint8_t *)data;
+  job.rxLen = count;
+  job.retries = AT24C32_RETRIES;
+  TwiBus.add(&job);
+  if (TwiBus.wait(&job) != TWI_DONE) {
+    return 0;
   }
-  return data;
+  return count;
 }
 
 uint8_t
-AT24C32::readByte(uint16_t address)
+AT24C32::writeByte(uint16_t address, uint8_t data)
 {
-  setAddress(address);
-  Wire.endTransmission();
-  return readNextByte();
+  while (_busy)
+    ;
+  _byte = data;
+  return writeBytes(address, &_byte, 1);
 }
 
-uint8_t
-AT24C32::readBytes(uint16_t address, void * data, uint8_t count)
+uint16_t
+AT24C32::writeBytes(uint16_t address, const void * data, uint8_t count)
 {
-  uint16_t read = 0;
-  for (int i = 0; i < count; i+=32) {
-    uint8_t rcount = 32;
-    if (count < (i+32)) {
-      rcount = count - i;
-    }
-    setAddress(address);
-    Wire.endTransmission();
-    Wire.requestFrom(device_address, rcount);
-    uint8_t * ptr = (uint8_t *)data + i;
-    while (Wire.available()) {
-      read++;
-      *ptr++ = Wire.read();
-      address++;
-    }
+  uint8_t sreg;
+  if (! count) {
+    return 0;
   }
-  return read;
+  sreg = SREG;
+  cli();
+  _address = address;
+  _data = (const uint8_t *)data;
+  _count = count;
+  if (_busy) {
+    _restart = true;
+  } else {
+    _busy = true;
+    _offset = 0;
+    _page();
+  }
+  SREG = sreg;
+  return count;
 }
 
-uint8_t
-AT24C32::writeByte(uint16_t address, uint8_t data)
+// Queues the page from _offset, up to the end of the chip's page
+void
+AT24C32::_page(void)
 {
-  uint8_t count;
-  setAddress(address);
-  count = Wire.write(data);
-  Wire.endTransmission();
-  return count;
+  uint16_t address = _address + _offset;
+  uint8_t len = AT24C32_PAGE - (address & (AT24C32_PAGE - 1));
+  if (len > _count - _offset) {
+    len = _count - _offset;
+  }
+  _job.reg[0] = address >> 8;
+  _job.reg[1] = address & 0xff;
+  _job.tx = _data + _offset;
+  _job.txLen = len;
+  TwiBus.add(&_job);
 }
 
-uint16_t
-AT24C32::writeBytes(uint16_t address, void * data, uint8_t count)
+void
+AT24C32::_next(TwiJob * job)
 {
-  uint16_t written = 0;
-  for (int i = 0; i < count; i+= 32) {
-    int rcount = 32;
-    if (count < (i+32)) {
-      rcount = count - i;
+  AT24C32 * me = (AT24C32 *)job->context;
+  if (me->_restart) {
+    me->_restart = false;
+    me->_offset = 0;
+    me->_page();
+    return;
+  }
+  me->_status = job->status;
+  if (job->status == TWI_DONE) {
+    me->_offset += job->txLen;
+    if (me->_offset < me->_count) {
+      me->_page();
+      return;
     }
-    setAddress(address+i);
-    uint8_t * ptr = (uint8_t *)data + i;
-    written += Wire.write((const uint8_t *)ptr, rcount);
-    Wire.endTransmission();
   }
-  return written;
+  me->_busy = false;
 }
-
-
-
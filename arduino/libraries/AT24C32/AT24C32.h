@@ -1,29 +1,52 @@
 #ifndef _AT24C32_H
 #define _AT24C32_H
 
+#include "Arduino.h"
+#include <TwiQueue.h>
+
 /**
  * Device is based on a 0101 (0x50) address and three address
  * lines, allowing up to eight devices on the one bus. (0x50 to 0x57).
  * The 32k version is 32k bits (4k bytes) organized in 8 bit bytes.
  * "pages" of 32 bytes can also be addressed in a single operation.
+ *
+ * Writes go through the TwiQueue in the background, a page at a time
+ * so none wraps within its page, each page acked once the chip has
+ * finished writing the last.  writeBytes() returns straight away and
+ * data must be left alone until busy() is false; a write started
+ * while another is going replaces it, starting again from the
+ * beginning once the page under way is done.  Reads wait for the bus
+ * and are meant for start up.
  */
 
-const uint16_t WIRE_ERROR = 0xffff;
+#define AT24C32_PAGE 32
+// Address tries while a page is written, at least 5ms even at 400kHz
+#define AT24C32_RETRIES 255
 
 class AT24C32 {
 
   private:
-    uint8_t device_address;
+    static void _next(TwiJob * job);
+    void _page(void);
 
+    TwiJob _job;
+    uint16_t _address;
+    const uint8_t * _data;
+    uint8_t _count;
+    uint8_t _offset;
+    uint8_t _byte;
+    volatile bool _busy;
+    volatile bool _restart;
+    volatile uint8_t _status;
 
   public:
     AT24C32(int device = 0);
-    void setAddress(uint16_t address);
     uint8_t readByte(uint16_t address);
     uint8_t readBytes(uint16_t address, void * data, uint8_t count);
-    uint8_t readNextByte(void);
 
     uint8_t writeByte(uint16_t address, uint8_t data);
-    uint16_t writeBytes(uint16_t address, void * data, uint8_t count);
+    uint16_t writeBytes(uint16_t address, const void * data, uint8_t count);
+    bool busy(void) { return _busy; }
+    uint8_t status(void) { return _status; }
 };
 #endif // _AT24C32_H
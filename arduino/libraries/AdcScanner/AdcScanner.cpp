@@ -0,0 +1,149 @@
+/* Background ADC scanning with oversampling.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "AdcScanner.h"
+
+AdcScanner AdcScan;
+
+AdcScanner::AdcScanner(void)
+: _count(0),
+_current(0),
+_reference(DEFAULT)
+{
+}
+
+/*
+ * Adds pin (A0 or 0 both mean channel 0) to the scan, averaging
+ * 4^bits samples for each value.  Returns the channel number for
+ * read(), or ADC_SCAN_NONE if there's no room.
+ */
+uint8_t
+AdcScanner::add(uint8_t pin, uint8_t bits)
+{
+  adc_channel_t * c;
+  if (_count >= ADC_SCAN_CHANNELS) {
+    return ADC_SCAN_NONE;
+  }
+  if (pin >= A0) {
+    pin -= A0;
+  }
+  if (bits > ADC_SCAN_MAX_BITS) {
+    bits = ADC_SCAN_MAX_BITS;
+  }
+  c = &_channels[_count];
+  c->mux = pin & 0x07;
+  c->bits = bits;
+  c->samples = 0;
+  c->sum = 0;
+  c->value = 0;
+  c->count = 0;
+  return _count++;
+}
+
+/*
+ * Starts the scan.  reference is as for analogReference().  The
+ * prescaler is the same clk/128 as analogRead uses at 16MHz, keeping
+ * the ADC clock in the 50-200kHz it wants for 10 bits.
+ */
+void
+AdcScanner::begin(uint8_t reference)
+{
+  if (! _count) {
+    return;
+  }
+  _reference = reference;
+  _current = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_channels[i].mux < 6) {
+      DIDR0 |= _BV(_channels[i].mux);
+    }
+  }
+  ADMUX = (_reference << 6) | _channels[0].mux;
+  ADCSRB = 0;
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+// Stops after the conversion under way, analogRead works again
+void
+AdcScanner::end(void)
+{
+  ADCSRA &= ~_BV(ADIE);
+  while (ADCSRA & _BV(ADSC))
+    ;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_channels[i].mux < 6) {
+      DIDR0 &= ~_BV(_channels[i].mux);
+    }
+  }
+}
+
+// The latest value, 10 + bits(channel) wide
+uint16_t
+AdcScanner::read(uint8_t channel)
+{
+  uint16_t value;
+  uint8_t sreg = SREG;
+  cli();
+  value = _channels[channel].value;
+  SREG = sreg;
+  return value;
+}
+
+// The latest value scaled to width bits
+uint16_t
+AdcScanner::read(uint8_t channel, uint8_t width)
+{
+  uint8_t have = 10 + _channels[channel].bits;
+  uint16_t value = read(channel);
+  if (width < have) {
+    return value >> (have - width);
+  }
+  return value << (width - have);
+}
+
+// Values published so far, wrapping
+uint16_t
+AdcScanner::count(uint8_t channel)
+{
+  uint16_t n;
+  uint8_t sreg = SREG;
+  cli();
+  n = _channels[channel].count;
+  SREG = sreg;
+  return n;
+}
+
+/*
+ * The multiplexer is switched as soon as a conversion ends, well
+ * ahead of the next sample and hold 1.5 ADC clocks after ADSC.
+ */
+void
+AdcScanner::_convert(void)
+{
+  adc_channel_t * c = &_channels[_current];
+  uint16_t sample = ADC;
+
+  if (++_current >= _count) {
+    _current = 0;
+  }
+  ADMUX = (_reference << 6) | _channels[_current].mux;
+  ADCSRA |= _BV(ADSC);
+
+  c->sum += sample;
+  if (++c->samples >= (1U << (2 * c->bits))) {
+    c->value = c->sum >> c->bits;
+    c->count++;
+    c->sum = 0;
+    c->samples = 0;
+  }
+}
+
+ISR(ADC_vect) {
+  AdcScan._convert();
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,73 @@
+#ifndef _ADC_SCANNER_H
+#define _ADC_SCANNER_H
+
+#include "Arduino.h"
+
+/**
+ * Background ADC scanning with oversampling.
+ *
+ * analogRead waits about 110us for each conversion and gives one
+ * noisy sample.  Here the ADC conversion complete interrupt stores
+ * each result, moves to the next channel and starts the next
+ * conversion, so the ADC runs all the time (about 9600 conversions
+ * a second at 16MHz, shared between the channels) and nothing waits.
+ *
+ * Each channel adds up 4^bits samples and then publishes the sum
+ * shifted down by bits, a value 10 + bits wide.  Averaging 4^n
+ * samples and keeping n extra bits is the usual oversampling and
+ * decimation: the noise is dithering enough for the extra bits to
+ * mean something.  So 2 bits is 16 samples for a 12 bit value.
+ *
+ *   uint8_t level = AdcScan.add(A0, 2);
+ *   AdcScan.begin();
+ *   ...
+ *   depth = AdcScan.read(level);      // 0-4095
+ *   light = AdcScan.read(level, 10);  // scaled to 0-1023
+ *
+ * read() returns 0 until the first value is in; count() tells when
+ * it is.  Don't use analogRead while the scanner runs.  The digital
+ * input buffers on A0-A5 scanned pins are turned off (DIDR0) to save
+ * a little power and noise, so don't digitalRead them either.
+ */
+
+#ifndef ADC_SCAN_CHANNELS
+#define ADC_SCAN_CHANNELS 4
+#endif
+// Up to 4^6 samples, keeping the sum in 32 bits
+#define ADC_SCAN_MAX_BITS 6
+#define ADC_SCAN_NONE 0xff
+
+typedef struct _adc_channel_t {
+  uint8_t mux;
+  uint8_t bits;
+  uint16_t samples;
+  uint32_t sum;
+  uint16_t value;
+  uint16_t count;
+} adc_channel_t;
+
+class AdcScanner {
+  public:
+    AdcScanner(void);
+    uint8_t add(uint8_t pin, uint8_t bits = 2);
+    void begin(uint8_t reference = DEFAULT);
+    void end(void);
+    uint16_t read(uint8_t channel);
+    uint16_t read(uint8_t channel, uint8_t width);
+    uint16_t count(uint8_t channel);
+    uint8_t bits(uint8_t channel) { return _channels[channel].bits; }
+
+    // Called from the ADC interrupt
+    void _convert(void);
+
+  private:
+    adc_channel_t _channels[ADC_SCAN_CHANNELS];
+    uint8_t _count;
+    uint8_t _current;
+    uint8_t _reference;
+};
+
+extern AdcScanner AdcScan;
+
+#endif // _ADC_SCANNER_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,314 @@
+/* Interrupt driven serial port on timer1.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ *
+ * Timer1 free runs at the CPU clock (clk/8 for slow rates).  Everything is done in timer
+ * ticks, with the 16 bit counter wrapping harmlessly as long as
+ * differences are taken with unsigned arithmetic.
+ *
+ * Receive: the first falling edge is a start bit.  From then on each
+ * captured edge tells us that every bit centre before it had the old
+ * level.  Compare B fires after the last bit centre of the frame to
+ * pick up any trailing bits that had no edge.
+ *
+ * Transmit: the frame is shifted out by programming compare A to set
+ * or clear OC1A at the next point the level changes, so runs of
+ * identical bits cost one interrupt.
+ */
+
+#include "Arduino.h"
+#include "CaptureSerial.h"
+
+#define _COMPA_CLEAR() (TCCR1A = (TCCR1A & ~_BV(COM1A0)) | _BV(COM1A1))
+#define _COMPA_SET() (TCCR1A |= _BV(COM1A1) | _BV(COM1A0))
+#define _CAPTURE_FALLING() (TCCR1B &= ~_BV(ICES1))
+#define _CAPTURE_RISING() (TCCR1B |= _BV(ICES1))
+#define _CAPTURING_RISING() (TCCR1B & _BV(ICES1))
+
+static uint16_t _ticksPerBit;
+
+static volatile uint8_t _rxBuffer[CAPTURE_SERIAL_RX_BUFFER];
+static volatile uint8_t _rxHead;
+static volatile uint8_t _rxTail;
+static uint8_t _rxState; // 0 idle, otherwise 1 + bits received
+static uint8_t _rxByte;
+static uint8_t _rxLevel;
+static uint16_t _rxTarget;
+static volatile uint16_t _rxOverflows;
+static volatile uint16_t _rxFramingErrors;
+
+static volatile uint8_t _txBuffer[CAPTURE_SERIAL_TX_BUFFER];
+static volatile uint8_t _txHead;
+static volatile uint8_t _txTail;
+static volatile bool _txActive;
+static uint16_t _txFrame;
+static uint8_t _txBits;
+
+CaptureSerial::CaptureSerial(void)
+{
+}
+
+void
+CaptureSerial::begin(unsigned long baud) {
+  uint8_t sreg = SREG;
+  uint8_t prescale = _BV(CS10);
+
+  /* Edges are compared as signed 16 bit tick differences, so a whole
+   * character has to fit in 32k ticks; slow rates count at clk/8 */
+  _ticksPerBit = (F_CPU + baud / 2) / baud;
+  if (F_CPU / baud > 3600) {
+    prescale = _BV(CS11);
+    _ticksPerBit = (F_CPU / 8 + baud / 2) / baud;
+  }
+  cli();
+  _rxHead = _rxTail = 0;
+  _txHead = _txTail = 0;
+  _rxState = 0;
+  _txActive = false;
+  _rxOverflows = 0;
+  _rxFramingErrors = 0;
+
+  pinMode(CAPTURE_SERIAL_RX_PIN, INPUT_PULLUP);
+  // Idle the line high before handing the pin to the timer
+  digitalWrite(CAPTURE_SERIAL_TX_PIN, HIGH);
+  pinMode(CAPTURE_SERIAL_TX_PIN, OUTPUT);
+
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | prescale; // Normal mode, noise canceller
+  _COMPA_SET();
+  TCCR1C = _BV(FOC1A);
+  _CAPTURE_FALLING();
+  TIFR1 = _BV(ICF1) | _BV(OCF1A) | _BV(OCF1B);
+  TIMSK1 = _BV(ICIE1);
+  SREG = sreg;
+}
+
+void
+CaptureSerial::end(void) {
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  digitalWrite(CAPTURE_SERIAL_TX_PIN, HIGH);
+}
+
+int
+CaptureSerial::available(void) {
+  return (uint8_t)(_rxHead + CAPTURE_SERIAL_RX_BUFFER - _rxTail) % CAPTURE_SERIAL_RX_BUFFER;
+}
+
+int
+CaptureSerial::peek(void) {
+  if (_rxHead == _rxTail) {
+    return -1;
+  }
+  return _rxBuffer[_rxTail];
+}
+
+int
+CaptureSerial::read(void) {
+  uint8_t c;
+  if (_rxHead == _rxTail) {
+    return -1;
+  }
+  c = _rxBuffer[_rxTail];
+  _rxTail = (_rxTail + 1) % CAPTURE_SERIAL_RX_BUFFER;
+  return c;
+}
+
+size_t
+CaptureSerial::write(uint8_t byte) {
+  uint8_t next;
+  uint8_t sreg;
+
+  /*
+   * The idle check, the enqueue and the restart are all done with
+   * interrupts off, or the transmit interrupt could go idle between
+   * them and strand the byte.  Interrupts only come back on while
+   * waiting for room.
+   */
+  sreg = SREG;
+  for (;;) {
+    cli();
+    if ( ! _txActive) {
+      _txActive = true;
+      _txFrame = ((uint16_t)byte << 1) | 0x200; // start, 8 data, stop
+      _txBits = 10;
+      _COMPA_CLEAR();
+      OCR1A = TCNT1 + 16;
+      TIFR1 = _BV(OCF1A);
+      TIMSK1 |= _BV(OCIE1A);
+      break;
+    }
+    next = (_txHead + 1) % CAPTURE_SERIAL_TX_BUFFER;
+    if (next != _txTail) {
+      _txBuffer[_txHead] = byte;
+      _txHead = next;
+      break;
+    }
+    // Buffer full, let the interrupt make room
+    SREG = sreg;
+  }
+  SREG = sreg;
+  return 1;
+}
+
+void
+CaptureSerial::flush(void) {
+  while (_txActive) {
+  }
+}
+
+uint16_t
+CaptureSerial::overflows(void) {
+  return _rxOverflows;
+}
+
+uint16_t
+CaptureSerial::framingErrors(void) {
+  return _rxFramingErrors;
+}
+
+static void
+_rxStore(uint8_t c) {
+  uint8_t next = (_rxHead + 1) % CAPTURE_SERIAL_RX_BUFFER;
+  if (next == _rxTail) {
+    _rxOverflows++;
+    return;
+  }
+  _rxBuffer[_rxHead] = c;
+  _rxHead = next;
+}
+
+static void
+_rxStart(uint16_t capture) {
+  // Aim at the centre of the first data bit
+  _rxTarget = capture + _ticksPerBit + _ticksPerBit / 2;
+  _rxState = 1;
+  _rxByte = 0;
+  _rxLevel = 0;
+  _CAPTURE_RISING();
+  // and time out at the centre of the stop bit
+  OCR1B = capture + _ticksPerBit * 9 + _ticksPerBit / 2;
+  TIFR1 = _BV(OCF1B);
+  TIMSK1 |= _BV(OCIE1B);
+}
+
+void
+CaptureSerial::_capture(void) {
+  uint16_t capture = ICR1;
+
+  if (_rxState == 0) {
+    if ( ! _CAPTURING_RISING()) {
+      _rxStart(capture);
+    }
+    return;
+  }
+
+  // Every bit centre before this edge had the old level
+  while ((int16_t)(capture - _rxTarget) >= 0) {
+    if (_rxState > 8) {
+      // Past the stop bit and the timeout hasn't run yet
+      if ( ! _rxLevel) {
+        _rxFramingErrors++;
+      }
+      _rxStore(_rxByte);
+      _rxState = 0;
+      TIMSK1 &= ~_BV(OCIE1B);
+      if (_CAPTURING_RISING()) {
+        _CAPTURE_FALLING();
+      } else {
+        _rxStart(capture);
+      }
+      return;
+    }
+    _rxByte = (_rxByte >> 1) | _rxLevel;
+    _rxTarget += _ticksPerBit;
+    _rxState++;
+  }
+  if (_CAPTURING_RISING()) {
+    _rxLevel = 0x80;
+    _CAPTURE_FALLING();
+  } else {
+    _rxLevel = 0;
+    _CAPTURE_RISING();
+  }
+}
+
+/* End of frame: fill in bits that had no edge */
+void
+CaptureSerial::_rxTimeout(void) {
+  while (_rxState <= 8) {
+    _rxByte = (_rxByte >> 1) | _rxLevel;
+    _rxState++;
+  }
+  if ( ! _rxLevel) {
+    _rxFramingErrors++; // stop bit low
+  }
+  _rxStore(_rxByte);
+  _rxState = 0;
+  TIMSK1 &= ~_BV(OCIE1B);
+  _CAPTURE_FALLING();
+}
+
+void
+CaptureSerial::_transmit(void) {
+  uint16_t target = OCR1A;
+  uint16_t frame = _txFrame;
+  uint8_t bits = _txBits;
+  uint8_t level;
+
+  if (bits == 0) {
+    // The stop bit has finished
+    if (_txHead == _txTail) {
+      TIMSK1 &= ~_BV(OCIE1A);
+      _txActive = false;
+      return;
+    }
+    frame = ((uint16_t)_txBuffer[_txTail] << 1) | 0x200;
+    _txTail = (_txTail + 1) % CAPTURE_SERIAL_TX_BUFFER;
+    _txFrame = frame;
+    _txBits = 10;
+    _COMPA_CLEAR();
+    OCR1A = TCNT1 + 16;
+    return;
+  }
+
+  // The current bit went out at this match; find the next change
+  level = frame & 1;
+  do {
+    frame >>= 1;
+    bits--;
+    target += _ticksPerBit;
+  } while (bits && (frame & 1) == level);
+
+  if (bits == 0 && _txHead != _txTail) {
+    // Run straight on into the next start bit
+    frame = ((uint16_t)_txBuffer[_txTail] << 1) | 0x200;
+    _txTail = (_txTail + 1) % CAPTURE_SERIAL_TX_BUFFER;
+    bits = 10;
+  }
+  if (bits && ! (frame & 1)) {
+    _COMPA_CLEAR();
+  } else {
+    _COMPA_SET();
+  }
+  _txFrame = frame;
+  _txBits = bits;
+  OCR1A = target;
+}
+
+ISR(TIMER1_CAPT_vect) {
+  CaptureSerial::_capture();
+}
+
+ISR(TIMER1_COMPB_vect) {
+  CaptureSerial::_rxTimeout();
+}
+
+ISR(TIMER1_COMPA_vect) {
+  CaptureSerial::_transmit();
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,59 @@
+#ifndef _CAPTURE_SERIAL_H
+#define _CAPTURE_SERIAL_H
+
+#include "Arduino.h"
+
+/**
+ * Interrupt driven serial port on timer1, for talking to an XBee
+ * without SoftwareSerial.
+ *
+ * SoftwareSerial times every bit in software with interrupts
+ * disabled for the whole character, which loses pin change and timer
+ * interrupts and limits it to low rates.  Here receive edges are
+ * timestamped by the input capture unit and transmit edges are
+ * produced by the output compare unit, so the interrupts only have
+ * to be serviced within about a bit time and other interrupts carry
+ * on as normal.  Both directions are buffered.
+ *
+ * Pins are fixed by the hardware (ATmega328P):
+ *   RX - ICP1, digital pin 8 (XBee DOUT)
+ *   TX - OC1A, digital pin 9 (XBee DIN)
+ * Pin 10 (OC1B) is still usable, but not for PWM.  Timer1 is used
+ * exclusively, so this can't be combined with Servo or timer1 PWM.
+ *
+ * Rates from 600 up to 57600 baud work at 16MHz (300 to 38400 at
+ * 8MHz).  Remember to set the XBee rate (ATBD) to match.
+ */
+
+#ifndef CAPTURE_SERIAL_RX_BUFFER
+#define CAPTURE_SERIAL_RX_BUFFER 64
+#endif
+#ifndef CAPTURE_SERIAL_TX_BUFFER
+#define CAPTURE_SERIAL_TX_BUFFER 32
+#endif
+
+#define CAPTURE_SERIAL_RX_PIN 8
+#define CAPTURE_SERIAL_TX_PIN 9
+
+class CaptureSerial : public Stream {
+  public:
+    CaptureSerial(void);
+    void begin(unsigned long baud);
+    void end(void);
+    virtual int available(void);
+    virtual int read(void);
+    virtual int peek(void);
+    virtual void flush(void);
+    virtual size_t write(uint8_t byte);
+    using Print::write;
+    uint16_t overflows(void);
+    uint16_t framingErrors(void);
+
+    // Called from the timer1 interrupts
+    static void _capture(void);
+    static void _rxTimeout(void);
+    static void _transmit(void);
+};
+
+#endif // _CAPTURE_SERIAL_H
+// vim:ai sw=2 expandtab:
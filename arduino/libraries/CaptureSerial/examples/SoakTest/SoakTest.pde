@@ -0,0 +1,127 @@
+/*
+ * Soak test for CaptureSerial.
+ *
+ * Connect pin 9 (TX) to pin 8 (RX).  Numbered XBee style frames
+ * (0x7E, sequence, payload, checksum) are sent continuously and
+ * checked on receipt while timer2 fires a "sensor" interrupt at
+ * about 4kHz that does some work of its own, standing in for pin
+ * change and timer driven sensors.
+ *
+ * Every 10 seconds the frame counts are printed, along with the
+ * sensor interrupt count against what was expected, so loss on
+ * either side shows up.  Compare with SoftwareSerial by swapping the
+ * port over; at 9600 it will typically lose sensor interrupts.
+ */
+#include <CaptureSerial.h>
+
+#define BAUD 38400
+#define PAYLOAD 16
+#define REPORT_MS 10000
+
+CaptureSerial port;
+
+volatile unsigned long sensorTicks = 0;
+volatile uint8_t sensorWork;
+
+unsigned long sent = 0;
+unsigned long good = 0;
+unsigned long bad = 0;
+unsigned long lost = 0;
+uint8_t txSeq = 0;
+uint8_t rxSeq = 0;
+uint8_t frame[PAYLOAD + 3];
+uint8_t rxPos = 0;
+unsigned long lastReport;
+unsigned long ticksAtReport;
+
+ISR(TIMER2_COMPA_vect) {
+  // Roughly 20us of work, as a sensor ISR might do
+  for (uint8_t i = 0; i < 40; i++) {
+    sensorWork += i;
+  }
+  sensorTicks++;
+}
+
+void sendFrame(void) {
+  uint8_t sum = txSeq;
+  port.write(0x7e);
+  port.write(txSeq);
+  for (uint8_t i = 0; i < PAYLOAD; i++) {
+    uint8_t b = txSeq + i * 37;
+    port.write(b);
+    sum += b;
+  }
+  port.write(0xff - sum);
+  txSeq++;
+  sent++;
+}
+
+void checkFrame(void) {
+  uint8_t sum = 0;
+  for (uint8_t i = 1; i < PAYLOAD + 3; i++) {
+    sum += frame[i];
+  }
+  if (sum != 0xff) {
+    bad++;
+    return;
+  }
+  lost += (uint8_t)(frame[1] - rxSeq);
+  rxSeq = frame[1] + 1;
+  good++;
+}
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println(F("Starting"));
+  port.begin(BAUD);
+
+  // Timer2 CTC at 16MHz / 64 / 62 = ~4kHz
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS22);
+  OCR2A = 61;
+  TIMSK2 = _BV(OCIE2A);
+
+  lastReport = millis();
+  ticksAtReport = sensorTicks;
+}
+
+void loop() {
+  int c;
+  sendFrame();
+  while ((c = port.read()) >= 0) {
+    if (c == 0x7e && rxPos != 0) {
+      bad++; // short frame
+      rxPos = 0;
+    }
+    if (rxPos == 0 && c != 0x7e) {
+      continue;
+    }
+    frame[rxPos++] = c;
+    if (rxPos == sizeof(frame)) {
+      checkFrame();
+      rxPos = 0;
+    }
+  }
+  if (millis() - lastReport >= REPORT_MS) {
+    unsigned long ticks = sensorTicks;
+    unsigned long expected = (millis() - lastReport) * (F_CPU / 64 / 62) / 1000;
+    Serial.print(F("sent:"));
+    Serial.print(sent);
+    Serial.print(F(" good:"));
+    Serial.print(good);
+    Serial.print(F(" bad:"));
+    Serial.print(bad);
+    Serial.print(F(" lost:"));
+    Serial.print(lost);
+    Serial.print(F(" overflow:"));
+    Serial.print(port.overflows());
+    Serial.print(F(" framing:"));
+    Serial.print(port.framingErrors());
+    Serial.print(F(" sensor:"));
+    Serial.print(ticks - ticksAtReport);
+    Serial.print('/');
+    Serial.println(expected);
+    lastReport = millis();
+    ticksAtReport = ticks;
+  }
+}
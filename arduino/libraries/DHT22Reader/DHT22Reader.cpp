@@ -0,0 +1,209 @@
+/* Interrupt driven DHT22 reader.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "DHT22Reader.h"
+
+#define DHT22_IDLE 0
+#define DHT22_STARTING 1
+#define DHT22_LISTENING 2
+
+DHT22Decoder::DHT22Decoder(void)
+{
+  reset();
+  status = DHT22_NO_REPLY;
+}
+
+void
+DHT22Decoder::reset(void)
+{
+  _edges = 0;
+  status = DHT22_BUSY;
+  memset(data, 0, sizeof(data));
+}
+
+/*
+ * The first edge is the sensor pulling the line low in reply, timed
+ * from when we let go of it, so its interval is ignored.  The second
+ * ends the ack and the next 40 each end a bit.
+ */
+bool
+DHT22Decoder::edge(uint16_t us)
+{
+  uint8_t bit;
+  if (finished()) {
+    return true;
+  }
+  if (_edges == 0) {
+    _edges++;
+    return false;
+  }
+  if (_edges == 1) {
+    if (us < DHT22_ACK_MIN_US || us > DHT22_ACK_MAX_US) {
+      status = DHT22_BAD_ACK;
+      _edges = DHT22_BITS + 2;
+      return true;
+    }
+    _edges++;
+    return false;
+  }
+  if (us < DHT22_BIT_MIN_US || us > DHT22_BIT_MAX_US) {
+    status = DHT22_BAD_BIT;
+    _edges = DHT22_BITS + 2;
+    return true;
+  }
+  bit = _edges - 2;
+  data[bit >> 3] <<= 1;
+  if (us >= DHT22_ONE_US) {
+    data[bit >> 3] |= 1;
+  }
+  if (++_edges <= DHT22_BITS + 1) {
+    return false;
+  }
+  if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) {
+    status = DHT22_CHECKSUM;
+  } else {
+    status = DHT22_OK;
+  }
+  return true;
+}
+
+// Sign and magnitude, in tenths
+int16_t
+DHT22Decoder::temperature(void)
+{
+  int16_t t = ((data[2] & 0x7f) << 8) | data[3];
+  return (data[2] & 0x80) ? -t : t;
+}
+
+int16_t
+DHT22Decoder::humidity(void)
+{
+  return (data[0] << 8) | data[1];
+}
+
+DHT22Reader::DHT22Reader(uint8_t pin)
+: Task(DHT22_START_MS, &(DHT22Reader::step)),
+_pin(pin),
+_state(DHT22_IDLE),
+_ready(false),
+_requested(false),
+_started(0),
+_last(0)
+{
+}
+
+void
+DHT22Reader::begin(void)
+{
+  pinMode(_pin, INPUT_PULLUP);
+  PciManager.registerListener(_pin, this);
+}
+
+/*
+ * Pulls the line low to wake the sensor.  Returns false if a reading
+ * is under way or the last was too recent.
+ */
+bool
+DHT22Reader::request(void)
+{
+  if (_state != DHT22_IDLE
+      || (_requested && millis() - _started < DHT22_MIN_INTERVAL_MS)) {
+    return false;
+  }
+  _requested = true;
+  _ready = false;
+  _decoder.reset();
+  _started = millis();
+  _state = DHT22_STARTING;
+  digitalWrite(_pin, LOW);
+  pinMode(_pin, OUTPUT);
+  setPeriodMs(DHT22_START_MS);
+  SoftTimer.add(this);
+  return true;
+}
+
+// True once for each finished reading
+bool
+DHT22Reader::ready(void)
+{
+  if (_ready) {
+    _ready = false;
+    return true;
+  }
+  return false;
+}
+
+int16_t
+DHT22Reader::read(uint8_t channel)
+{
+  return channel == DHT22_HUMIDITY ? _decoder.humidity() : _decoder.temperature();
+}
+
+void
+DHT22Reader::_finish(uint8_t status)
+{
+  if (status != DHT22_OK) {
+    _decoder.status = status;
+  }
+  _state = DHT22_IDLE;
+  _ready = true;
+}
+
+/*
+ * Ends the start pulse, then times out the reply.  The interrupt
+ * finishing first just leaves the task to take itself off.
+ */
+void
+DHT22Reader::step(Task * task)
+{
+  DHT22Reader * me = (DHT22Reader *)task;
+  uint8_t sreg;
+  switch (me->_state) {
+    case DHT22_STARTING:
+      // The first call can come straight after the add
+      if (millis() - me->_started < DHT22_START_MS) {
+        return;
+      }
+      sreg = SREG;
+      cli();
+      pinMode(me->_pin, INPUT_PULLUP);
+      me->_last = micros();
+      me->_state = DHT22_LISTENING;
+      SREG = sreg;
+      me->_started = millis();
+      me->setPeriodMs(DHT22_TIMEOUT_MS);
+      return;
+    case DHT22_LISTENING:
+      if (millis() - me->_started < DHT22_TIMEOUT_MS) {
+        return;
+      }
+      sreg = SREG;
+      cli();
+      if (me->_state == DHT22_LISTENING) {
+        me->_finish(DHT22_NO_REPLY);
+      }
+      SREG = sreg;
+      break;
+  }
+  SoftTimer.remove(me);
+}
+
+void
+DHT22Reader::pciHandleInterrupt(byte vect)
+{
+  unsigned long now = micros();
+  unsigned long us = now - _last;
+  if (_state != DHT22_LISTENING || digitalRead(_pin) == HIGH) {
+    return;
+  }
+  if (_decoder.edge(us > 0xffff ? 0xffff : us)) {
+    _finish(_decoder.status);
+  }
+  _last = now;
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,115 @@
+#ifndef _DHT22_READER_H
+#define _DHT22_READER_H
+
+#include "Arduino.h"
+#include <SoftTimer.h>
+#include <PciManager.h>
+#include <PciListener.h>
+
+/**
+ * Interrupt driven DHT22 (AM2302) reader.
+ *
+ * The DHT22 library bit-bangs the 40 bit reply with timing loops and
+ * interrupts off for about 5ms.  Here request() pulls the line low
+ * and returns; the reader, a SoftTimer task, lets the line go after
+ * DHT22_START_MS and the reply is decoded in the pin change
+ * interrupt from the time between falling edges:
+ *
+ *   ack      80us low + 80us high   ~160us
+ *   0 bit    50us low + 26us high    ~76us
+ *   1 bit    50us low + 70us high   ~120us
+ *
+ * so anything under DHT22_ONE_US is a 0.  Only falling edges are
+ * timed, so a rising edge handled late costs nothing.  A falling edge
+ * missed altogether joins two bits into one too long for
+ * DHT22_BIT_MAX_US, or leaves the reply a bit short.
+ *
+ * Like the DS18B20s, a reading is requested and picked up later:
+ *
+ *   dht.request();
+ *   ...
+ *   if (dht.ready()) {
+ *     t = dht.read(DHT22_TEMPERATURE);
+ *   }
+ *
+ * ready() is true once for each reading, good or not; status() then
+ * says which.  Values are in tenths, of a degree C or a percent.
+ *
+ * The decoding is in DHT22Decoder so recorded pulse trains can be
+ * replayed through it on the host, see arduino/tests/dht22_replay.cpp.
+ */
+
+// Host start pulse, the datasheet wants at least 1ms
+#define DHT22_START_MS 2
+// Whole reply, from letting the line go
+#define DHT22_TIMEOUT_MS 10
+// The sensor needs 2s between readings
+#define DHT22_MIN_INTERVAL_MS 2000
+
+// Falling edge to falling edge limits, in microseconds
+#define DHT22_ACK_MIN_US 120
+#define DHT22_ACK_MAX_US 220
+#define DHT22_BIT_MIN_US 50
+#define DHT22_BIT_MAX_US 140
+#define DHT22_ONE_US 100
+#define DHT22_BITS 40
+
+// Channels for read()
+#define DHT22_TEMPERATURE 0
+#define DHT22_HUMIDITY 1
+
+typedef enum {
+  DHT22_OK = 0,
+  DHT22_BUSY,       // still reading, or too soon after the last
+  DHT22_NO_REPLY,   // timed out with nothing or part of a reply
+  DHT22_BAD_ACK,
+  DHT22_BAD_BIT,
+  DHT22_CHECKSUM
+} dht22_status_t;
+
+class DHT22Decoder {
+  public:
+    DHT22Decoder(void);
+    void reset(void);
+    // Microseconds since the last falling edge; true once finished
+    bool edge(uint16_t us);
+    bool finished(void) { return _edges > DHT22_BITS + 1; }
+
+    uint8_t status;
+    uint8_t data[5];
+
+    int16_t temperature(void);
+    int16_t humidity(void);
+
+  private:
+    uint8_t _edges;
+};
+
+class DHT22Reader : public Task, public PciListener {
+  public:
+    DHT22Reader(uint8_t pin);
+    void begin(void);
+    bool request(void);
+    bool ready(void);
+    uint8_t status(void) { return _decoder.status; }
+    int16_t read(uint8_t channel);
+    int16_t getTemperatureCInt(void) { return _decoder.temperature(); }
+    int16_t getHumidityInt(void) { return _decoder.humidity(); }
+
+    virtual void pciHandleInterrupt(byte vect);
+
+  private:
+    static void step(Task * me);
+    void _finish(uint8_t status);
+
+    uint8_t _pin;
+    volatile uint8_t _state;
+    volatile bool _ready;
+    bool _requested;
+    unsigned long _started;
+    unsigned long _last;
+    DHT22Decoder _decoder;
+};
+
+#endif // _DHT22_READER_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,195 @@
+#ifndef _FAST_PIN_H
+#define _FAST_PIN_H
+
+#include "Arduino.h"
+
+/**
+ * Compile time pin access.
+ *
+ * digitalWrite looks the pin up in three PROGMEM tables, checks for
+ * a PWM timer and disables interrupts around the write, about 50
+ * cycles a call.  With the pin number as a template argument the
+ * port and bit are constants, so the calls below compile to a single
+ * sbi, cbi, sbis or out:
+ *
+ *   typedef FastPin<RELAY> relay;
+ *   relay::output();
+ *   relay::write(on);
+ *
+ * Pins the mapping doesn't know (other boards, or A6/A7 which have
+ * no port) fall back to pinMode/digitalWrite/digitalRead.  Nothing
+ * here turns off PWM, so don't use analogWrite on the same pin.
+ *
+ * FastPinGroup sets up to four pins from the bits of a value, bit 0
+ * to P0, with one read-modify-write of the port when they share one:
+ *
+ *   typedef FastPinGroup<BCD_0, BCD_1, BCD_2, BCD_3> bcd;
+ *   bcd::write(digit);
+ *
+ * Pins that are in order on the port, like A0-A3, take a shift and
+ * mask.  Interrupts are held off for the port write so an ISR
+ * changing other pins on the same port isn't undone.
+ */
+
+#define FAST_PIN_NONE 0xff
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega328__)
+ // Uno and friends: 0-7 on D, 8-13 on B, A0-A5 (14-19) on C
+ #define FAST_PIN_DIRECT(p) ((p) < 20)
+ #define FAST_PIN_PORT(p) ((p) < 8 ? &PORTD : (p) < 14 ? &PORTB : &PORTC)
+ #define FAST_PIN_DDR(p)  ((p) < 8 ? &DDRD : (p) < 14 ? &DDRB : &DDRC)
+ #define FAST_PIN_IN(p)   ((p) < 8 ? &PIND : (p) < 14 ? &PINB : &PINC)
+ #define FAST_PIN_BIT(p)  ((p) < 8 ? (p) : (p) < 14 ? (p) - 8 : (p) < 20 ? (p) - 14 : 0)
+#else
+ #define FAST_PIN_DIRECT(p) 0
+ #define FAST_PIN_PORT(p) ((volatile uint8_t *)0)
+ #define FAST_PIN_DDR(p)  ((volatile uint8_t *)0)
+ #define FAST_PIN_IN(p)   ((volatile uint8_t *)0)
+ #define FAST_PIN_BIT(p)  0
+#endif
+#define FAST_PIN_MASK(p) (FAST_PIN_DIRECT(p) ? (uint8_t)(1 << FAST_PIN_BIT(p)) : 0)
+
+template<uint8_t Pin>
+class FastPin {
+  public:
+    static inline void output(void) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        *FAST_PIN_DDR(Pin) |= FAST_PIN_MASK(Pin);
+      } else {
+        pinMode(Pin, OUTPUT);
+      }
+    }
+
+    static inline void input(bool pullup = false) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        *FAST_PIN_DDR(Pin) &= ~FAST_PIN_MASK(Pin);
+        write(pullup);
+      } else {
+        pinMode(Pin, pullup ? INPUT_PULLUP : INPUT);
+      }
+    }
+
+    static inline void high(void) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        *FAST_PIN_PORT(Pin) |= FAST_PIN_MASK(Pin);
+      } else {
+        digitalWrite(Pin, HIGH);
+      }
+    }
+
+    static inline void low(void) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        *FAST_PIN_PORT(Pin) &= ~FAST_PIN_MASK(Pin);
+      } else {
+        digitalWrite(Pin, LOW);
+      }
+    }
+
+    static inline void write(bool value) __attribute__((always_inline))
+    {
+      if (value) {
+        high();
+      } else {
+        low();
+      }
+    }
+
+    // Writing a 1 to the PIN register toggles the output
+    static inline void toggle(void) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        *FAST_PIN_IN(Pin) = FAST_PIN_MASK(Pin);
+      } else {
+        digitalWrite(Pin, ! digitalRead(Pin));
+      }
+    }
+
+    static inline bool read(void) __attribute__((always_inline))
+    {
+      if (FAST_PIN_DIRECT(Pin)) {
+        return (*FAST_PIN_IN(Pin) & FAST_PIN_MASK(Pin)) != 0;
+      }
+      return digitalRead(Pin) == HIGH;
+    }
+};
+
+template<uint8_t P0, uint8_t P1 = FAST_PIN_NONE, uint8_t P2 = FAST_PIN_NONE, uint8_t P3 = FAST_PIN_NONE>
+class FastPinGroup {
+  public:
+    static inline void output(void)
+    {
+      FastPin<P0>::output();
+      if (P1 != FAST_PIN_NONE) FastPin<P1>::output();
+      if (P2 != FAST_PIN_NONE) FastPin<P2>::output();
+      if (P3 != FAST_PIN_NONE) FastPin<P3>::output();
+    }
+
+    // The port bits for value, given the pins share a port
+    static inline uint8_t bits(uint8_t value) __attribute__((always_inline))
+    {
+      if (inOrder()) {
+        return (value << FAST_PIN_BIT(P0)) & mask();
+      }
+      return ((value & 0x01) ? FAST_PIN_MASK(P0) : 0)
+        | ((value & 0x02) ? FAST_PIN_MASK(P1) : 0)
+        | ((value & 0x04) ? FAST_PIN_MASK(P2) : 0)
+        | ((value & 0x08) ? FAST_PIN_MASK(P3) : 0);
+    }
+
+    static inline void write(uint8_t value) __attribute__((always_inline))
+    {
+      if (samePort()) {
+        uint8_t b = bits(value);
+        uint8_t sreg = SREG;
+        cli();
+        *FAST_PIN_PORT(P0) = (*FAST_PIN_PORT(P0) & ~mask()) | b;
+        SREG = sreg;
+        return;
+      }
+      FastPin<P0>::write(value & 0x01);
+      if (P1 != FAST_PIN_NONE) FastPin<P1>::write(value & 0x02);
+      if (P2 != FAST_PIN_NONE) FastPin<P2>::write(value & 0x04);
+      if (P3 != FAST_PIN_NONE) FastPin<P3>::write(value & 0x08);
+    }
+
+    static inline uint8_t mask(void) __attribute__((always_inline))
+    {
+      return FAST_PIN_MASK(P0) | FAST_PIN_MASK(P1) | FAST_PIN_MASK(P2) | FAST_PIN_MASK(P3);
+    }
+
+    static inline volatile uint8_t * port(void) __attribute__((always_inline))
+    {
+      return FAST_PIN_PORT(P0);
+    }
+
+    // All pins direct and on the one port
+    static inline bool samePort(void) __attribute__((always_inline))
+    {
+      return FAST_PIN_DIRECT(P0)
+        && sharesPort(P1) && sharesPort(P2) && sharesPort(P3);
+    }
+
+  private:
+    static inline bool sharesPort(uint8_t p) __attribute__((always_inline))
+    {
+      return p == FAST_PIN_NONE
+        || (FAST_PIN_DIRECT(p) && FAST_PIN_PORT(p) == FAST_PIN_PORT(P0));
+    }
+
+    // Each pin one bit above the last, so a shift places them all
+    static inline bool inOrder(void) __attribute__((always_inline))
+    {
+      return (P1 == FAST_PIN_NONE || FAST_PIN_BIT(P1) == FAST_PIN_BIT(P0) + 1)
+        && (P2 == FAST_PIN_NONE || FAST_PIN_BIT(P2) == FAST_PIN_BIT(P0) + 2)
+        && (P3 == FAST_PIN_NONE || FAST_PIN_BIT(P3) == FAST_PIN_BIT(P0) + 3)
+        && (P2 == FAST_PIN_NONE || P1 != FAST_PIN_NONE)
+        && (P3 == FAST_PIN_NONE || P2 != FAST_PIN_NONE);
+    }
+};
+
+#endif // _FAST_PIN_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,206 @@
+/* COBS framed, batched binary link to a host.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "HostLink.h"
+
+/* CRC-16/CCITT, bitwise to keep it small */
+uint16_t
+hostLinkCrc(uint16_t crc, const uint8_t * data, uint16_t len) {
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/* Returns the encoded length, out needs room for len + len / 254 + 1 */
+uint16_t
+cobsEncode(const uint8_t * in, uint16_t len, uint8_t * out) {
+  uint8_t * code = out;
+  uint8_t * o = out + 1;
+  uint8_t run = 1;
+  while (len--) {
+    if (*in) {
+      *o++ = *in;
+      run++;
+    }
+    if ( ! *in || run == 0xff) {
+      *code = run;
+      run = 1;
+      code = o;
+      // A full run at the very end needs no empty block after it
+      if ( ! *in || len) {
+        o++;
+      }
+    }
+    in++;
+  }
+  *code = run;
+  return o - out;
+}
+
+/* Decodes in place, returning the length or 0 if malformed */
+uint16_t
+cobsDecode(uint8_t * buf, uint16_t len) {
+  uint16_t i = 0;
+  uint16_t o = 0;
+  uint8_t code;
+  while (i < len) {
+    code = buf[i++];
+    if (code == 0 || i + code - 1 > len) {
+      return 0;
+    }
+    for (uint8_t n = 1; n < code; n++) {
+      buf[o++] = buf[i++];
+    }
+    if (code < 0xff && i < len) {
+      buf[o++] = 0;
+    }
+  }
+  return o;
+}
+
+HostLink::HostLink()
+: dropped(0),
+badFrames(0),
+batches(0),
+_port(NULL),
+_handler(NULL),
+_batchLen(0),
+_batchStart(0),
+_outLen(0),
+_outPos(0),
+_inLen(0),
+_inOverrun(false),
+_seq(0),
+_credits(HOST_LINK_CREDITS),
+_creditTime(0)
+{
+}
+
+void
+HostLink::begin(HardwareSerial & port, host_link_frame_t handler) {
+  _port = &port;
+  _handler = handler;
+}
+
+/* Add a record to the batch, false if there was no room */
+bool
+HostLink::add(uint16_t from, uint8_t type, const void * data, uint8_t len) {
+  uint8_t * p;
+  uint16_t at;
+  if (_batchLen == 0) {
+    _batchLen = HOST_LINK_HEADER;
+    _batchStart = millis();
+  }
+  if (_batchLen + HOST_LINK_RECORD + len > HOST_LINK_BATCH) {
+    dropped++;
+    return false;
+  }
+  at = millis() - _batchStart;
+  p = _batch + _batchLen;
+  *p++ = from & 0xff;
+  *p++ = from >> 8;
+  *p++ = type;
+  *p++ = at & 0xff;
+  *p++ = at >> 8;
+  *p++ = len;
+  memcpy(p, data, len);
+  _batchLen += HOST_LINK_RECORD + len;
+  return true;
+}
+
+uint8_t
+HostLink::credits(void) {
+  return _credits;
+}
+
+/* Encode the batch ready to go out, once the last has gone */
+void
+HostLink::_flush(void) {
+  uint16_t crc;
+  _batch[0] = 'B';
+  _batch[1] = _seq++;
+  _batch[2] = _batchStart & 0xff;
+  _batch[3] = (_batchStart >> 8) & 0xff;
+  _batch[4] = (_batchStart >> 16) & 0xff;
+  _batch[5] = _batchStart >> 24;
+  crc = hostLinkCrc(0xffff, _batch, _batchLen);
+  _batch[_batchLen++] = crc >> 8;
+  _batch[_batchLen++] = crc & 0xff;
+  _outLen = cobsEncode(_batch, _batchLen, _out);
+  _out[_outLen++] = 0;
+  _outPos = 0;
+  _batchLen = 0;
+  // The wait for more credit runs from when it ran out
+  if (--_credits == 0) {
+    _creditTime = millis();
+  }
+  batches++;
+}
+
+void
+HostLink::_drain(void) {
+  int room = _port->availableForWrite();
+  while (_outPos < _outLen && room-- > 0) {
+    _port->write(_out[_outPos++]);
+  }
+  if (_outPos == _outLen) {
+    _outLen = _outPos = 0;
+  }
+}
+
+void
+HostLink::_read(void) {
+  int c;
+  uint16_t len;
+  while ((c = _port->read()) >= 0) {
+    if (c) {
+      if (_inLen < sizeof(_in)) {
+        _in[_inLen++] = c;
+      } else {
+        _inOverrun = true;
+      }
+      continue;
+    }
+    len = _inOverrun ? 0 : cobsDecode(_in, _inLen);
+    _inLen = 0;
+    _inOverrun = false;
+    // The CRC over a frame with its own CRC on the end comes to 0
+    if (len < 3 || hostLinkCrc(0xffff, _in, len) != 0) {
+      badFrames++;
+      continue;
+    }
+    len -= 2;
+    if (_in[0] == 'A' && len == 2) {
+      _credits = _credits + _in[1] > 0xff ? 0xff : _credits + _in[1];
+    } else if (_handler) {
+      _handler(_in, len);
+    }
+  }
+}
+
+void
+HostLink::poll(void) {
+  _read();
+  if (_outLen) {
+    _drain();
+  }
+  if ( ! _credits && millis() - _creditTime >= HOST_LINK_CREDIT_MS) {
+    _credits = HOST_LINK_CREDITS;
+  }
+  if (_batchLen && ! _outLen && _credits
+      && (_batchLen > HOST_LINK_BATCH - HOST_LINK_FULL
+        || millis() - _batchStart >= HOST_LINK_FLUSH_MS)) {
+    _flush();
+    _drain();
+  }
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,96 @@
+#ifndef _HOST_LINK_H
+#define _HOST_LINK_H
+
+#include "Arduino.h"
+
+/**
+ * Binary link to a host computer over a serial port.
+ *
+ * Every frame on the wire is COBS encoded and ends in a zero byte,
+ * so the host can always find the start of the next one.  Before
+ * encoding each frame has a CRC-16/CCITT (0xffff start, as
+ * Python's binascii.crc_hqx) appended, high byte first.  The first
+ * byte of a frame says what it is:
+ *
+ * To the host:
+ *   'B' seq, start millis (4), then records of:
+ *       from (2), type, ms after start (2), length, data
+ *
+ * From the host:
+ *   'A' n         allow n more batches
+ *   anything else is passed to the handler given to begin()
+ *
+ * Records are batched and a batch goes out when it is nearly full
+ * or its first record is HOST_LINK_FLUSH_MS old.  Other multi-byte
+ * values are little endian.
+ *
+ * Flow control is by credit: each batch uses one and the host
+ * returns them with 'A' frames as it takes the batches.  A host
+ * that never does is given HOST_LINK_CREDITS again once the credit
+ * has been used up for HOST_LINK_CREDIT_MS.  With no credit, or the previous batch
+ * still going out, records wait in the batch and new ones are
+ * dropped when it fills.
+ *
+ * Output is written only as fast as the serial buffer empties, so
+ * poll() never blocks.
+ */
+
+#ifndef HOST_LINK_BATCH
+#define HOST_LINK_BATCH 200
+#endif
+#ifndef HOST_LINK_FLUSH_MS
+#define HOST_LINK_FLUSH_MS 50
+#endif
+#ifndef HOST_LINK_MAX_IN
+#define HOST_LINK_MAX_IN 40
+#endif
+#define HOST_LINK_CREDITS 4
+#define HOST_LINK_CREDIT_MS 2000
+#define HOST_LINK_HEADER 6
+#define HOST_LINK_RECORD 6
+// A batch with less room than this is sent without waiting
+#define HOST_LINK_FULL (HOST_LINK_RECORD + 32)
+// COBS adds a byte every 254, plus the CRC and the delimiter
+#define HOST_LINK_ENCODED(n) ((n) + 2 + ((n) + 2) / 254 + 2)
+
+typedef void (*host_link_frame_t)(const uint8_t * data, uint8_t len);
+
+uint16_t hostLinkCrc(uint16_t crc, const uint8_t * data, uint16_t len);
+uint16_t cobsEncode(const uint8_t * in, uint16_t len, uint8_t * out);
+uint16_t cobsDecode(uint8_t * buf, uint16_t len);
+
+class HostLink {
+  public:
+    HostLink();
+    void begin(HardwareSerial & port, host_link_frame_t handler);
+    bool add(uint16_t from, uint8_t type, const void * data, uint8_t len);
+    void poll(void);
+    uint8_t credits(void);
+
+    uint16_t dropped;     // Records with no room in the batch
+    uint16_t badFrames;   // From the host, bad CRC or too long
+    uint16_t batches;
+
+  private:
+    HardwareSerial * _port;
+    host_link_frame_t _handler;
+    uint8_t _batch[HOST_LINK_BATCH + 2];
+    uint8_t _batchLen;
+    unsigned long _batchStart;
+    uint8_t _out[HOST_LINK_ENCODED(HOST_LINK_BATCH)];
+    uint16_t _outLen;
+    uint16_t _outPos;
+    uint8_t _in[HOST_LINK_MAX_IN + 1];
+    uint8_t _inLen;
+    bool _inOverrun;
+    uint8_t _seq;
+    uint8_t _credits;
+    unsigned long _creditTime;
+
+    void _flush(void);
+    void _drain(void);
+    void _read(void);
+};
+
+#endif // _HOST_LINK_H
+// vim:ai sw=2 expandtab:
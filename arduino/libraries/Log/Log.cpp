@@ -0,0 +1,86 @@
+/* Levelled, ring buffered logging.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "Log.h"
+
+// Room needed in the TX buffer to report dropped text in one go
+#define LOG_DROP_REPORT 24
+
+Logger Log;
+
+Logger::Logger()
+: _out(&Serial),
+_buffer(NULL),
+_size(0),
+_head(0),
+_tail(0),
+_dropped(0),
+_reported(0)
+{
+}
+
+void
+Logger::begin(HardwareSerial & out, uint8_t * buffer, uint8_t size) {
+  _out = &out;
+  _buffer = buffer;
+  _size = size;
+  _head = _tail = 0;
+}
+
+size_t
+Logger::write(uint8_t c) {
+  uint8_t next;
+  if (_buffer == NULL) {
+    return _out->write(c);
+  }
+  next = _head + 1;
+  if (next >= _size) {
+    next = 0;
+  }
+  if (next == _tail) {
+    _dropped++;
+    return 0;
+  }
+  _buffer[_head] = c;
+  _head = next;
+  return 1;
+}
+
+void
+Logger::drain(void) {
+  if (_buffer == NULL) {
+    return;
+  }
+  while (_tail != _head && _out->availableForWrite() > 0) {
+    _out->write(_buffer[_tail]);
+    if (++_tail >= _size) {
+      _tail = 0;
+    }
+  }
+  if (_tail == _head && _dropped != _reported
+    && _out->availableForWrite() >= LOG_DROP_REPORT) {
+    _out->print(F("\r\n[log dropped "));
+    _out->print(_dropped - _reported);
+    _out->println(']');
+    _reported = _dropped;
+  }
+}
+
+uint8_t
+Logger::pending(void) {
+  if (_head >= _tail) {
+    return _head - _tail;
+  }
+  return _size - _tail + _head;
+}
+
+uint16_t
+Logger::dropped(void) {
+  return _dropped;
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,73 @@
+#ifndef _LOG_H
+#define _LOG_H
+
+#include "Arduino.h"
+
+/**
+ * Levelled logging that doesn't stall the caller.
+ *
+ * Messages are given to the logError/logWarn/logInfo/logDebug
+ * macros (and their ...ln forms).  Anything above LOG_LEVEL is
+ * removed at compile time, along with the work of building its
+ * arguments.  Define LOG_LEVEL before including Log.h to set it for
+ * a sketch.  Libraries are compiled separately, so to strip their
+ * messages too set it in the build flags.
+ *
+ * By default output goes straight to Serial, as before.  Once
+ * begin() is given a buffer, text is queued in RAM instead and
+ * drain() writes out only what the serial TX buffer can take
+ * without waiting.  Call it from idle time.  When the queue is full
+ * new text is dropped and counted rather than blocking; the count
+ * is reported in the output once the queue empties.
+ *
+ * Log is a Print, so F() strings and numbers work as for Serial:
+ *
+ *   logInfo(F("Depth "));
+ *   logInfoln(depth);
+ */
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define _LOG(level, method, x) do { if (LOG_LEVEL >= (level)) { Log.method(x); } } while (0)
+
+#define logError(x)   _LOG(LOG_LEVEL_ERROR, print, x)
+#define logErrorln(x) _LOG(LOG_LEVEL_ERROR, println, x)
+#define logWarn(x)    _LOG(LOG_LEVEL_WARN, print, x)
+#define logWarnln(x)  _LOG(LOG_LEVEL_WARN, println, x)
+#define logInfo(x)    _LOG(LOG_LEVEL_INFO, print, x)
+#define logInfoln(x)  _LOG(LOG_LEVEL_INFO, println, x)
+#define logDebug(x)   _LOG(LOG_LEVEL_DEBUG, print, x)
+#define logDebugln(x) _LOG(LOG_LEVEL_DEBUG, println, x)
+
+class Logger : public Print {
+  public:
+    Logger();
+    void begin(HardwareSerial & out, uint8_t * buffer, uint8_t size);
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    void drain(void);
+    uint8_t pending(void);
+    uint16_t dropped(void);
+
+  private:
+    HardwareSerial * _out;
+    uint8_t * _buffer;
+    uint8_t _size;
+    uint8_t _head;
+    uint8_t _tail;
+    uint16_t _dropped;
+    uint16_t _reported;
+};
+
+extern Logger Log;
+
+#endif // _LOG_H
+// vim:ai sw=2 expandtab:
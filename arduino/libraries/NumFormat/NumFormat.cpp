@@ -0,0 +1,80 @@
+/* printf-free number formatting.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "NumFormat.h"
+
+/* Digits are generated backwards into a scratch buffer, then copied
+ * out after any sign and padding. */
+static char *
+_emit(char * buf, bool negative, const char * digits, uint8_t len, uint8_t width, char pad) {
+  uint8_t used = len + (negative ? 1 : 0);
+  if (negative && pad == '0') {
+    *buf++ = '-';
+  }
+  while (width > used) {
+    *buf++ = pad;
+    width--;
+  }
+  if (negative && pad != '0') {
+    *buf++ = '-';
+  }
+  while (len) {
+    *buf++ = digits[--len];
+  }
+  *buf = 0;
+  return buf;
+}
+
+/* Fill digits least significant first, at least minDigits long. */
+static uint8_t
+_digits(char * digits, unsigned long value, uint8_t base, uint8_t minDigits) {
+  uint8_t len = 0;
+  uint8_t d;
+  do {
+    d = value % base;
+    value /= base;
+    digits[len++] = d < 10 ? '0' + d : 'a' + d - 10;
+  } while (value || len < minDigits);
+  return len;
+}
+
+char *
+formatUnsigned(char * buf, unsigned long value, uint8_t base, uint8_t width, char pad) {
+  char digits[NUM_FORMAT_MAX];
+  uint8_t len = _digits(digits, value, base, 1);
+  return _emit(buf, false, digits, len, width, pad);
+}
+
+char *
+formatLong(char * buf, long value, uint8_t width, char pad) {
+  char digits[NUM_FORMAT_MAX];
+  bool negative = value < 0;
+  uint8_t len = _digits(digits, negative ? -(unsigned long)value : value, 10, 1);
+  return _emit(buf, negative, digits, len, width, pad);
+}
+
+/* value is in units of 10^-precision, so formatFixed(buf, -5, 1)
+ * gives "-0.5".  The decimal point goes into the digit string, with
+ * at least one digit ahead of it. */
+char *
+formatFixed(char * buf, long value, uint8_t precision, uint8_t width, char pad) {
+  char digits[NUM_FORMAT_MAX + 1];
+  bool negative = value < 0;
+  uint8_t len;
+  if ( ! precision) {
+    return formatLong(buf, value, width, pad);
+  }
+  len = _digits(digits, negative ? -(unsigned long)value : value, 10, precision + 1);
+  // Shift the integer part up to make room for the point
+  for (uint8_t i = len; i > precision; i--) {
+    digits[i] = digits[i - 1];
+  }
+  digits[precision] = '.';
+  return _emit(buf, negative, digits, len + 1, width, pad);
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,33 @@
+#ifndef _NUM_FORMAT_H
+#define _NUM_FORMAT_H
+
+#include "Arduino.h"
+
+/**
+ * Integer and fixed point to text without sprintf.
+ *
+ * Pulling in sprintf brings avr-libc's vfprintf (1.5-2KB of flash)
+ * into a sketch, and each %ld costs several hundred cycles parsing
+ * the format.  These write the digits directly.
+ *
+ * Each function writes a null terminated string at buf and returns
+ * a pointer to the terminator, so fields can be appended in turn:
+ *
+ *   char * p = buf;
+ *   p = formatLong(p, a);
+ *   *p++ = ':';
+ *   p = formatFixed(p, b, 1);
+ *
+ * width pads on the left with pad (' ' or '0') up to that many
+ * characters, a '-' sign is placed ahead of any zero padding.
+ */
+
+// Longest output, a 32 bit value in octal plus sign and null
+#define NUM_FORMAT_MAX 13
+
+char * formatUnsigned(char * buf, unsigned long value, uint8_t base = 10, uint8_t width = 0, char pad = ' ');
+char * formatLong(char * buf, long value, uint8_t width = 0, char pad = ' ');
+char * formatFixed(char * buf, long value, uint8_t precision, uint8_t width = 0, char pad = ' ');
+
+#endif // _NUM_FORMAT_H
+// vim:ai sw=2 expandtab:
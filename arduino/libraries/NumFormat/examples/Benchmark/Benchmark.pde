@@ -0,0 +1,110 @@
+/*
+ * Check NumFormat against sprintf and compare their speed.
+ *
+ * Each value is formatted both ways and any mismatch printed,
+ * then each formatter is run in a loop and the average cycles
+ * per call reported.  Note this sketch links sprintf for the
+ * comparison, so its size says nothing about the flash saved.
+ */
+#include <NumFormat.h>
+
+#define LOOPS 1000
+
+long values[] = { 0, 7, -7, 42, -42, 1234, -1234, 99999, -100000, 2147483647L };
+#define VALUE_COUNT (sizeof(values) / sizeof(long))
+
+char a[NUM_FORMAT_MAX + 4];
+char b[NUM_FORMAT_MAX + 4];
+uint8_t failures = 0;
+
+void check(const char * what, long value) {
+  if (strcmp(a, b)) {
+    failures++;
+    Serial.print(what);
+    Serial.print(' ');
+    Serial.print(value);
+    Serial.print(F(": got "));
+    Serial.print(a);
+    Serial.print(F(" expected "));
+    Serial.println(b);
+  }
+}
+
+void verify(void) {
+  long v;
+  unsigned long u;
+  for (uint8_t i = 0; i < VALUE_COUNT; i++) {
+    v = values[i];
+    u = v < 0 ? -v : v;
+    formatLong(a, v);
+    sprintf(b, "%ld", v);
+    check("long", v);
+    formatLong(a, v, 6, '0');
+    sprintf(b, "%06ld", v);
+    check("zero pad", v);
+    formatUnsigned(a, u, 8, 4, '0');
+    sprintf(b, "%04lo", u);
+    check("octal", v);
+    formatFixed(a, v, 2);
+    sprintf(b, "%s%lu.%02lu", v < 0 ? "-" : "", u / 100, u % 100);
+    check("fixed", v);
+  }
+  Serial.print(failures);
+  Serial.println(F(" failures"));
+}
+
+void report(const char * what, unsigned long start) {
+  // micros() has 4us resolution at 16MHz, so time a whole loop
+  unsigned long cycles = (micros() - start) * (F_CPU / 1000000L);
+  Serial.print(what);
+  Serial.print(' ');
+  Serial.print(cycles / (LOOPS * VALUE_COUNT));
+  Serial.println(F(" cycles/call"));
+}
+
+void benchmark(void) {
+  unsigned long start;
+  uint8_t i;
+  int n;
+
+  start = micros();
+  for (n = 0; n < LOOPS; n++) {
+    for (i = 0; i < VALUE_COUNT; i++) {
+      formatLong(a, values[i]);
+    }
+  }
+  report("formatLong", start);
+
+  start = micros();
+  for (n = 0; n < LOOPS; n++) {
+    for (i = 0; i < VALUE_COUNT; i++) {
+      sprintf(b, "%ld", values[i]);
+    }
+  }
+  report("sprintf %ld", start);
+
+  start = micros();
+  for (n = 0; n < LOOPS; n++) {
+    for (i = 0; i < VALUE_COUNT; i++) {
+      formatFixed(a, values[i], 1);
+    }
+  }
+  report("formatFixed", start);
+
+  start = micros();
+  for (n = 0; n < LOOPS; n++) {
+    for (i = 0; i < VALUE_COUNT; i++) {
+      sprintf(b, "%ld.%ld", values[i] / 10, labs(values[i] % 10));
+    }
+  }
+  report("sprintf %ld.%ld", start);
+}
+
+void setup() {
+  Serial.begin(9600);
+  verify();
+  benchmark();
+}
+
+void loop() {
+}
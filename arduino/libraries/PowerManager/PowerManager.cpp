@@ -0,0 +1,200 @@
+/* Low power idle for SoftTimer based sketches.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include "PowerManager.h"
+
+// Maintained by the core (wiring.c) for millis() and micros()
+extern volatile unsigned long timer0_millis;
+extern volatile unsigned long timer0_overflow_count;
+
+static volatile bool _wdtFired;
+
+ISR(WDT_vect) {
+  _wdtFired = true;
+}
+
+PowerManager::PowerManager(void)
+: _taskCount(0),
+_radioOn(false),
+_radioSince(0),
+_wokeAt(0)
+{
+  resetStats();
+}
+
+bool
+PowerManager::add(Task * task) {
+  if (_taskCount >= POWER_MAX_TASKS) {
+    return false;
+  }
+  remove(task);
+  _tasks[_taskCount++] = task;
+  SoftTimer.add(task);
+  return true;
+}
+
+void
+PowerManager::remove(Task * task) {
+  SoftTimer.remove(task);
+  for (uint8_t i = 0; i < _taskCount; i++) {
+    if (_tasks[i] == task) {
+      _tasks[i] = _tasks[--_taskCount];
+      return;
+    }
+  }
+}
+
+/* Milliseconds until the first of our tasks is due, 0 if one is overdue */
+unsigned long
+PowerManager::nextDue(void) {
+  unsigned long now = micros();
+  unsigned long due = 0xffffffffUL;
+  unsigned long elapsed;
+  unsigned long left;
+
+  for (uint8_t i = 0; i < _taskCount; i++) {
+    elapsed = now - _tasks[i]->lastCallTimeMicros;
+    if (elapsed >= _tasks[i]->periodMicros) {
+      return 0;
+    }
+    left = _tasks[i]->periodMicros - elapsed;
+    if (left < due) {
+      due = left;
+    }
+  }
+  return due / 1000;
+}
+
+void
+PowerManager::sleep(void) {
+  unsigned long start = millis();
+  unsigned long due = nextDue();
+
+  if (due == 0) {
+    return;
+  }
+  awakeMs += start - _wokeAt;
+  if (due < 16 || (UCSR0B & _BV(UDRIE0))) {
+    _idle();
+    idleMs += millis() - start;
+  } else {
+    Serial.flush();
+    downMs += _powerDown(due);
+  }
+  _wokeAt = millis();
+}
+
+void
+PowerManager::_idle(void) {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sleep_cpu();
+  sleep_disable();
+}
+
+/*
+ * Sleep for the longest watchdog period that fits in `due` ms.
+ * Returns the number of ms the clock was advanced by.
+ */
+unsigned long
+PowerManager::_powerDown(unsigned long due) {
+  uint8_t wdto = WDTO_8S;
+  unsigned long ms;
+  uint8_t adc = ADCSRA;
+  uint8_t sreg;
+
+  // Watchdog periods are nominally 16ms << WDTO_xx
+  while (wdto > WDTO_15MS && (16UL << wdto) > due) {
+    wdto--;
+  }
+  ms = 16UL << wdto;
+
+  ADCSRA &= ~_BV(ADEN);
+  _wdtFired = false;
+  cli();
+  MCUSR &= ~_BV(WDRF);
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | (wdto & 0x07) | ((wdto & 0x08) ? _BV(WDP3) : 0);
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+#if defined(BODS) && defined(BODSE)
+  sleep_bod_disable();
+#endif
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  wdt_disable();
+  ADCSRA = adc;
+
+  if ( ! _wdtFired) {
+    return 0;
+  }
+  sreg = SREG;
+  cli();
+  timer0_millis += ms;
+  timer0_overflow_count += (ms * 1000UL) / (256UL * 64UL / clockCyclesPerMicrosecond());
+  SREG = sreg;
+  return ms;
+}
+
+/* Called by the sketch as it powers the radio up and down */
+void
+PowerManager::radio(bool on) {
+  unsigned long now = millis();
+  if (on == _radioOn) {
+    return;
+  }
+  if (_radioOn) {
+    radioMs += now - _radioSince;
+  }
+  _radioOn = on;
+  _radioSince = now;
+}
+
+/* fullScale is the battery voltage in mV that reads as 1023,
+ * allowing for any divider in front of the pin. */
+uint16_t
+PowerManager::batteryMillivolts(uint8_t pin, uint16_t fullScale) {
+  return ((unsigned long)analogRead(pin) * fullScale) / 1023;
+}
+
+/*
+ * Average current since the last resetStats(), weighting the
+ * datasheet figures by the time spent in each state.  Time
+ * fractions are taken in parts per 10000 to keep this in longs.
+ */
+unsigned long
+PowerManager::estimateMicroAmps(void) {
+  unsigned long now = millis();
+  unsigned long awake = awakeMs + (now - _wokeAt);
+  unsigned long radio = radioMs + (_radioOn ? now - _radioSince : 0);
+  unsigned long total = awake + idleMs + downMs;
+  unsigned long scale = total / 10000 + 1;
+  unsigned long ua;
+
+  ua = (awake / scale) * POWER_ACTIVE_UA
+    + (idleMs / scale) * POWER_IDLE_UA
+    + (downMs / scale) * POWER_DOWN_UA
+    + (radio / scale) * POWER_RADIO_ON_UA
+    + ((total - radio) / scale) * POWER_RADIO_OFF_UA;
+  return ua / ((total / scale) ? (total / scale) : 1) + POWER_BOARD_UA;
+}
+
+void
+PowerManager::resetStats(void) {
+  unsigned long now = millis();
+  awakeMs = 0;
+  idleMs = 0;
+  downMs = 0;
+  radioMs = 0;
+  _wokeAt = now;
+  _radioSince = now;
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,87 @@
+#ifndef _POWER_MANAGER_H
+#define _POWER_MANAGER_H
+
+#include "Arduino.h"
+#include <SoftTimer.h>
+
+/**
+ * Low power idle for SoftTimer based sketches.
+ *
+ * Tasks added through the power manager are passed on to SoftTimer
+ * and also tracked here, so that sleep() can work out how long it is
+ * until the next one is due.  It then uses the deepest sleep that is
+ * safe for that gap:
+ *
+ * - under 16ms, or while serial output is still draining, IDLE
+ *   (timer0 keeps running so millis() is unaffected)
+ * - otherwise POWER DOWN, woken by the watchdog, with millis() and
+ *   micros() advanced by the time slept.
+ *
+ * The Pro Mini has no 32kHz crystal so timer2 can't run during sleep,
+ * hence the watchdog.  Any other interrupt (pin change buttons, the
+ * radio IRQ) also wakes the processor; as the watchdog hasn't expired
+ * we can't tell how long we slept so the clock isn't advanced.
+ *
+ * DelayRun tasks started with startDelayed() aren't seen by the power
+ * manager, so they may run up to one watchdog period late.
+ *
+ * Time spent in each state is recorded so that an average current
+ * can be estimated from the figures below.
+ */
+
+#ifndef POWER_MAX_TASKS
+#define POWER_MAX_TASKS 8
+#endif
+
+/* Typical currents in microamps, from the ATmega328P and nRF24L01+
+ * datasheets.  Override before including to suit the board. */
+#ifndef POWER_ACTIVE_UA
+#define POWER_ACTIVE_UA 10000
+#endif
+#ifndef POWER_IDLE_UA
+#define POWER_IDLE_UA 3500
+#endif
+#ifndef POWER_DOWN_UA
+#define POWER_DOWN_UA 7
+#endif
+#ifndef POWER_RADIO_ON_UA
+#define POWER_RADIO_ON_UA 13500
+#endif
+#ifndef POWER_RADIO_OFF_UA
+#define POWER_RADIO_OFF_UA 1
+#endif
+/* Regulator quiescent current, power LED, sensors etc. */
+#ifndef POWER_BOARD_UA
+#define POWER_BOARD_UA 0
+#endif
+
+class PowerManager {
+  public:
+    unsigned long awakeMs;
+    unsigned long idleMs;
+    unsigned long downMs;
+    unsigned long radioMs;
+
+    PowerManager(void);
+    bool add(Task * task);
+    void remove(Task * task);
+    unsigned long nextDue(void);
+    void sleep(void);
+    void radio(bool on);
+    uint16_t batteryMillivolts(uint8_t pin, uint16_t fullScale);
+    unsigned long estimateMicroAmps(void);
+    void resetStats(void);
+
+  private:
+    Task * _tasks[POWER_MAX_TASKS];
+    uint8_t _taskCount;
+    bool _radioOn;
+    unsigned long _radioSince;
+    unsigned long _wokeAt;
+
+    void _idle(void);
+    unsigned long _powerDown(unsigned long due);
+};
+
+#endif // _POWER_MANAGER_H
+// vim:ai sw=2 expandtab:
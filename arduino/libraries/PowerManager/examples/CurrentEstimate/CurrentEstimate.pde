@@ -0,0 +1,55 @@
+/*
+ * Estimate average current for a range of task periods.
+ *
+ * A dummy "sensor" task does 5ms of work at each period in turn,
+ * with the processor sleeping in between.  After each run the
+ * estimated average current is printed, along with the figure
+ * for the same load never sleeping, so configurations can be
+ * compared before committing to a battery size.
+ */
+#include <SoftTimer.h>
+#include <PowerManager.h>
+
+#define RUN_MS 30000
+
+unsigned long periods[] = { 100, 500, 1000, 5000 };
+uint8_t current = 0;
+bool sleeping = false;
+
+PowerManager power;
+
+void work(Task *me) {
+  delay(5);
+}
+
+void idle(Task *me) {
+  if (sleeping) {
+    power.sleep();
+  }
+}
+
+Task workTask(periods[0], work);
+Task idleTask(0, idle);
+
+void report(Task *me) {
+  Serial.print(periods[current]);
+  Serial.print(sleeping ? F("ms sleeping: ") : F("ms busy: "));
+  Serial.print(power.estimateMicroAmps());
+  Serial.println(F("uA"));
+  if (sleeping && ++current >= sizeof(periods) / sizeof(periods[0])) {
+    current = 0;
+  }
+  sleeping = ! sleeping;
+  workTask.setPeriodMs(periods[current]);
+  power.resetStats();
+}
+
+Task reportTask(RUN_MS, report);
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println(F("Starting"));
+  power.add(&workTask);
+  power.add(&reportTask);
+  SoftTimer.add(&idleTask);
+}
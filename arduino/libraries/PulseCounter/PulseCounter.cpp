@@ -0,0 +1,164 @@
+/* Pulse counting for flow and energy meters.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "PulseCounter.h"
+
+// High 16 bits of the timer1 count
+static volatile uint16_t _timerOverflows;
+
+PulseCounter::PulseCounter(unsigned long windowMs)
+: Task(windowMs, &(PulseCounter::step)),
+_window(windowMs),
+_rate(0),
+_lastTotal(0),
+_lastTime(0)
+{
+}
+
+unsigned long
+PulseCounter::total(void)
+{
+  unsigned long n;
+  uint8_t sreg = SREG;
+  cli();
+  n = _read();
+  SREG = sreg;
+  return n;
+}
+
+void
+PulseCounter::_start(void)
+{
+  _rate = 0;
+  _lastTotal = total();
+  _lastTime = millis();
+  SoftTimer.add(this);
+}
+
+/*
+ * Pulses since the last call, scaled to the window.  The division is
+ * split so pulses * window can't overflow.  n % elapsed is under
+ * elapsed, about one window, but a window over 65s squared still
+ * passes 32 bits, so that part is done in 64.
+ */
+void
+PulseCounter::step(Task * task)
+{
+  PulseCounter * me = (PulseCounter *)task;
+  unsigned long now = millis();
+  unsigned long elapsed = now - me->_lastTime;
+  unsigned long t = me->total();
+  unsigned long n = t - me->_lastTotal;
+  if (elapsed == 0) {
+    return;
+  }
+  me->_rate = (n / elapsed) * me->_window
+    + (unsigned long)((uint64_t)(n % elapsed) * me->_window / elapsed);
+  me->_lastTotal = t;
+  me->_lastTime = now;
+}
+
+TimerPulseCounter::TimerPulseCounter(unsigned long windowMs)
+: PulseCounter(windowMs)
+{
+}
+
+// Counts rising edges on T1
+void
+TimerPulseCounter::begin(void)
+{
+  uint8_t sreg = SREG;
+  pinMode(PULSE_TIMER_PIN, INPUT);
+  cli();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS12) | _BV(CS11) | _BV(CS10);
+  TCNT1 = 0;
+  _timerOverflows = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+  SREG = sreg;
+  _start();
+}
+
+void
+TimerPulseCounter::end(void)
+{
+  TIMSK1 &= ~_BV(TOIE1);
+  TCCR1B = 0;
+  SoftTimer.remove(this);
+}
+
+/*
+ * An overflow not yet taken by the interrupt shows as TOV1 set; if
+ * the count read has wrapped since, it belongs in the high half.
+ */
+unsigned long
+TimerPulseCounter::_read(void)
+{
+  uint16_t low = TCNT1;
+  uint16_t high = _timerOverflows;
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+    high++;
+  }
+  return ((unsigned long)high << 16) | low;
+}
+
+void
+TimerPulseCounter::_overflow(void)
+{
+  _timerOverflows++;
+}
+
+ISR(TIMER1_OVF_vect) {
+  TimerPulseCounter::_overflow();
+}
+
+PinPulseCounter::PinPulseCounter(uint8_t pin, unsigned long windowMs)
+: PulseCounter(windowMs),
+_pin(pin),
+_high(false),
+_count(0)
+{
+}
+
+void
+PinPulseCounter::begin(bool pullup)
+{
+  pinMode(_pin, pullup ? INPUT_PULLUP : INPUT);
+  _high = digitalRead(_pin) == HIGH;
+  PciManager.registerListener(_pin, this);
+  _start();
+}
+
+void
+PinPulseCounter::end(void)
+{
+  PciManager.removeListener(this);
+  SoftTimer.remove(this);
+}
+
+unsigned long
+PinPulseCounter::_read(void)
+{
+  return _count;
+}
+
+/*
+ * Other pins on the same port also land here, so only a change of
+ * this pin from low to high counts.
+ */
+void
+PinPulseCounter::pciHandleInterrupt(byte vect)
+{
+  bool high = digitalRead(_pin) == HIGH;
+  if (high && ! _high) {
+    _count++;
+  }
+  _high = high;
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,100 @@
+#ifndef _PULSE_COUNTER_H
+#define _PULSE_COUNTER_H
+
+#include "Arduino.h"
+#include <SoftTimer.h>
+#include <PciManager.h>
+#include <PciListener.h>
+
+/**
+ * Pulse counting for flow and energy meters.
+ *
+ * Sampling a meter output from the main loop misses every pulse that
+ * comes and goes between looks.  These count in hardware or in an
+ * interrupt instead, and keep a 32 bit running total:
+ *
+ * TimerPulseCounter clocks timer1 from its T1 pin (digital 5 on the
+ * ATmega328P), so the counting is done by the timer itself with an
+ * interrupt only on each 65536th pulse.  Nothing the sketch does can
+ * lose a count, up to a few MHz.  Timer1 is then taken, so it can't
+ * be used with CaptureSerial, Servo or PWM on 9/10.
+ *
+ * PinPulseCounter counts rising edges on any pin through PciManager,
+ * alongside buttons and the like.  Each pulse costs an interrupt of
+ * a few microseconds.  Code that holds interrupts off (OneWire bit
+ * slots of ~70us, SoftwareSerial for a whole character) delays the
+ * count rather than losing it, as long as no more than one pulse
+ * arrives in that time.  That is comfortable up to a few kHz, but
+ * use the timer, or CaptureSerial rather than SoftwareSerial, above
+ * that.
+ *
+ * Both are SoftTimer tasks that run once a window to work out the
+ * rate, the pulses in the last window.  A late call is scaled back
+ * to the full window.
+ *
+ *   PinPulseCounter flow(FLOW_PIN);
+ *   flow.begin();
+ *   ...
+ *   manager.setPulseInput(0, flow.total(), flow.rate());
+ */
+
+#ifndef PULSE_WINDOW_MS
+#define PULSE_WINDOW_MS 1000
+#endif
+
+// Timer1 external clock input, T1
+#define PULSE_TIMER_PIN 5
+
+class PulseCounter : public Task {
+  public:
+    PulseCounter(unsigned long windowMs);
+    unsigned long total(void);
+    unsigned long rate(void) { return _rate; }
+    unsigned long window(void) { return _window; }
+
+  protected:
+    void _start(void);
+    // The count so far, called with interrupts off
+    virtual unsigned long _read(void) = 0;
+
+  private:
+    static void step(Task * me);
+
+    unsigned long _window;
+    unsigned long _rate;
+    unsigned long _lastTotal;
+    unsigned long _lastTime;
+};
+
+class TimerPulseCounter : public PulseCounter {
+  public:
+    TimerPulseCounter(unsigned long windowMs = PULSE_WINDOW_MS);
+    void begin(void);
+    void end(void);
+
+    // Called from the timer1 overflow interrupt
+    static void _overflow(void);
+
+  protected:
+    virtual unsigned long _read(void);
+};
+
+class PinPulseCounter : public PulseCounter, public PciListener {
+  public:
+    PinPulseCounter(uint8_t pin, unsigned long windowMs = PULSE_WINDOW_MS);
+    void begin(bool pullup = true);
+    void end(void);
+
+    virtual void pciHandleInterrupt(byte vect);
+
+  protected:
+    virtual unsigned long _read(void);
+
+  private:
+    uint8_t _pin;
+    volatile bool _high;
+    volatile unsigned long _count;
+};
+
+#endif // _PULSE_COUNTER_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,55 @@
+/*
+ * Two meters reported through Saki: a water flow meter on pin 6,
+ * counted by pin change interrupt, and an energy meter's pulse
+ * output on pin 5, counted by timer1.  Each is an input line
+ * reported as total/rate, the rate being pulses a minute here.
+ *
+ * The XBee is on SoftwareSerial, which holds interrupts off for a
+ * character at a time.  That doesn't trouble the timer count at all,
+ * and the flow meter's few hundred Hz is well inside what the pin
+ * change count can ride out.
+ */
+#include <XBee.h>
+#include <SoftwareSerial.h>
+#include <Saki.h>
+#include <SoftTimer.h>
+#include <PciManager.h>
+#include <PulseCounter.h>
+
+#define FLOW_PIN 6
+#define SER_TX 3
+#define SER_RX 4
+#define RATE_WINDOW_MS 60000
+
+SoftwareSerial ser(SER_RX, SER_TX);
+SakiManager manager("FM", 2, 0, true);
+PinPulseCounter flow(FLOW_PIN, RATE_WINDOW_MS);
+TimerPulseCounter energy(RATE_WINDOW_MS);
+
+void reportStatus(const char ** msg) {
+  manager.setPulseInput(0, flow.total(), flow.rate());
+  manager.setPulseInput(1, energy.total(), energy.rate());
+  manager.report(msg == NULL);
+}
+
+void checkManager(Task * me) {
+  manager.check();
+}
+
+void reportTask(Task * me) {
+  reportStatus(NULL);
+}
+
+Task checkManagerTask(100, checkManager);
+Task report(RATE_WINDOW_MS, reportTask);
+
+void setup() {
+  Serial.begin(9600);
+  ser.begin(9600);
+  manager.registerHandler("ST?", &reportStatus);
+  manager.start(ser);
+  flow.begin();
+  energy.begin();
+  SoftTimer.add(&checkManagerTask);
+  SoftTimer.add(&report);
+}
@@ -8,166 +8,171 @@
  */
 
 #include <avr/eeprom.h>
+#include <util/crc16.h>
 #include "Arduino.h"
-#include <SoftwareSerial.h>
 #include <stdlib.h>
-#include <stdio.h>
-#include "Saki.h"
+#include <Log.h>
+#include "SakiCore.h"
 
-SakiManager * _SakiInstance;
 SakiConfig _config;
 
-SakiManager::SakiManager(void)
-{
-  _init();
-}
+/*
+ * The last fragmented message sequence used.  It is kept over a
+ * reset, and is whatever the RAM powers up with otherwise, so after
+ * a restart the sequence carries on rather than starting again at
+ * one the other end has just seen.
+ */
+static uint8_t _lastTxSeq __attribute__((section(".noinit")));
 
-SakiManager::SakiManager(const char * lid, int ninputs, int noutputs, bool allowRemote)
+// How long a sender keeps resending a message before giving up
+#define SAKI_FRAGMENT_SPAN ((unsigned long)SAKI_FRAGMENT_TIMEOUT * (SAKI_FRAGMENT_RETRIES + 1))
+
+void
+SakiBase::_init(const char * lid, int ninputs, int noutputs, bool allowRemote)
 {
-  _init();
   id = lid;
   inputs = ninputs;
   outputs = noutputs;
   remote = allowRemote;
-}
-
-void
-SakiManager::_init(void) 
-{
-  _radio = XBee();
+  _debug = false;
   _handlerTableSize = 0;
   _inputTable = NULL;
   _outputTable = NULL;
   _inputs = 0;
   _outputs = 0;
   _handlerTable = NULL;
-  _destController = XBeeAddress64(0,0);
   _defaultHandler = NULL;
-  registerHandler("TM", &_SakiSetTime);
-  registerHandler("ID?", &_SakiGetId);
-  registerHandler("CF", &_SakiSetConfig);
-  registerHandler("CF?", &_SakiGetConfig);
   _alarm = 0;
   _alarmed = false;
+  _windowStats = false;
   _clockIncrement = 0;
   _clock = 0;
   _clockUpdated = 0;
   _secondsSinceMidnight = 0;
   configChanged = false;
-  _packetTimeout = 200;
-  _SakiInstance = this;
-}
-
+  _healthInterval = 0;
+  _healthSent = 0;
+  _txBuf = NULL;
+  _txLen = 0;
+  _txAcked = 0;
+  _txSeq = _lastTxSeq;
+  _txTries = 0;
+  _txController = true;
+  _txTime = 0;
+  _rxBuf = NULL;
+  _rxLen = 0;
+  _rxNext = 0;
+  _rxSeq = 0;
+  _rxTime = 0;
+  _handlerCapacity = 0;
+  _inputCapacity = 0;
+  _outputCapacity = 0;
+  _message = NULL;
+  _messageCapacity = 0;
+  _reassembly = NULL;
+  _reassemblyCapacity = 0;
+  _cfg = &_config;
+}
+
+/* Use fixed tables and buffers in place of the heap */
 void
-SakiManager::start(Stream & serial) {
-  _radio.begin(serial);
-}
-
-void
-SakiManager::debug(bool flag) {
-  _debug = flag;
-}
-
-void
-SakiManager::send(const char * msg) {
-  _send(msg, _destController, 0);
+SakiBase::_useStorage(const saki_storage_t * storage)
+{
+  _handlerTable = storage->handlers;
+  _handlerCapacity = storage->handlerCapacity;
+  _inputTable = storage->inputs;
+  _inputCapacity = storage->inputCapacity;
+  _outputTable = storage->outputs;
+  _outputCapacity = storage->outputCapacity;
+  _cfg = storage->config;
+  _message = storage->message;
+  _messageCapacity = storage->messageCapacity;
+  _reassembly = storage->reassembly;
+  _reassemblyCapacity = storage->reassemblyCapacity;
+}
+
+/*
+ * A buffer for a message of up to size bytes, for _freeMessage() when
+ * done with.  With fixed storage it is the one message buffer, so any
+ * fragmented message still being sent from it is dropped.  NULL if
+ * there is no room.
+ */
+char *
+SakiBase::_messageBuffer(uint16_t size)
+{
+  if ( ! _messageCapacity) {
+    return (char *)malloc(size);
+  }
+  if (size > _messageCapacity) {
+    _log("Message buffer too small");
+    return NULL;
+  }
+  if (_txBuf) {
+    _log("Fragmented message dropped");
+    _txBuf = NULL;
+  }
+  return _message;
 }
 
 void
-SakiManager::reply(const char * msg) {
-  _send(msg, _destRespondant, _shortRespondant);
+SakiBase::_freeMessage(char * msg)
+{
+  if (msg != _message && msg != _reassembly) {
+    free(msg);
+  }
 }
 
-// Does the heavy lifting
 void
-SakiManager::check() {
-  tick();
-  ZBRxResponse rx = ZBRxResponse();
-  ModemStatusResponse msr = ModemStatusResponse();
-  ZBTxStatusResponse txStatus = ZBTxStatusResponse();
-
-  _radio.readPacket(_packetTimeout);
-  if (_radio.getResponse().isAvailable()) {
-    if (_radio.getResponse().getApiId() == ZB_RX_RESPONSE) {
-      _radio.getResponse().getZBRxResponse(rx);
-      handle(&rx);
-    }
-    else if (_radio.getResponse().getApiId() == MODEM_STATUS_RESPONSE) {
-      _radio.getResponse().getModemStatusResponse(msr);
-      if (msr.getStatus() == DISASSOCIATED) {
-        // Do we want to do something here?
-      }
-    }
-    else if (_radio.getResponse().getApiId() == ZB_TX_STATUS_RESPONSE) {
-      _radio.getResponse().getZBTxStatusResponse(txStatus);
-      _lastDeliveryStatus = txStatus.getDeliveryStatus();
-    }
-    else {
-      _log("INVALID MESSAGE");
-    }
-  }
+SakiBase::debug(bool flag) {
+  _debug = flag;
 }
 
 void
-SakiManager::_log(char * msg, bool newline) {
+SakiBase::_log(const char * msg, bool newline) {
   if ( ! _debug) {
     return;
   }
   if (newline) {
-    Serial.println(msg);
+    logDebugln(msg);
   } else {
-    Serial.print(msg);
+    logDebug(msg);
   }
 }
 
 void
-SakiManager::_logTokens(char ** tokens) {
+SakiBase::_logTokens(const char ** tokens) {
   if ( ! _debug) {
     return;
   }
   while (*tokens) {
-    Serial.print(*tokens++);
-    Serial.print(':');
+    logDebug(*tokens++);
+    logDebug(':');
   }
 }
 
-void
-SakiManager::handle(ZBRxResponse * rx) {
+/* Split a received message and pass it to its handler.
+ * Returns false if nothing would take it. */
+bool
+SakiBase::handle(char * msg) {
   const char ** Msg;
-  byte * msg = rx->getData();
-  byte len = rx->getDataLength(); 
-  unsigned char hold[len + 1];
-  char buf[65];
   void (*handler)(const char **);
-  
-  _shortRespondant = rx->getRemoteAddress16();
-  _destRespondant = rx->getRemoteAddress64();
-  for (int i = 0; i < len; i++) {
-    hold[i] = msg[i];
-  }
-  hold[len] = 0;
-  memset((void *)buf, 0, 65);
-  sprintf(buf, "%lx %lx", _destRespondant.getMsb(), _destRespondant.getLsb());
-  Msg = tokenize((char *)hold, ":");
-  _log("Message from ", false);
-  _log(buf, false);
-  _log(": ", false);
-  _logTokens(const_cast<char **>(Msg));
+
+  Msg = tokenize(msg, ":");
+  _logTokens(Msg);
   _log("");
 
+  if (Msg[0] == NULL) {
+    return false;
+  }
   if ( (handler = _handlerRegistered(Msg[0])) != NULL) {
     handler(Msg);
+    return true;
   }
-  else {
-    reply("NK");
-    _log("Invalid message received");
-  }
-
+  return false;
 }
 
 callback_t
-SakiManager::_handlerRegistered(const char * key) {
-  void (*handler)(const char **);
+SakiBase::_handlerRegistered(const char * key) {
   for (int i = 0; i < _handlerTableSize; i++) {
     if (!strcmp(key, _handlerTable[i].key)) {
       return _handlerTable[i].method;
@@ -180,12 +185,12 @@ SakiManager::_handlerRegistered(const char * key) {
 }
 
 void 
-SakiManager::registerDefaultHandler(void (*handler)(const char **)) {
+SakiBase::registerDefaultHandler(void (*handler)(const char **)) {
   _defaultHandler = handler;
 }
 
 void 
-SakiManager::registerHandler(const char * key, void (*handler)(const char **)) {
+SakiBase::registerHandler(const char * key, void (*handler)(const char **)) {
   // Check if it is already registered, if so replace it.
   // This allows us to register standard handlers that can be overridden
   for (int i = 0; i < _handlerTableSize; i++) {
@@ -195,45 +200,43 @@ SakiManager::registerHandler(const char * key, void (*handler)(const char **)) {
     }
   }
   // Add a handler to the table
-  
-  _handlerTable = (_handler_t *)realloc((void *)_handlerTable, sizeof(_handler_t) * (_handlerTableSize+1));
+  if (_handlerCapacity) {
+    if (_handlerTableSize >= _handlerCapacity) {
+      _log("Handler table full");
+      return;
+    }
+  } else {
+    _handlerTable = (_handler_t *)realloc((void *)_handlerTable, sizeof(_handler_t) * (_handlerTableSize+1));
+  }
   _handlerTable[_handlerTableSize].key = key;
   _handlerTable[_handlerTableSize].method = handler;
   _handlerTableSize++;
 }
 
-void
-SakiManager::_send(const char * msg, XBeeAddress64 & addr, uint16_t shortAddr) {
-  uint8_t len = strlen(msg);
-  ZBTxRequest tx = ZBTxRequest(addr, (uint8_t *)msg, len);
-  if (shortAddr) {
-    tx.setAddress16(shortAddr);
-  }
-  _radio.send(tx);
-}
-
+/* The tokens point into msg, so they are only good for as long as
+ * the message buffer is. */
 const char ** 
-SakiManager::tokenize(char * msg, const char * delim) {
-  char * tokens[20];
+SakiBase::tokenize(char * msg, const char * delim) {
   char * tkmsg = msg;
   int i = 0;
   char * tk;
   do {
-    tk = tokens[i++] = strtok(tkmsg, delim);
+    tk = strtok(tkmsg, delim);
+    _tokens[i++] = tk;
     tkmsg = NULL;
   }
-  while (tk != NULL);
-  tokens[i] = NULL; // End sentinel
-  return const_cast<const char **>(tokens);
+  while (tk != NULL && i < SAKI_MAX_TOKENS);
+  _tokens[i] = NULL; // End sentinel
+  return _tokens;
 }
 
 unsigned long
-SakiManager::clockTime(void) {
+SakiBase::clockTime(void) {
   return _clock;
 }
 
 void
-SakiManager::tick(void) {
+SakiBase::tick(void) {
   unsigned long lastUpdated;
   if (_clock == 0) { // No sense updating if it hasn't been set
     return;
@@ -254,7 +257,7 @@ SakiManager::tick(void) {
 }
 
 void
-SakiManager::setAlarm(unsigned long secs, bool delta) {
+SakiBase::setAlarm(unsigned long secs, bool delta) {
   _alarmed = false;
   if (delta) {
     _alarm = _clock + secs;
@@ -264,19 +267,19 @@ SakiManager::setAlarm(unsigned long secs, bool delta) {
 }
 
 void
-SakiManager::clearAlarm(void) {
+SakiBase::clearAlarm(void) {
   _alarmed = false;
   _alarm = 0;
 }
 
 /* Just set the clock so that tick() works */
 void
-SakiManager::startClock(void) {
+SakiBase::startClock(void) {
   _clock = 1;
 }
 
 bool
-SakiManager::isAlarmed(bool clear) {
+SakiBase::isAlarmed(bool clear) {
   bool alarmed = _alarmed;
   if (alarmed && clear) {
     _alarmed = false;
@@ -286,177 +289,398 @@ SakiManager::isAlarmed(bool clear) {
 }
 
 void
-SakiManager::setDigitalInput(uint8_t line, bool value) {
-  _setIO(true, true, line, value ? 1L : 0L, 0);
+SakiBase::setDigitalInput(uint8_t line, bool value) {
+  _setIO(true, SAKI_IO_DIGITAL, line, value ? 1L : 0L, 0);
 }
 
 void
-SakiManager::setDigitalOutput(uint8_t line, bool value) {
-  _setIO(false, true, line, value ? 1L : 0L, 0);
+SakiBase::setDigitalOutput(uint8_t line, bool value) {
+  _setIO(false, SAKI_IO_DIGITAL, line, value ? 1L : 0L, 0);
 }
 
 void
-SakiManager::setAnalogInput(uint8_t line, long value, uint8_t precision) {
-  _setIO(true, false, line, value, precision);
+SakiBase::setAnalogInput(uint8_t line, long value, uint8_t precision) {
+  _setIO(true, SAKI_IO_ANALOG, line, value, precision);
 }
 
+/*
+ * A counted input such as a flow or energy meter, taken from a
+ * PulseCounter or similar.  rate is the count over whatever window
+ * the counter uses.
+ */
 void
-SakiManager::_setIO(bool isInput, bool isDigital, uint8_t line, long value, uint8_t precision) {
+SakiBase::setPulseInput(uint8_t line, unsigned long total, unsigned long rate) {
+  _io_line_t * io = _setIO(true, SAKI_IO_PULSE, line, total, 0);
+  if (io) {
+    io->rate = rate;
+  }
+}
+
+_io_line_t *
+SakiBase::_setIO(bool isInput, uint8_t type, uint8_t line, long value, uint8_t precision) {
   _io_line_t ** ioTable;
   uint8_t * count;
+  uint8_t capacity;
   int size;
   if (isInput) {
     ioTable = &_inputTable;
     count = &_inputs;
+    capacity = _inputCapacity;
   } else {
     ioTable = &_outputTable;
     count = &_outputs;
+    capacity = _outputCapacity;
+  }
+  // A fixed table has no room past its capacity
+  if (capacity && line >= capacity) {
+    return NULL;
   }
   if (line >= *count) {
+    if ( ! capacity) {
+      size = sizeof(_io_line_t) * (line + 1);
+      *ioTable = (_io_line_t *)realloc(*ioTable, size);
+    }
+    memset(*ioTable + *count, 0, sizeof(_io_line_t) * (line + 1 - *count));
     *count = line + 1;
-    size = sizeof(_io_line_t) * (*count);
-    *ioTable = (_io_line_t *)realloc(*ioTable, size);
   }
-  (*ioTable)[line].digital = isDigital;
+  (*ioTable)[line].type = type;
   (*ioTable)[line].value = value;
+  (*ioTable)[line].rate = 0;
   (*ioTable)[line].precision = precision;
+  if (_windowStats && isInput && type == SAKI_IO_ANALOG) {
+    _sample(&(*ioTable)[line].stats, value);
+  }
+  return &(*ioTable)[line];
 }
 
+/*
+ * Adds a value to the window.  The mean is updated as a whole part
+ * and a remainder under count, which keeps it exact without a sum
+ * that could overflow.  After 65535 values the mean stops moving but
+ * the min and max still follow.
+ */
 void
-SakiManager::report(bool toController) {
+SakiBase::_sample(_io_stats_t * stats, long value) {
+  if (stats->count == 0) {
+    stats->min = value;
+    stats->max = value;
+    stats->mean = value;
+    stats->rem = 0;
+    stats->count = 1;
+    return;
+  }
+  if (value < stats->min) {
+    stats->min = value;
+  }
+  if (value > stats->max) {
+    stats->max = value;
+  }
+  if (stats->count == 0xffff) {
+    return;
+  }
+  stats->count++;
+  stats->rem += value - stats->mean;
+  stats->mean += stats->rem / (long)stats->count;
+  stats->rem %= (long)stats->count;
+}
+
+/*
+ * value/min/max/mean/count for an analog input in an SX report, the
+ * mean rounded to nearest.  With nothing set in the window all four
+ * are the last value and the count is 0.
+ */
+static char *
+_formatStats(char * buf, _io_line_t * line) {
+  _io_stats_t * stats = &line->stats;
+  long mean = line->value;
+  if (stats->count) {
+    mean = stats->mean + 2 * stats->rem / (long)stats->count;
+  }
+  buf = formatFixed(buf, line->value, line->precision);
+  *buf++ = '/';
+  buf = formatFixed(buf, stats->count ? stats->min : line->value, line->precision);
+  *buf++ = '/';
+  buf = formatFixed(buf, stats->count ? stats->max : line->value, line->precision);
+  *buf++ = '/';
+  buf = formatFixed(buf, mean, line->precision);
+  *buf++ = '/';
+  return formatUnsigned(buf, stats->count);
+}
+
+/* Append one IO line to a report, returning the new end */
+static char *
+_formatLine(char * buf, _io_line_t * line, bool stats) {
+  *buf++ = ':';
+  if (stats && line->type == SAKI_IO_ANALOG) {
+    return _formatStats(buf, line);
+  }
+  if (line->type == SAKI_IO_DIGITAL) {
+    *buf++ = line->value ? 'Y' : 'N';
+    *buf = 0;
+    return buf;
+  }
+  if (line->type == SAKI_IO_PULSE) {
+    buf = formatUnsigned(buf, line->value);
+    *buf++ = '/';
+    return formatUnsigned(buf, line->rate);
+  }
+  return formatFixed(buf, line->value, line->precision);
+}
+
+/*
+ * Build the ST: status message, or with window statistics on the SX:
+ * message, which is the same but for the analog inputs, and start a
+ * new window.  Caller frees the buffer with _freeMessage().
+ */
+char *
+SakiBase::_formatReport(void) {
   char * buf;
-  int size;
+  char * p;
   int i;
-  size = 10 * (_inputs + _outputs);
-  buf = (char *)malloc(size);
-  sprintf(buf, "ST:%d:%d", _inputs, _outputs);
-  size = strlen(buf);
+  int size = 10 + (NUM_FORMAT_MAX + 1) * (_inputs + _outputs);
   for (i = 0; i < _inputs; i++) {
-    if (_inputTable[i].digital) {
-      sprintf(buf+size, ":%s", _inputTable[i].value ? "Y" : "N");
-      size = strlen(buf);
-    } else {
-      if (_inputTable[i].precision) {
-        buf[size++] = ':';
-        formatWithPrecision(buf+size, _inputTable[i].value, _inputTable[i].precision);
-      } else {
-        sprintf(buf+size, ":%ld", _inputTable[i].value);
-      }
-      size = strlen(buf);
+    if (_inputTable[i].type == SAKI_IO_PULSE) {
+      size += NUM_FORMAT_MAX;
+    } else if (_windowStats && _inputTable[i].type == SAKI_IO_ANALOG) {
+      size += 4 * (NUM_FORMAT_MAX + 1);
     }
   }
+  if ((buf = _messageBuffer(size)) == NULL) {
+    return NULL;
+  }
+  strcpy(buf, _windowStats ? "SX:" : "ST:");
+  p = formatLong(buf + 3, _inputs);
+  *p++ = ':';
+  p = formatLong(p, _outputs);
+  for (i = 0; i < _inputs; i++) {
+    p = _formatLine(p, &_inputTable[i], _windowStats);
+    _inputTable[i].stats.count = 0;
+  }
   for (i = 0; i < _outputs; i++) {
-    if (_outputTable[i].digital) {
-      sprintf(buf+size, ":%s", _outputTable[i].value ? "Y" : "N");
-      size = strlen(buf);
-    } else {
-      if (_outputTable[i].precision) {
-        buf[size++] = ':';
-        formatWithPrecision(buf+size, _outputTable[i].value, _outputTable[i].precision);
-      } else {
-        sprintf(buf+size, ":%ld", _outputTable[i].value);
-      }
-      size = strlen(buf);
-    }
+    p = _formatLine(p, &_outputTable[i], false);
   }
-  if (toController) {
-    send(buf);
+  return buf;
+}
+
+void
+SakiBase::formatWithPrecision(char * buf, long value, uint8_t precision) {
+  formatFixed(buf, value, precision);
+}
+
+/* HL:tx:fail:retry:rx:relayed:overflow:modem:lastmodem */
+void
+SakiBase::_formatHealth(char * buf, const saki_health_t * health) {
+  char * p = buf;
+  strcpy(p, "HL:");
+  p = formatUnsigned(p + 3, health->txAttempts);
+  *p++ = ':';
+  p = formatUnsigned(p, health->txFailures);
+  *p++ = ':';
+  p = formatUnsigned(p, health->txRetries);
+  *p++ = ':';
+  p = formatUnsigned(p, health->rxFrames);
+  *p++ = ':';
+  p = formatUnsigned(p, health->relayed);
+  *p++ = ':';
+  p = formatUnsigned(p, health->overflows);
+  *p++ = ':';
+  p = formatUnsigned(p, health->modemEvents);
+  *p++ = ':';
+  formatUnsigned(p, health->lastModemStatus);
+}
+
+/* Take a copy of a message to be sent in fragments, dropping any
+ * still in flight.  Returns false if there is no room for it.  With
+ * fixed storage the copy is in the message buffer, where the message
+ * usually is already. */
+bool
+SakiBase::_queueFragmented(const char * msg, uint16_t len, bool toController) {
+  if (_txBuf) {
+    _log("Fragmented message dropped");
+    _freeMessage(_txBuf);
+    _txBuf = NULL;
+  }
+  if (_messageCapacity) {
+    if (len > _messageCapacity) {
+      _log("Message buffer too small");
+      return false;
+    }
+    if (msg != _message) {
+      memmove(_message, msg, len);
+    }
+    _txBuf = _message;
   } else {
-    reply(buf);
+    _txBuf = (char *)malloc(len);
+    if ( ! _txBuf) {
+      return false;
+    }
+    memcpy(_txBuf, msg, len);
+  }
+  _txLen = len;
+  _txAcked = 0;
+  _txTries = 0;
+  _lastTxSeq = ++_txSeq;
+  _txController = toController;
+  return true;
+}
+
+/* Build the fragment at offset in frame, returning its length.
+ * The last fragment of the message always asks for an ack. */
+uint8_t
+SakiBase::_fragment(uint8_t * frame, uint8_t size, uint16_t offset, bool ack) {
+  uint16_t len = _txLen - offset;
+  if (len > size - SAKI_FRAGMENT_HEADER) {
+    len = size - SAKI_FRAGMENT_HEADER;
+  } else {
+    ack = true;
   }
-  free(buf);
+  frame[0] = ack ? SAKI_FRAGMENT_LAST : SAKI_FRAGMENT;
+  frame[1] = _txSeq;
+  frame[2] = offset & 0xff;
+  frame[3] = offset >> 8;
+  frame[4] = _txLen & 0xff;
+  frame[5] = _txLen >> 8;
+  memcpy(frame + SAKI_FRAGMENT_HEADER, _txBuf + offset, len);
+  return len + SAKI_FRAGMENT_HEADER;
 }
 
-void
-SakiManager::formatWithPrecision(char * buf, long value, uint8_t precision) {
-  switch (precision) {
-    case 1:
-      sprintf(buf, "%ld.%d", value / 10, value % 10);
-      break;
-    case 2:
-      sprintf(buf, "%ld.%02d", value / 100, value % 100);
-      break;
-    case 3:
-      sprintf(buf, "%ld.%03d", value / 1000, value % 1000);
-      break;
-    case 4:
-      sprintf(buf, "%ld.%04d", value / 10000, value % 10000);
-      break;
+/* An ack for the message in flight.  Returns true if the sender
+ * should carry on from the new _txAcked. */
+bool
+SakiBase::_acked(const uint8_t * frame) {
+  uint16_t next = frame[2] | (uint16_t)frame[3] << 8;
+  if ( ! _txBuf || frame[1] != _txSeq || next <= _txAcked) {
+    return false;
   }
+  if (next >= _txLen) {
+    _freeMessage(_txBuf);
+    _txBuf = NULL;
+    return false;
+  }
+  _txAcked = next;
+  _txTries = 0;
+  return true;
 }
 
-void
-SakiManager::setTime(const char **args) {
-  _clock = atol(args[1]);
-  _secondsSinceMidnight = atol(args[2]);
+/* True once the message in flight has gone unacked too long and
+ * should be resent from _txAcked.  Also drops a stale reassembly. */
+bool
+SakiBase::_fragmentTimeout(void) {
+  if (_rxBuf && millis() - _rxTime > SAKI_FRAGMENT_SPAN) {
+    _freeMessage(_rxBuf);
+    _rxBuf = NULL;
+  }
+  if ( ! _txBuf || millis() - _txTime < SAKI_FRAGMENT_TIMEOUT) {
+    return false;
+  }
+  if (++_txTries > SAKI_FRAGMENT_RETRIES) {
+    _log("Fragmented message not acked");
+    _freeMessage(_txBuf);
+    _txBuf = NULL;
+    return false;
+  }
+  return true;
 }
 
-SakiConfig *
-SakiManager::getConfig(void) {
-  return &_config;
+/* Add a received fragment.  Returns true if the sender asked for
+ * an ack, with the ack frame built in ack. */
+bool
+SakiBase::_reassemble(const uint8_t * frame, uint8_t len, uint8_t * ack) {
+  uint16_t offset = frame[2] | (uint16_t)frame[3] << 8;
+  uint16_t total = frame[4] | (uint16_t)frame[5] << 8;
+  len -= SAKI_FRAGMENT_HEADER;
+  /*
+   * A new message has a new sequence, but a sender that has restarted
+   * may reuse the last one.  So the start of any message is taken if
+   * there hasn't been one yet, or the last is finished with and too
+   * old for the sender still to be resending it.
+   */
+  bool finished = ! _rxBuf && (_rxLen == 0 || millis() - _rxTime > SAKI_FRAGMENT_SPAN);
+  if (offset == 0 && (frame[1] != _rxSeq || finished)) {
+    if (_rxBuf) {
+      _freeMessage(_rxBuf);
+    }
+    _rxSeq = frame[1];
+    _rxLen = total;
+    _rxNext = 0;
+    _rxTime = millis();
+    if (_reassemblyCapacity) {
+      _rxBuf = total < _reassemblyCapacity ? _reassembly : NULL;
+    } else {
+      _rxBuf = total <= SAKI_MAX_REASSEMBLY ? (char *)malloc(total + 1) : NULL;
+    }
+    if ( ! _rxBuf) {
+      _log("Fragmented message refused");
+      _rxNext = total;
+    }
+  }
+  if (frame[1] == _rxSeq && _rxBuf && offset == _rxNext
+      && total == _rxLen && offset + len <= _rxLen) {
+    memcpy(_rxBuf + offset, frame + SAKI_FRAGMENT_HEADER, len);
+    _rxNext += len;
+    _rxTime = millis();
+  }
+  // Anything out of order is dropped, the ack sends the sender back
+  ack[0] = SAKI_FRAGMENT_ACK;
+  ack[1] = frame[1];
+  offset = frame[1] == _rxSeq ? _rxNext : 0;
+  ack[2] = offset & 0xff;
+  ack[3] = offset >> 8;
+  return frame[0] == SAKI_FRAGMENT_LAST;
+}
+
+/* The completed message, null terminated, for the caller to
+ * _freeMessage() */
+char *
+SakiBase::_reassembled(void) {
+  char * msg = _rxBuf;
+  if ( ! msg || _rxNext < _rxLen) {
+    return NULL;
+  }
+  msg[_rxLen] = 0;
+  _rxBuf = NULL;
+  return msg;
 }
 
+/*
+ * Keep min, max, mean and count for each analog input over the values
+ * set between reports, and send them in an SX: report in place of ST:
+ * so peaks between reports aren't lost.
+ */
 void
-_SakiSetTime(const char ** args) {
-  _SakiInstance->setTime(args);
+SakiBase::windowStats(bool flag) {
+  _windowStats = flag;
 }
 
+/* Send the health counters to the controller every ms, 0 to stop */
 void
-_SakiGetId(const char ** args) {
-  char buf[32];
-  sprintf(buf, "ID:%s:%d:%d:%s", _SakiInstance->id, _SakiInstance->inputs, _SakiInstance->outputs, _SakiInstance->remote ? "Y" : "N");
-  _SakiInstance->reply(buf);
+SakiBase::healthInterval(unsigned long ms) {
+  _healthInterval = ms;
+  _healthSent = millis();
 }
 
 void
-_SakiSetConfig(const char ** args) {
-  *args++;
-  const char * key;
-  const char * value;
-  while (*args) {
-    key = *args++;
-    if ( ! *args) {
-      break;
-    }
-    value = *args++;
-    _config.set(key, atol(value));
-  }
-  _SakiInstance->configChanged = true;
-  _config.save();
+SakiBase::setTime(const char **args) {
+  _clock = atol(args[1]);
+  _secondsSinceMidnight = atol(args[2]);
 }
 
-void
-_SakiGetConfig(const char ** args) {
-  char * buf;
-  SakiConfigItem * item;
-  int off;
-  int sz;
-  _config.start();
-  sz = 100;
-  buf = (char *)malloc(sz);
-  memcpy(buf, "CF", 2);
-  off = 2;
-  while ((item = _config.next()) != NULL) {
-    if ((sz - off) < 10) {
-      sz += 100;
-      buf = (char *)realloc((char *)buf, sz);
-    }
-    sprintf(buf+off, ":%s", item->print());
-    off = strlen(buf);
-  }
-  _SakiInstance->reply(buf);
-  free(buf);
+SakiConfig *
+SakiBase::getConfig(void) {
+  return _cfg;
 }
 
 SakiConfigItem::SakiConfigItem()
-: value(0L)
+: value(0L),
+generation(0)
 {
   key[0] = '\0';
   key[1] = '\0';
 }
 
 SakiConfigItem::SakiConfigItem(const char * Key)
-: value(0L)
+: value(0L),
+generation(0)
 {
   key[0] = Key[0];
   key[1] = Key[1];
@@ -465,36 +689,49 @@ SakiConfigItem::SakiConfigItem(const char * Key)
 SakiConfig::SakiConfig()
 : _data(NULL),
 _dataSize(0),
-_offset(0)
+_offset(0),
+_capacity(0),
+_generation(0)
+{
+}
+
+/* Items in a fixed table of capacity, rather than on the heap */
+SakiConfig::SakiConfig(SakiConfigItem * items, int capacity)
+: _data(items),
+_dataSize(0),
+_offset(0),
+_capacity(capacity),
+_generation(0)
 {
 }
 
 void SakiConfig::set(const char * key , long val)
 {
   SakiConfigItem * item;
-  if ((item = _get(key)) == NULL) {
-    item = _add(key);
+  if ((item = _get(key)) != NULL) {
+    if (item->value == val) {
+      return;
+    }
+  } else if ((item = _add(key)) == NULL) {
+    return;
   }
   item->value = val;
+  _changed(item);
 }
 
 /* Only set if the key doesn't already exist */
 void SakiConfig::setDefault(const char *key, long val)
 {
   SakiConfigItem * item;
-  if ((item = _get(key)) == NULL) {
-    item = _add(key);
+  if ((item = _get(key)) == NULL && (item = _add(key)) != NULL) {
     item->value = val;
+    _changed(item);
   }
 }
 
 void SakiConfig::set(const char * key, bool val)
 {
-  SakiConfigItem * item;
-  if ((item = _get(key)) == NULL) {
-    item = _add(key);
-  }
-  item->value = val ? 1L : 0L;
+  set(key, val ? 1L : 0L);
 }
 
 long SakiConfig::get(const char * key)
@@ -526,13 +763,29 @@ void SakiConfig::print(void)
 
 SakiConfigItem *
 SakiConfig::_add(const char * key) {
-  int i = _dataSize++;
+  int i = _dataSize;
   SakiConfigItem newItem(key);
-  _data = (SakiConfigItem *)realloc((void *)_data, sizeof(SakiConfigItem) * _dataSize);
+  // A fixed table that is full takes no more
+  if (_capacity && i >= _capacity) {
+    return NULL;
+  }
+  _dataSize++;
+  if ( ! _capacity) {
+    _data = (SakiConfigItem *)realloc((void *)_data, sizeof(SakiConfigItem) * _dataSize);
+  }
   memcpy((void *)(_data+i), (void *)&newItem, sizeof(newItem));
   return _data+i;
 }
 
+/* 0 is skipped when the generation wraps, as it asks for everything */
+void
+SakiConfig::_changed(SakiConfigItem * item) {
+  if (++_generation == 0) {
+    _generation = 1;
+  }
+  item->generation = _generation;
+}
+
 SakiConfigItem *
 SakiConfig::_get(const char * key) {
   for (int i = 0; i < _dataSize; i++) {
@@ -608,11 +861,50 @@ SakiConfig::next(void) {
   return &_data[_offset++];
 }
 
+/*
+ * The next item changed after generation since, or any item if since
+ * is 0.  Generations are compared by how long ago they were, so the
+ * count wrapping doesn't matter.
+ */
+SakiConfigItem *
+SakiConfig::nextChanged(uint16_t since) {
+  SakiConfigItem * item;
+  while ((item = next()) != NULL) {
+    if ( ! since || (uint16_t)(_generation - item->generation) < (uint16_t)(_generation - since)) {
+      return item;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Sum of the CRC16 of each item's key and value (low byte first), so
+ * the order of the items doesn't matter.
+ */
+uint16_t
+SakiConfig::hash(void) {
+  uint16_t sum = 0;
+  for (int i = 0; i < _dataSize; i++) {
+    uint16_t crc = 0xffff;
+    unsigned long value = _data[i].value;
+    crc = _crc16_update(crc, _data[i].key[0]);
+    crc = _crc16_update(crc, _data[i].key[1]);
+    for (uint8_t b = 0; b < 4; b++) {
+      crc = _crc16_update(crc, value & 0xff);
+      value >>= 8;
+    }
+    sum += crc;
+  }
+  return sum;
+}
+
 const char *
 SakiConfigItem::print(void) {
   static char buf[16];
-  memset(buf, 0, 16);
-  sprintf(buf, "%c%c:%ld", key[0], key[1], value);
+  buf[0] = key[0];
+  buf[1] = key[1];
+  buf[2] = ':';
+  formatLong(buf + 3, value);
   return const_cast<const char *>(buf);
 }
 
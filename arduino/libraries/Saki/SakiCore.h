@@ -0,0 +1,726 @@
+/**
+ * Saki Sensor Management library core.  Handler registry, IO
+ * reporting, clock and config handling, independent of the radio
+ * used to carry the messages.
+ *
+ * The radio is a transport policy class given as a template
+ * parameter, so calls to it are resolved at compile time.  See
+ * SakiXBee.h and SakiRF24.h.  A transport provides:
+ *
+ *   void begin(Port &);
+ *   int receive(char * buf, int size);  // -1 if nothing waiting
+ *   void sendController(const char * msg, uint8_t len);
+ *   void sendRespondant(const char * msg, uint8_t len);
+ *   void respondant(char * buf);        // printable sender address
+ *   saki_health_t health;               // link counters
+ *   static const uint8_t payload;       // largest frame it can send
+ *
+ * Messages longer than payload are sent in fragments, see below.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+#ifndef _SAKI_CORE_H
+#define _SAKI_CORE_H
+
+#include "Arduino.h"
+#include <NumFormat.h>
+#include <Log.h>
+
+// Largest message we accept from the radio
+#ifndef SAKI_MAX_MESSAGE
+#define SAKI_MAX_MESSAGE 100
+#endif
+#define SAKI_MAX_TOKENS 20
+// HL: plus eight counters
+#define SAKI_HEALTH_MESSAGE 52
+// CG:generation:hash plus :KK:value for each item
+#define SAKI_CONFIG_MESSAGE(items) (15 + (items) * (NUM_FORMAT_MAX + 4))
+// ST: report with in and out counts, each line as large as it can be
+#define SAKI_REPORT_MESSAGE(inputs, outputs) \
+  (10 + 5 * (NUM_FORMAT_MAX + 1) * (inputs) + (NUM_FORMAT_MAX + 1) * (outputs))
+
+/*
+ * Messages too long for one frame go as fragments, each starting
+ * with a 6 byte header: SAKI_FRAGMENT, or SAKI_FRAGMENT_LAST when
+ * the sender wants an ack, the message sequence, then the offset
+ * and total length as little endian 16 bit values.  The receiver
+ * acks with SAKI_FRAGMENT_ACK, the sequence and the offset it
+ * expects next, and only takes fragments in order.
+ *
+ * The sender sends SAKI_FRAGMENT_WINDOW fragments before it waits,
+ * asking for an ack on the last, and carries on from wherever the
+ * ack says.  With no ack in SAKI_FRAGMENT_TIMEOUT ms it goes back
+ * to the last offset acked, giving up after SAKI_FRAGMENT_RETRIES.
+ * Only one message is in flight, a new one replaces it.
+ *
+ * Both ends hold the whole message while it is in flight, the
+ * receiver refusing (acking as done) anything over
+ * SAKI_MAX_REASSEMBLY.  Single frame messages are sent as they are.
+ */
+#define SAKI_FRAGMENT 0x1f
+#define SAKI_FRAGMENT_LAST 0x1d
+#define SAKI_FRAGMENT_ACK 0x1e
+#define SAKI_FRAGMENT_HEADER 6
+#define SAKI_FRAGMENT_ACK_SIZE 4
+#ifndef SAKI_FRAGMENT_WINDOW
+#define SAKI_FRAGMENT_WINDOW 4
+#endif
+#ifndef SAKI_FRAGMENT_TIMEOUT
+#define SAKI_FRAGMENT_TIMEOUT 1000
+#endif
+#define SAKI_FRAGMENT_RETRIES 3
+#ifndef SAKI_MAX_REASSEMBLY
+#define SAKI_MAX_REASSEMBLY 256
+#endif
+
+typedef void (*callback_t)(const char **);
+typedef struct _handler {
+  const char * key;
+  callback_t method;
+} _handler_t;
+
+/* IO line types.  A pulse line reports its running total and the
+ * pulses in the last counting window as total/rate. */
+#define SAKI_IO_ANALOG 0
+#define SAKI_IO_DIGITAL 1
+#define SAKI_IO_PULSE 2
+
+/* Window statistics for an analog input, over the values set since
+ * the last report.  The mean is kept as mean + rem / count, so it is
+ * exact and nothing grows with the number of samples. */
+typedef struct _io_stats {
+  long min;
+  long max;
+  long mean;
+  long rem;
+  uint16_t count;
+} _io_stats_t;
+
+typedef struct _io_line {
+  uint8_t type;
+  long value;
+  long rate;
+  uint8_t precision;
+  _io_stats_t stats;
+} _io_line_t;
+
+/* Link health counters, kept by the transport.  They count up
+ * from start and wrap, so whoever collects them works from the
+ * differences between reports. */
+typedef struct _saki_health {
+  uint16_t txAttempts;
+  uint16_t txFailures;
+  uint16_t txRetries;
+  uint16_t rxFrames;
+  uint16_t relayed;
+  uint16_t overflows;     // Receive queue overflows and bad frames
+  uint16_t modemEvents;   // XBee modem status frames, eg DISASSOCIATED
+  uint8_t lastModemStatus;
+} saki_health_t;
+
+typedef struct _cfg_item {
+  char key[2];
+  long value;
+} _cfg_item_t;
+
+// Used to store the configs in eeprom.
+// The number of items is limited to fit into the smallest eeprom size
+#define SAKI_MAX_CONFIG 20
+typedef struct _cfg_store {
+  int item_count;
+  _cfg_item_t items[SAKI_MAX_CONFIG];
+} _cfg_store_t;
+
+// Config class
+class SakiConfigItem {
+  public:
+    SakiConfigItem();
+    SakiConfigItem(const char * key);
+    char key[2];
+    long value;
+    uint16_t generation;  // Of the config, when the value last changed
+
+    const char * print(void);
+    bool operator==(SakiConfigItem);
+    bool operator==(const char *);
+};
+
+/*
+ * Every change of value moves the config on a generation, and the
+ * item changed takes that generation.  So a controller that knows the
+ * config as of some generation only needs the items changed since,
+ * which CF?:generation replies with as
+ *
+ *   CG:generation:hash:KK:value...
+ *
+ * and no items at all if nothing has changed.  The hash is of the
+ * whole config, for the controller to check what it has against.
+ * Generations start again from 0 when the node does, and 0 asks for
+ * everything.
+ */
+class SakiConfig {
+  public:
+    SakiConfig();
+    SakiConfig(SakiConfigItem * items, int capacity);
+    long get(const char * key);
+    bool getBool(const char * key);
+
+    void set(const char * key, long value);
+    void set(const char * key, bool value);
+    void setDefault(const char *key, long value);
+    void start(void);
+    void print(void);
+    void load(void);
+    void save(void);
+    SakiConfigItem * next(void);
+    SakiConfigItem * nextChanged(uint16_t since);
+    int count(void) { return _dataSize; }
+    uint16_t generation(void) { return _generation; }
+    uint16_t hash(void);
+
+  private:
+    SakiConfigItem * _get(const char * key);
+    SakiConfigItem * _add(const char * key);
+    void _changed(SakiConfigItem * item);
+
+    SakiConfigItem * _data;
+    int _dataSize;
+    int _offset;
+    int _capacity;
+    uint16_t _generation;
+};
+
+/* Fixed tables and buffers for a manager that doesn't use the heap,
+ * see SakiStaticCore below. */
+typedef struct _saki_storage {
+  _handler_t * handlers;
+  uint8_t handlerCapacity;
+  _io_line_t * inputs;
+  uint8_t inputCapacity;
+  _io_line_t * outputs;
+  uint8_t outputCapacity;
+  SakiConfig * config;
+  char * message;
+  uint16_t messageCapacity;
+  char * reassembly;
+  uint16_t reassemblyCapacity;
+} saki_storage_t;
+
+class SakiBase {
+  public:
+    int inputs;
+    int outputs;
+    const char * id;
+    bool remote;
+    bool configChanged;
+
+    void debug(bool flag);
+    bool handle(char * msg);
+    void registerHandler(const char * key, void (*handler)(const char **));
+    void registerDefaultHandler(void (*handler)(const char **));
+    unsigned long clockTime(void);
+    void tick(void);
+    void setAlarm(unsigned long, bool delta = true);
+    void clearAlarm(void);
+    bool isAlarmed(bool clear = false);
+    void startClock(void);
+    void setDigitalInput(uint8_t ioLine, bool value);
+    void setDigitalOutput(uint8_t ioLine, bool value);
+    void setAnalogInput(uint8_t ioLine, long value, uint8_t precision);
+    void setPulseInput(uint8_t ioLine, unsigned long total, unsigned long rate);
+    void setTime(const char ** args);
+    SakiConfig * getConfig(void);
+    void healthInterval(unsigned long ms);
+    void windowStats(bool flag);
+
+    // Message buffers, for the standard handlers
+    char * _messageBuffer(uint16_t size);
+    void _freeMessage(char * msg);
+
+  protected:
+    void (*_defaultHandler)(const char **);
+    _handler_t * _handlerTable;
+    int _handlerTableSize;
+    bool _debug;
+    bool _alarmed;
+    bool _windowStats;
+    unsigned long _alarm;
+    _io_line_t * _inputTable;
+    _io_line_t * _outputTable;
+    uint8_t _inputs;
+    uint8_t _outputs;
+    // Fixed storage, all 0 when the tables are on the heap
+    uint8_t _handlerCapacity;
+    uint8_t _inputCapacity;
+    uint8_t _outputCapacity;
+    char * _message;
+    uint16_t _messageCapacity;
+    char * _reassembly;
+    uint16_t _reassemblyCapacity;
+    SakiConfig * _cfg;
+    unsigned long _clock;
+    unsigned long _clockUpdated;
+    unsigned long _clockIncrement;
+    unsigned long _secondsSinceMidnight;
+    const char * _tokens[SAKI_MAX_TOKENS + 1];
+    unsigned long _healthInterval;
+    unsigned long _healthSent;
+    // Fragmented message being sent
+    char * _txBuf;
+    uint16_t _txLen;
+    uint16_t _txAcked;
+    uint8_t _txSeq;
+    uint8_t _txTries;
+    bool _txController;
+    unsigned long _txTime;
+    // and being received
+    char * _rxBuf;
+    uint16_t _rxLen;
+    uint16_t _rxNext;
+    uint8_t _rxSeq;
+    unsigned long _rxTime;
+
+    void _init(const char * lid, int ninputs, int noutputs, bool allowRemote);
+    void _useStorage(const saki_storage_t * storage);
+    void _log(const char * msg, bool newline=true);
+    void _logTokens(const char ** tokens);
+    callback_t _handlerRegistered(const char *);
+    const char ** tokenize(char * msg, const char * delim);
+    _io_line_t * _setIO(bool, uint8_t, uint8_t, long, uint8_t precision = 0);
+    char * _formatReport(void);
+    void _sample(_io_stats_t * stats, long value);
+    void formatWithPrecision(char * buf, long value, uint8_t precision);
+    void _formatHealth(char * buf, const saki_health_t * health);
+    bool _queueFragmented(const char * msg, uint16_t len, bool toController);
+    uint8_t _fragment(uint8_t * frame, uint8_t size, uint16_t offset, bool ack);
+    bool _acked(const uint8_t * frame);
+    bool _reassemble(const uint8_t * frame, uint8_t len, uint8_t * ack);
+    char * _reassembled(void);
+    bool _fragmentTimeout(void);
+};
+
+template <class Transport>
+class SakiCore : public SakiBase {
+  public:
+    static SakiCore<Transport> * instance;
+
+    SakiCore(void);
+    SakiCore(const char *, int, int, bool);
+    template <class Port> void start(Port & port);
+    void send(const char * msg);
+    void reply(const char * msg);
+    void check();
+    void report(bool toController = false);
+    void reportHealth(bool toController = true);
+    Transport & transport(void);
+
+  protected:
+    SakiCore(const char *, int, int, bool, const saki_storage_t & storage);
+
+  private:
+    Transport _radio;
+
+    void _registerStandard(void);
+    void _transmit(const char * msg, uint16_t len, bool toController);
+    void _frame(const char * frame, uint8_t len, bool toController);
+    void _sendWindow(void);
+    void _receiveFragment(char * frame, int len);
+    void _dispatch(char * msg);
+};
+
+// Standard handlers, registered by every manager
+template <class Transport> void _SakiSetTime(const char **);
+template <class Transport> void _SakiGetId(const char ** args);
+template <class Transport> void _SakiSetConfig(const char ** args);
+template <class Transport> void _SakiGetConfig(const char ** args);
+template <class Transport> void _SakiGetHealth(const char ** args);
+
+extern SakiConfig _config;
+
+template <class Transport>
+SakiCore<Transport> * SakiCore<Transport>::instance;
+
+template <class Transport>
+SakiCore<Transport>::SakiCore(void)
+{
+  _init(NULL, 0, 0, false);
+  _registerStandard();
+}
+
+template <class Transport>
+SakiCore<Transport>::SakiCore(const char * lid, int ninputs, int noutputs, bool allowRemote)
+{
+  _init(lid, ninputs, noutputs, allowRemote);
+  _registerStandard();
+}
+
+template <class Transport>
+SakiCore<Transport>::SakiCore(const char * lid, int ninputs, int noutputs, bool allowRemote, const saki_storage_t & storage)
+{
+  _init(lid, ninputs, noutputs, allowRemote);
+  _useStorage(&storage);
+  _registerStandard();
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::_registerStandard(void) {
+  registerHandler("TM", &_SakiSetTime<Transport>);
+  registerHandler("ID?", &_SakiGetId<Transport>);
+  registerHandler("CF", &_SakiSetConfig<Transport>);
+  registerHandler("CF?", &_SakiGetConfig<Transport>);
+  registerHandler("HL?", &_SakiGetHealth<Transport>);
+  instance = this;
+}
+
+template <class Transport>
+template <class Port>
+void
+SakiCore<Transport>::start(Port & port) {
+  _radio.begin(port);
+}
+
+template <class Transport>
+Transport &
+SakiCore<Transport>::transport(void) {
+  return _radio;
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::send(const char * msg) {
+  _transmit(msg, strlen(msg), true);
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::reply(const char * msg) {
+  _transmit(msg, strlen(msg), false);
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::_frame(const char * frame, uint8_t len, bool toController) {
+  if (toController) {
+    _radio.sendController(frame, len);
+  } else {
+    _radio.sendRespondant(frame, len);
+  }
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::_transmit(const char * msg, uint16_t len, bool toController) {
+  if (len <= Transport::payload) {
+    _frame(msg, len, toController);
+  } else if (_queueFragmented(msg, len, toController)) {
+    _sendWindow();
+  }
+}
+
+// Send a window of fragments from the last offset acked
+template <class Transport>
+void
+SakiCore<Transport>::_sendWindow(void) {
+  uint8_t frame[Transport::payload];
+  uint16_t offset = _txAcked;
+  uint8_t len;
+  for (uint8_t n = 1; n <= SAKI_FRAGMENT_WINDOW && offset < _txLen; n++) {
+    len = _fragment(frame, sizeof(frame), offset, n == SAKI_FRAGMENT_WINDOW);
+    offset += len - SAKI_FRAGMENT_HEADER;
+    _frame((const char *)frame, len, _txController);
+  }
+  _txTime = millis();
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::_receiveFragment(char * frame, int len) {
+  uint8_t ack[SAKI_FRAGMENT_ACK_SIZE];
+  char * msg;
+  if (len <= SAKI_FRAGMENT_HEADER) {
+    return;
+  }
+  if (_reassemble((const uint8_t *)frame, len, ack)) {
+    _frame((const char *)ack, sizeof(ack), false);
+  }
+  if ((msg = _reassembled()) != NULL) {
+    _dispatch(msg);
+    _freeMessage(msg);
+  }
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::_dispatch(char * msg) {
+  char from[24];
+  // Only build the sender address if it will be logged
+  if (LOG_LEVEL >= LOG_LEVEL_DEBUG && _debug) {
+    _radio.respondant(from);
+    _log("Message from ", false);
+    _log(from, false);
+    _log(": ", false);
+  }
+  if ( ! handle(msg)) {
+    reply("NK");
+    _log("Invalid message received");
+  }
+}
+
+// Does the heavy lifting
+template <class Transport>
+void
+SakiCore<Transport>::check() {
+  char msg[SAKI_MAX_MESSAGE + 1];
+  int len;
+
+  tick();
+  if (_healthInterval && millis() - _healthSent >= _healthInterval) {
+    _healthSent = millis();
+    reportHealth(true);
+  }
+  if (_fragmentTimeout()) {
+    _sendWindow();
+  }
+  if ((len = _radio.receive(msg, sizeof(msg))) < 0) {
+    return;
+  }
+  switch ((uint8_t)msg[0]) {
+    case SAKI_FRAGMENT_ACK:
+      if (len >= SAKI_FRAGMENT_ACK_SIZE && _acked((const uint8_t *)msg)) {
+        _sendWindow();
+      }
+      break;
+    case SAKI_FRAGMENT:
+    case SAKI_FRAGMENT_LAST:
+      _receiveFragment(msg, len);
+      break;
+    default:
+      _dispatch(msg);
+  }
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::report(bool toController) {
+  char * buf = _formatReport();
+  if ( ! buf) {
+    return;
+  }
+  if (toController) {
+    send(buf);
+  } else {
+    reply(buf);
+  }
+  _freeMessage(buf);
+}
+
+template <class Transport>
+void
+SakiCore<Transport>::reportHealth(bool toController) {
+  char buf[SAKI_HEALTH_MESSAGE];
+  _formatHealth(buf, &_radio.health);
+  if (toController) {
+    send(buf);
+  } else {
+    reply(buf);
+  }
+}
+
+template <class Transport>
+void
+_SakiSetTime(const char ** args) {
+  SakiCore<Transport>::instance->setTime(args);
+}
+
+template <class Transport>
+void
+_SakiGetId(const char ** args) {
+  SakiCore<Transport> * mgr = SakiCore<Transport>::instance;
+  char buf[48];
+  char * p;
+  strcpy(buf, "ID:");
+  strncat(buf, mgr->id ? mgr->id : "", 16);
+  p = buf + strlen(buf);
+  *p++ = ':';
+  p = formatLong(p, mgr->inputs);
+  *p++ = ':';
+  p = formatLong(p, mgr->outputs);
+  *p++ = ':';
+  *p++ = mgr->remote ? 'Y' : 'N';
+  *p = 0;
+  mgr->reply(buf);
+}
+
+template <class Transport>
+void
+_SakiSetConfig(const char ** args) {
+  SakiConfig * cfg = SakiCore<Transport>::instance->getConfig();
+  uint16_t generation = cfg->generation();
+  *args++;
+  const char * key;
+  const char * value;
+  while (*args) {
+    key = *args++;
+    if ( ! *args) {
+      break;
+    }
+    value = *args++;
+    cfg->set(key, atol(value));
+  }
+  // Nothing to do if the values were the same
+  if (cfg->generation() == generation) {
+    return;
+  }
+  SakiCore<Transport>::instance->configChanged = true;
+  cfg->save();
+}
+
+template <class Transport>
+void
+_SakiGetConfig(const char ** args) {
+  SakiCore<Transport> * mgr = SakiCore<Transport>::instance;
+  SakiConfig * cfg = mgr->getConfig();
+  SakiConfigItem * item;
+  char * buf;
+  char * p;
+  int off;
+  uint16_t since = 0;
+  bool changed = args[1] != NULL;
+  buf = mgr->_messageBuffer(SAKI_CONFIG_MESSAGE(cfg->count()));
+  if ( ! buf) {
+    return;
+  }
+  if (changed) {
+    // CG:generation:hash, then the items changed since
+    since = atol(args[1]);
+    strcpy(buf, "CG:");
+    p = formatUnsigned(buf + 3, cfg->generation());
+    *p++ = ':';
+    p = formatUnsigned(p, cfg->hash());
+    off = p - buf;
+  } else {
+    // CF, then :KK:value for each
+    memcpy(buf, "CF", 3);
+    off = 2;
+  }
+  cfg->start();
+  while ((item = changed ? cfg->nextChanged(since) : cfg->next()) != NULL) {
+    buf[off++] = ':';
+    strcpy(buf+off, item->print());
+    off += strlen(buf+off);
+  }
+  mgr->reply(buf);
+  mgr->_freeMessage(buf);
+}
+
+template <class Transport>
+void
+_SakiGetHealth(const char ** args) {
+  SakiCore<Transport>::instance->reportHealth(false);
+}
+
+/*
+ * A manager with every table and buffer a fixed size, so it never
+ * touches the heap.  The heap manager grows its tables one element at
+ * a time and mallocs each report, config reply and fragmented
+ * message, which over a long uptime can leave a 2K heap too broken up
+ * to use.  Here the sizes are template parameters:
+ *
+ *   SakiStaticManager<8, 3, 1, 6> manager("PS", true);
+ *
+ * is room for 8 handlers (the 5 standard ones included), 3 inputs,
+ * 1 output and 6 config items.  A handler, input or config item past
+ * those is ignored.  Reports and the config reply are built in the
+ * one message buffer, sized for the largest of them, which is also
+ * what a fragmented message is sent from.  So building a message
+ * drops a fragmented one still in flight, as sending another
+ * fragmented message always has.  Fragmented messages received are
+ * reassembled in SAKI_STATIC_REASSEMBLY bytes.
+ *
+ * Everything is in the manager, so sizeof(manager) is its RAM, and
+ * storageBytes the part in the tables.  Define SAKI_RAM_LIMIT to make
+ * going over it a compile error, or SAKI_RAM_REPORT to have the size
+ * shown as a SakiRamReport<bytes> warning (with compiler warnings on).
+ */
+#ifndef SAKI_STATIC_REASSEMBLY
+#define SAKI_STATIC_REASSEMBLY (SAKI_MAX_MESSAGE + 1)
+#endif
+// TM, ID?, CF, CF? and HL?
+#define SAKI_STANDARD_HANDLERS 5
+
+#ifdef SAKI_RAM_REPORT
+template <unsigned int Bytes>
+struct SakiRamReport {
+  static void __attribute__((deprecated)) bytes(void) {}
+};
+#endif
+
+template <uint8_t Handlers, uint8_t Inputs, uint8_t Outputs, uint8_t ConfigItems>
+class SakiStorage {
+  public:
+    enum {
+      messageSize = SAKI_REPORT_MESSAGE(Inputs, Outputs) > SAKI_CONFIG_MESSAGE(ConfigItems)
+        ? SAKI_REPORT_MESSAGE(Inputs, Outputs) : SAKI_CONFIG_MESSAGE(ConfigItems)
+    };
+
+  protected:
+    SakiStorage(void)
+    : _configStore(_configItems, ConfigItems)
+    {
+    }
+
+    saki_storage_t _storage(void) {
+      saki_storage_t s;
+      s.handlers = _handlers;
+      s.handlerCapacity = Handlers;
+      s.inputs = _inputLines;
+      s.inputCapacity = Inputs;
+      s.outputs = _outputLines;
+      s.outputCapacity = Outputs;
+      s.config = &_configStore;
+      s.message = _messageStore;
+      s.messageCapacity = sizeof(_messageStore);
+      s.reassembly = _reassemblyStore;
+      s.reassemblyCapacity = sizeof(_reassemblyStore);
+      return s;
+    }
+
+  private:
+    _handler_t _handlers[Handlers];
+    // Never 0 long, but only Inputs and Outputs are used
+    _io_line_t _inputLines[Inputs ? Inputs : 1];
+    _io_line_t _outputLines[Outputs ? Outputs : 1];
+    SakiConfigItem _configItems[ConfigItems ? ConfigItems : 1];
+    SakiConfig _configStore;
+    char _messageStore[messageSize];
+    char _reassemblyStore[SAKI_STATIC_REASSEMBLY];
+};
+
+template <class Transport, uint8_t Handlers, uint8_t Inputs, uint8_t Outputs, uint8_t ConfigItems>
+class SakiStaticCore
+: private SakiStorage<Handlers, Inputs, Outputs, ConfigItems>,
+  public SakiCore<Transport> {
+  public:
+    static const uint16_t storageBytes = sizeof(SakiStorage<Handlers, Inputs, Outputs, ConfigItems>);
+
+    // The storage base is built first, so its tables are ready here
+    SakiStaticCore(const char * lid, bool allowRemote)
+    : SakiStorage<Handlers, Inputs, Outputs, ConfigItems>(),
+      SakiCore<Transport>(lid, Inputs, Outputs, allowRemote,
+        SakiStorage<Handlers, Inputs, Outputs, ConfigItems>::_storage())
+    {
+      static_assert(Handlers >= SAKI_STANDARD_HANDLERS, "Saki needs room for its 5 standard handlers");
+      static_assert(ConfigItems <= SAKI_MAX_CONFIG, "Saki saves at most SAKI_MAX_CONFIG config items");
+#ifdef SAKI_RAM_LIMIT
+      static_assert(sizeof(*this) <= SAKI_RAM_LIMIT, "Saki manager is over SAKI_RAM_LIMIT");
+#endif
+#ifdef SAKI_RAM_REPORT
+      SakiRamReport<sizeof(*this)>::bytes();
+#endif
+    }
+};
+
+#endif // _SAKI_CORE_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,123 @@
+/**
+ * RF24Network transport for the Saki core.
+ *
+ * Saki text messages travel as RF24Network frames of type
+ * SAKI_RF24_TYPE ('S').  The controller is the base station at
+ * node 00 and replies go back to the node that sent the request.
+ * Frames of any other type are passed to the handler given to
+ * onFrame(), so sketches can keep their binary messages on the
+ * same network.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+#ifndef _SAKI_RF24_H
+#define _SAKI_RF24_H
+
+#include "Arduino.h"
+#include <RF24Network.h>
+#include "SakiCore.h"
+
+#define SAKI_RF24_TYPE 'S'
+#define SAKI_RF24_CONTROLLER 00
+// Largest Saki frame sent, what fits one radio frame unfragmented
+#ifndef SAKI_RF24_PAYLOAD
+#define SAKI_RF24_PAYLOAD 24
+#endif
+// Largest non-Saki frame passed to the frame handler
+#ifndef SAKI_RF24_FRAME
+#define SAKI_RF24_FRAME 32
+#endif
+
+typedef void (*saki_frame_t)(RF24NetworkHeader &, const void *, uint16_t);
+
+class SakiRF24Transport {
+  public:
+    SakiRF24Transport()
+    : _network(NULL),
+    _respondant(SAKI_RF24_CONTROLLER),
+    _frameHandler(NULL)
+    {
+      memset(&health, 0, sizeof(health));
+    }
+
+    /* The network routes frames for our children itself, so
+     * relayed and overflows are left to the sketch to count. */
+    saki_health_t health;
+    static const uint8_t payload = SAKI_RF24_PAYLOAD;
+
+    void begin(RF24Network & network) {
+      _network = &network;
+    }
+
+    void onFrame(saki_frame_t handler) {
+      _frameHandler = handler;
+    }
+
+    /* Pump the network, dispatching any binary frames, until a Saki
+     * message arrives or nothing is left waiting. */
+    int receive(char * buf, int size) {
+      RF24NetworkHeader header;
+      uint8_t frame[SAKI_RF24_FRAME];
+      uint16_t len;
+
+      _network->update();
+      while (_network->available()) {
+        _network->peek(header);
+        health.rxFrames++;
+        if (header.type == SAKI_RF24_TYPE) {
+          len = _network->read(header, buf, size - 1);
+          buf[len] = 0;
+          _respondant = header.from_node;
+          return len;
+        }
+        len = _network->read(header, frame, sizeof(frame));
+        if (_frameHandler) {
+          _frameHandler(header, frame, len);
+        }
+      }
+      return -1;
+    }
+
+    void sendController(const char * msg, uint8_t len) {
+      _send(msg, len, SAKI_RF24_CONTROLLER);
+    }
+
+    void sendRespondant(const char * msg, uint8_t len) {
+      _send(msg, len, _respondant);
+    }
+
+    void respondant(char * buf) {
+      *buf++ = '0';
+      formatUnsigned(buf, _respondant, 8);
+    }
+
+    /* Write a frame, counting it against the link health */
+    bool write(RF24NetworkHeader & header, const void * msg, uint16_t len) {
+      health.txAttempts++;
+      if (_network->write(header, msg, len)) {
+        return true;
+      }
+      health.txFailures++;
+      return false;
+    }
+
+    RF24Network & network(void) { return *_network; }
+
+  private:
+    RF24Network * _network;
+    uint16_t _respondant;
+    saki_frame_t _frameHandler;
+
+    void _send(const char * msg, uint8_t len, uint16_t to) {
+      RF24NetworkHeader header(to, SAKI_RF24_TYPE);
+      write(header, msg, len);
+    }
+};
+
+typedef SakiCore<SakiRF24Transport> SakiRF24Manager;
+template <uint8_t Handlers, uint8_t Inputs, uint8_t Outputs, uint8_t ConfigItems>
+using SakiStaticRF24Manager = SakiStaticCore<SakiRF24Transport, Handlers, Inputs, Outputs, ConfigItems>;
+
+#endif // _SAKI_RF24_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,126 @@
+/**
+ * XBee (ZigBee API mode) transport for the Saki core.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+#ifndef _SAKI_XBEE_H
+#define _SAKI_XBEE_H
+
+#include "Arduino.h"
+#include <XBee.h>
+#include <NumFormat.h>
+#include "SakiCore.h"
+
+// Largest frame sent, under the unencrypted ZigBee unicast limit
+// (ATNP) with room for source routing
+#ifndef SAKI_XBEE_PAYLOAD
+#define SAKI_XBEE_PAYLOAD 72
+#endif
+
+class SakiXBeeTransport {
+  public:
+    SakiXBeeTransport()
+    : _destController(0, 0),
+    _shortRespondant(0),
+    _lastDeliveryStatus(0),
+    _lastModemStatus(0),
+    _packetTimeout(200)
+    {
+      memset(&health, 0, sizeof(health));
+    }
+
+    saki_health_t health;
+    static const uint8_t payload = SAKI_XBEE_PAYLOAD;
+
+    void begin(Stream & serial) {
+      _radio.begin(serial);
+    }
+
+    /* Poll for a packet, copying any received data into buf as a
+     * string.  Status frames are recorded and -1 returned. */
+    int receive(char * buf, int size) {
+      _radio.readPacket(_packetTimeout);
+      if (_radio.getResponse().isError()) {
+        health.overflows++;
+      }
+      if ( ! _radio.getResponse().isAvailable()) {
+        return -1;
+      }
+      switch (_radio.getResponse().getApiId()) {
+        case ZB_RX_RESPONSE: {
+          ZBRxResponse rx = ZBRxResponse();
+          int len;
+          _radio.getResponse().getZBRxResponse(rx);
+          health.rxFrames++;
+          _shortRespondant = rx.getRemoteAddress16();
+          _destRespondant = rx.getRemoteAddress64();
+          len = rx.getDataLength();
+          if (len >= size) {
+            len = size - 1;
+          }
+          memcpy(buf, rx.getData(), len);
+          buf[len] = 0;
+          return len;
+        }
+        case MODEM_STATUS_RESPONSE: {
+          ModemStatusResponse msr = ModemStatusResponse();
+          _radio.getResponse().getModemStatusResponse(msr);
+          _lastModemStatus = msr.getStatus();
+          health.modemEvents++;
+          health.lastModemStatus = _lastModemStatus;
+          break;
+        }
+        case ZB_TX_STATUS_RESPONSE: {
+          ZBTxStatusResponse txStatus = ZBTxStatusResponse();
+          _radio.getResponse().getZBTxStatusResponse(txStatus);
+          _lastDeliveryStatus = txStatus.getDeliveryStatus();
+          health.txRetries += txStatus.getTxRetryCount();
+          if (_lastDeliveryStatus != SUCCESS) {
+            health.txFailures++;
+          }
+          break;
+        }
+      }
+      return -1;
+    }
+
+    void sendController(const char * msg, uint8_t len) {
+      _send(msg, len, _destController, 0);
+    }
+
+    void sendRespondant(const char * msg, uint8_t len) {
+      _send(msg, len, _destRespondant, _shortRespondant);
+    }
+
+    void respondant(char * buf) {
+      buf = formatUnsigned(buf, _destRespondant.getMsb(), 16);
+      *buf++ = ' ';
+      formatUnsigned(buf, _destRespondant.getLsb(), 16);
+    }
+
+    uint8_t lastDeliveryStatus(void) { return _lastDeliveryStatus; }
+    uint8_t lastModemStatus(void) { return _lastModemStatus; }
+    XBee & radio(void) { return _radio; }
+
+  private:
+    XBee _radio;
+    XBeeAddress64 _destController;
+    XBeeAddress64 _destRespondant;
+    uint16_t _shortRespondant;
+    uint8_t _lastDeliveryStatus;
+    uint8_t _lastModemStatus;
+    int _packetTimeout;
+
+    void _send(const char * msg, uint8_t len, XBeeAddress64 & addr, uint16_t shortAddr) {
+      ZBTxRequest tx = ZBTxRequest(addr, (uint8_t *)msg, len);
+      if (shortAddr) {
+        tx.setAddress16(shortAddr);
+      }
+      health.txAttempts++;
+      _radio.send(tx);
+    }
+};
+
+#endif // _SAKI_XBEE_H
+// vim:ai sw=2 expandtab:
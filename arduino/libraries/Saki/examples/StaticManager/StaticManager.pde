@@ -0,0 +1,76 @@
+/*
+ * Example of the Saki manager with fixed storage.  It reports every
+ * few seconds and prints how much RAM is free, which stays the same
+ * however long it runs and whatever is sent to it, as nothing is
+ * taken from the heap.
+ */
+#include <XBee.h>
+#include <SoftwareSerial.h>
+#include <Saki.h>
+
+/* Report a bit over 100 bytes, to send some fragmented messages */
+#define INPUTS 4
+#define OUTPUTS 2
+
+/* Show the size of the manager as a compiler warning, and make it an
+   error if it is over 600 bytes.  These must come before Saki.h is
+   included anywhere, so they are normally set with the build flags:
+
+#define SAKI_RAM_REPORT
+#define SAKI_RAM_LIMIT 600
+*/
+
+SoftwareSerial ser(5,6);
+/* Create a manager instance. Template arguments are room for:
+   - Handlers, including the 5 standard ones
+   - Inputs
+   - Outputs
+   - Config items
+   Arguments are the name of the instance and whether it may be
+   remotely managed.
+*/
+SakiStaticManager<6, INPUTS, OUTPUTS, 4> manager("ST", true);
+
+unsigned long lastReport = 0;
+
+int freeRam() {
+  extern int __heap_start, *__brkval;
+  int v;
+  return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+}
+
+void echo(const char ** args) {
+  manager.reply("EC");
+}
+
+void setup() {
+  SakiConfig * cfg;
+
+  Serial.begin(9600);
+  ser.begin(9600);
+  manager.start(ser);
+  manager.registerHandler("EC", echo);
+  cfg = manager.getConfig();
+  cfg->load();
+  cfg->setDefault("RP", 5000L);
+  Serial.print("Manager bytes: ");
+  Serial.println(sizeof(manager));
+  Serial.print("Of which tables and buffers: ");
+  Serial.println(manager.storageBytes);
+}
+
+void loop() {
+  manager.check();
+  if (millis() - lastReport > (unsigned long)manager.getConfig()->get("RP")) {
+    lastReport = millis();
+    for (uint8_t i = 0; i < INPUTS; i++) {
+      manager.setAnalogInput(i, analogRead(i), 2);
+    }
+    for (uint8_t i = 0; i < OUTPUTS; i++) {
+      manager.setDigitalOutput(i, digitalRead(7 + i));
+    }
+    manager.report();
+    Serial.print("Free RAM: ");
+    Serial.println(freeRam());
+  }
+}
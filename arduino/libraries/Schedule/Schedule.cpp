@@ -0,0 +1,132 @@
+/* Cron-like schedule windows.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "Schedule.h"
+
+// 1 Jan 1970 was a Thursday
+#define _dayOfWeek(t) ((uint8_t)(((t) / SCHEDULE_SECS_PER_DAY + 4) % 7))
+#define _dayBit(d) ((uint8_t)(1 << (d)))
+
+Schedule::Schedule(long offset)
+: _count(0),
+_offset(offset)
+{
+}
+
+void
+Schedule::setOffset(long offset) {
+  _offset = offset;
+}
+
+bool
+Schedule::add(unsigned long start, unsigned long end, uint8_t days) {
+  if (_count >= SCHEDULE_MAX_ENTRIES) {
+    return false;
+  }
+  _entries[_count].start = start % SCHEDULE_SECS_PER_DAY;
+  _entries[_count].end = end % SCHEDULE_SECS_PER_DAY;
+  _entries[_count].days = days & SCHEDULE_ALL_DAYS;
+  _count++;
+  return true;
+}
+
+/* Convenience for the HHMM values held in sketch configs */
+bool
+Schedule::addHHMM(uint16_t start, uint16_t end, uint8_t days) {
+  return add((start / 100) * 3600UL + (start % 100) * 60UL,
+    (end / 100) * 3600UL + (end % 100) * 60UL, days);
+}
+
+void
+Schedule::clear(void) {
+  _count = 0;
+}
+
+uint8_t
+Schedule::count(void) {
+  return _count;
+}
+
+bool
+Schedule::isActive(unsigned long when) {
+  return _activeLocal(when + _offset);
+}
+
+/*
+ * Returns the first time after `when` at which isActive() changes,
+ * or 0 if it never does (no entries, or overlapping windows that
+ * cover the whole week).
+ */
+unsigned long
+Schedule::nextTransition(unsigned long when) {
+  unsigned long local = when + _offset;
+  unsigned long limit = local + 8 * SCHEDULE_SECS_PER_DAY;
+  bool state = _activeLocal(local);
+
+  if (_count == 0) {
+    return 0;
+  }
+  while (local < limit) {
+    local = _nextBoundary(local);
+    if (_activeLocal(local) != state) {
+      return local - _offset;
+    }
+  }
+  return 0;
+}
+
+bool
+Schedule::_activeLocal(unsigned long local) {
+  unsigned long secs = local % SCHEDULE_SECS_PER_DAY;
+  uint8_t today = _dayOfWeek(local);
+  uint8_t yesterday = (today + 6) % 7;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    _schedule_entry_t * e = &_entries[i];
+    if (e->start < e->end) {
+      if ((e->days & _dayBit(today)) && e->start <= secs && secs < e->end) {
+        return true;
+      }
+    } else if (e->start > e->end) {
+      if ((e->days & _dayBit(today)) && secs >= e->start) {
+        return true;
+      }
+      if ((e->days & _dayBit(yesterday)) && secs < e->end) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/* The next start or end of any entry strictly after `local` */
+unsigned long
+Schedule::_nextBoundary(unsigned long local) {
+  unsigned long midnight = local - (local % SCHEDULE_SECS_PER_DAY);
+  unsigned long best = 0;
+  unsigned long b;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    b = midnight + _entries[i].start;
+    if (b <= local) {
+      b += SCHEDULE_SECS_PER_DAY;
+    }
+    if ( ! best || b < best) {
+      best = b;
+    }
+    b = midnight + _entries[i].end;
+    if (b <= local) {
+      b += SCHEDULE_SECS_PER_DAY;
+    }
+    if (b < best) {
+      best = b;
+    }
+  }
+  return best;
+}
+
+// vim:ai sw=2 expandtab:
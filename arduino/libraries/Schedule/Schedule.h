@@ -0,0 +1,58 @@
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+#include "Arduino.h"
+
+/**
+ * Cron-like time windows for outputs that are driven by the clock.
+ *
+ * Each entry is a window given in seconds since local midnight along
+ * with a day-of-week mask (bit 0 = Sunday, matching weekday() - 1).
+ * A window whose end is earlier than its start wraps past midnight,
+ * in which case the mask applies to the day the window starts.
+ *
+ * Times passed in and returned are UTC seconds (as from now()); the
+ * offset given to the constructor converts them to local time once,
+ * rather than at every comparison.
+ *
+ * Rather than polling, callers ask for nextTransition() and sleep
+ * until then.
+ */
+
+#ifndef SCHEDULE_MAX_ENTRIES
+#define SCHEDULE_MAX_ENTRIES 4
+#endif
+
+#define SCHEDULE_ALL_DAYS 0x7f
+#define SCHEDULE_WEEKDAYS 0x3e
+#define SCHEDULE_WEEKENDS 0x41
+#define SCHEDULE_SECS_PER_DAY 86400UL
+
+typedef struct _schedule_entry {
+  unsigned long start;
+  unsigned long end;
+  uint8_t days;
+} _schedule_entry_t;
+
+class Schedule {
+  public:
+    Schedule(long offset = 0);
+    void setOffset(long offset);
+    bool add(unsigned long start, unsigned long end, uint8_t days = SCHEDULE_ALL_DAYS);
+    bool addHHMM(uint16_t start, uint16_t end, uint8_t days = SCHEDULE_ALL_DAYS);
+    void clear(void);
+    uint8_t count(void);
+    bool isActive(unsigned long when);
+    unsigned long nextTransition(unsigned long when);
+
+  private:
+    _schedule_entry_t _entries[SCHEDULE_MAX_ENTRIES];
+    uint8_t _count;
+    long _offset;
+
+    bool _activeLocal(unsigned long local);
+    unsigned long _nextBoundary(unsigned long local);
+};
+
+#endif // _SCHEDULE_H
+// vim:ai sw=2 expandtab:
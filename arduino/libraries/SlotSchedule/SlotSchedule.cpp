@@ -0,0 +1,132 @@
+/* Time slotted transmit schedule.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "SlotSchedule.h"
+
+SlotSchedule::SlotSchedule(uint8_t depth, uint16_t slotMs, uint16_t guardMs)
+: _depth(depth),
+_slotMs(slotMs),
+_guardMs(guardMs),
+_slot(SLOT_NONE),
+_syncOffset(0),
+_syncMillis(0),
+_synced(false)
+{
+}
+
+void
+SlotSchedule::begin(uint16_t address) {
+  _slot = slotFor(address);
+}
+
+/* Nodes in the subtree under a node at level (1 = children of 00),
+ * including the node itself. */
+uint16_t
+SlotSchedule::_subtree(uint8_t level) {
+  uint16_t size = 1;
+  for (uint8_t l = level; l < _depth; l++) {
+    size = size * SLOT_FANOUT + 1;
+  }
+  return size;
+}
+
+/* The subtrees of earlier siblings at each level come first, then
+ * our own subtree with ourselves last. */
+uint16_t
+SlotSchedule::slotFor(uint16_t address) {
+  uint16_t slot = 0;
+  uint8_t level = 0;
+  uint8_t digit;
+
+  if (address == 0) {
+    return slots() - 1;
+  }
+  while (address) {
+    digit = address & 07;
+    address >>= 3;
+    if (digit < 1 || digit > SLOT_FANOUT || ++level > _depth) {
+      return SLOT_NONE;
+    }
+    slot += (digit - 1) * _subtree(level);
+  }
+  return slot + _subtree(level) - 1;
+}
+
+uint16_t
+SlotSchedule::slots(void) {
+  return SLOT_FANOUT * _subtree(1) + 1;
+}
+
+uint16_t
+SlotSchedule::slot(void) {
+  return _slot;
+}
+
+unsigned long
+SlotSchedule::superframe(void) {
+  return (unsigned long)slots() * _slotMs;
+}
+
+/* Superframes start on whole seconds of epoch time; work out where
+ * the sync second falls in a superframe without overflowing. */
+void
+SlotSchedule::sync(unsigned long epoch) {
+  unsigned long frame = superframe();
+  _syncMillis = millis();
+  _syncOffset = ((epoch % frame) * 1000UL) % frame;
+  _synced = true;
+}
+
+bool
+SlotSchedule::synced(void) {
+  return _synced;
+}
+
+unsigned long
+SlotSchedule::position(void) {
+  return (_syncOffset + (millis() - _syncMillis)) % superframe();
+}
+
+bool
+SlotSchedule::inSlot(void) {
+  unsigned long start;
+  unsigned long pos;
+  if ( ! _synced || _slot == SLOT_NONE) {
+    return true;
+  }
+  start = (unsigned long)_slot * _slotMs;
+  pos = position();
+  return pos >= start + _guardMs && pos < start + _slotMs - _guardMs;
+}
+
+/* ms until our slot opens, 0 while it is open */
+unsigned long
+SlotSchedule::untilSlot(void) {
+  if (inSlot()) {
+    return 0;
+  }
+  return nextSlot();
+}
+
+/* ms until our slot next opens, a whole superframe if it just has */
+unsigned long
+SlotSchedule::nextSlot(void) {
+  unsigned long frame = superframe();
+  unsigned long open;
+  unsigned long pos;
+  if ( ! _synced || _slot == SLOT_NONE) {
+    return 0;
+  }
+  open = (unsigned long)_slot * _slotMs + _guardMs;
+  pos = position();
+  if (pos < open) {
+    return open - pos;
+  }
+  return frame - pos + open;
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,75 @@
+#ifndef _SLOT_SCHEDULE_H
+#define _SLOT_SCHEDULE_H
+
+#include "Arduino.h"
+
+/**
+ * Time slotted transmit schedule for an RF24Network tree.
+ *
+ * Every node gets its own slot in a repeating superframe, worked
+ * out from its octal address, so nodes that share a clock never
+ * transmit together.  Each octal digit, from the lowest, is a
+ * level in the tree holding children 1-5, up to depth levels
+ * deep.
+ *
+ * Slots run in post-order: a node's children, and theirs, all
+ * come before the node itself, and the base station (00) takes
+ * the last slot for traffic going down the tree.  RF24Network
+ * passes frames toward 00 as soon as they arrive, so the slot
+ * length has to cover the frame plus a forwarding hop for each
+ * level above the sender.  Those hops are the relays' forwarding
+ * slots.  A relay's own slot comes straight after its subtree's,
+ * so it can hold and merge what its children sent.
+ *
+ * Nodes synchronise from the time messages.  The superframe is
+ * aligned to whole seconds of epoch time, so the base should send
+ * the time at the top of a second.  guard is left at each end of
+ * the slot to allow for clock drift between syncs.
+ *
+ * Until synced, or for an address that doesn't fit the tree,
+ * inSlot() is always true so the node transmits as before.
+ */
+
+#define SLOT_FANOUT 5
+
+#ifndef SLOT_DEPTH
+#define SLOT_DEPTH 4
+#endif
+#ifndef SLOT_MS
+#define SLOT_MS 20
+#endif
+#ifndef SLOT_GUARD_MS
+#define SLOT_GUARD_MS 3
+#endif
+
+#define SLOT_NONE 0xffff
+
+class SlotSchedule {
+  public:
+    SlotSchedule(uint8_t depth = SLOT_DEPTH, uint16_t slotMs = SLOT_MS, uint16_t guardMs = SLOT_GUARD_MS);
+    void begin(uint16_t address);
+    void sync(unsigned long epoch);
+    bool synced(void);
+    uint16_t slot(void);
+    uint16_t slots(void);
+    uint16_t slotFor(uint16_t address);
+    unsigned long superframe(void);
+    unsigned long position(void);
+    bool inSlot(void);
+    unsigned long untilSlot(void);
+    unsigned long nextSlot(void);
+
+  private:
+    uint8_t _depth;
+    uint16_t _slotMs;
+    uint16_t _guardMs;
+    uint16_t _slot;
+    unsigned long _syncOffset;
+    unsigned long _syncMillis;
+    bool _synced;
+
+    uint16_t _subtree(uint8_t level);
+};
+
+#endif // _SLOT_SCHEDULE_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,134 @@
+/* SoftTimer task instrumentation.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include <NumFormat.h>
+#include "TaskStats.h"
+
+InstrumentedTask * InstrumentedTask::_first = NULL;
+
+/* The Task is given our trampoline as its callback, which times
+ * the real one.  Tasks are chained so they can all be reported. */
+InstrumentedTask::InstrumentedTask(unsigned long periodMs, void (*callback)(Task *), const char * taskName)
+: Task(periodMs, &InstrumentedTask::_run),
+name(taskName),
+_callback(callback),
+_next(_first)
+{
+  _first = this;
+  reset();
+}
+
+void
+InstrumentedTask::reset(void) {
+  runs = 0;
+  overruns = 0;
+  minMicros = 0xffffffffUL;
+  maxMicros = 0;
+  totalMicros = 0;
+  for (uint8_t i = 0; i < TASK_STATS_BUCKETS; i++) {
+    late[i] = 0;
+  }
+}
+
+/* SoftTimer updates lastCallTimeMicros after the callback returns,
+ * so on entry it still holds the previous start. */
+void
+InstrumentedTask::_run(Task * me) {
+  InstrumentedTask * task = (InstrumentedTask *)me;
+  unsigned long start = micros();
+  unsigned long lateBy = start - (me->lastCallTimeMicros + me->periodMicros);
+  unsigned long limit = TASK_STATS_BUCKET_MIN;
+  unsigned long took;
+  uint8_t bucket = 0;
+
+  task->_callback(me);
+  took = micros() - start;
+
+  if ((long)lateBy < 0) {
+    lateBy = 0;
+  }
+  while (bucket < TASK_STATS_BUCKETS - 1 && lateBy >= limit) {
+    bucket++;
+    limit *= 10;
+  }
+  if (task->late[bucket] != 0xffff) {
+    task->late[bucket]++;
+  }
+  if (task->runs == 0xffff) {
+    return;
+  }
+  task->runs++;
+  task->totalMicros += took;
+  if (took < task->minMicros) {
+    task->minMicros = took;
+  }
+  if (took > task->maxMicros) {
+    task->maxMicros = took;
+  }
+  if (me->periodMicros && took > me->periodMicros) {
+    task->overruns++;
+  }
+}
+
+/* name:runs:min:mean:max:overruns:late... with times in us */
+char *
+InstrumentedTask::format(char * buf, bool clear) {
+  char * p = buf;
+  strncpy(p, name, 8);
+  p[8] = 0;
+  p += strlen(p);
+  *p++ = ':';
+  p = formatUnsigned(p, runs);
+  *p++ = ':';
+  p = formatUnsigned(p, runs ? minMicros : 0);
+  *p++ = ':';
+  p = formatUnsigned(p, runs ? totalMicros / runs : 0);
+  *p++ = ':';
+  p = formatUnsigned(p, maxMicros);
+  *p++ = ':';
+  p = formatUnsigned(p, overruns);
+  for (uint8_t i = 0; i < TASK_STATS_BUCKETS; i++) {
+    *p++ = ':';
+    p = formatUnsigned(p, late[i]);
+  }
+  if (clear) {
+    reset();
+  }
+  return p;
+}
+
+void
+InstrumentedTask::print(Print & out, bool clear) {
+  char buf[TASK_STATS_LINE];
+  format(buf, clear);
+  out.println(buf);
+}
+
+InstrumentedTask *
+InstrumentedTask::next(void) {
+  return _next;
+}
+
+InstrumentedTask *
+InstrumentedTask::first(void) {
+  return _first;
+}
+
+void
+InstrumentedTask::printAll(Print & out, bool clear) {
+  out.println(F("task:runs:min:mean:max:over:<100u:<1m:<10m:<100m:more"));
+  for (InstrumentedTask * t = _first; t != NULL; t = t->_next) {
+    t->print(out, clear);
+  }
+}
+
+void
+InstrumentedTask::printAllTask(Task * me) {
+  printAll(Serial);
+}
+
+// vim:ai sw=2 expandtab:
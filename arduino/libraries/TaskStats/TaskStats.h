@@ -0,0 +1,105 @@
+#ifndef _TASK_STATS_H
+#define _TASK_STATS_H
+
+#include "Arduino.h"
+#include <Task.h>
+
+/**
+ * Run time and start jitter figures for SoftTimer tasks.
+ *
+ * Declare tasks as StatTask instead of Task, with a short name:
+ *
+ *   StatTask sensorScan(395, sensorScanTask, "SS");
+ *
+ * With TASK_STATS set to 1 before this header is included, each
+ * call is timed with micros() and the task keeps:
+ *
+ *   - the number of runs
+ *   - min/mean/max run time in microseconds
+ *   - overruns, where a run took longer than the period
+ *   - a histogram of how late each run started, in decades
+ *     from under 100us to over 100ms
+ *
+ * With TASK_STATS 0 a StatTask is a plain Task and the name is
+ * discarded, so the instrumentation costs nothing.
+ *
+ * The figures can be printed or formatted as a line of text, for
+ * example to answer a radio query.  Both reset the counts, so each
+ * report covers the time since the last.  For the usual sketch:
+ *
+ *   Task statsDump(TASK_STATS_MS, InstrumentedTask::printAllTask);
+ *   ...
+ *   void sakiTaskStats(const char ** args)
+ *   {
+ *     InstrumentedTask::replyAll(manager);
+ *   }
+ */
+
+#ifndef TASK_STATS
+#define TASK_STATS 0
+#endif
+
+// Late start buckets, <100us, <1ms, <10ms, <100ms, longer
+#define TASK_STATS_BUCKETS 5
+#define TASK_STATS_BUCKET_MIN 100UL
+// Longest formatted line, including the null
+#define TASK_STATS_LINE 96
+
+class InstrumentedTask : public Task {
+  public:
+    InstrumentedTask(unsigned long periodMs, void (*callback)(Task *), const char * name);
+
+    const char * name;
+    uint16_t runs;
+    uint16_t overruns;
+    unsigned long minMicros;
+    unsigned long maxMicros;
+    unsigned long totalMicros;
+    uint16_t late[TASK_STATS_BUCKETS];
+
+    void reset(void);
+    char * format(char * buf, bool clear = true);
+    void print(Print & out, bool clear = true);
+    InstrumentedTask * next(void);
+
+    static InstrumentedTask * first(void);
+    static void printAll(Print & out, bool clear = true);
+    // A Task callback, printAll() to Serial
+    static void printAllTask(Task * me);
+    // Each task as a TS: line to manager.reply(), for TS?
+    template <class Manager> static void replyAll(Manager & manager, bool clear = true);
+
+  private:
+    void (*_callback)(Task *);
+    InstrumentedTask * _next;
+    static InstrumentedTask * _first;
+
+    static void _run(Task * me);
+};
+
+template <class Manager>
+void
+InstrumentedTask::replyAll(Manager & manager, bool clear)
+{
+  char buf[TASK_STATS_LINE + 3];
+  strcpy(buf, "TS:");
+  for (InstrumentedTask * t = _first; t != NULL; t = t->_next) {
+    t->format(buf + 3, clear);
+    manager.reply(buf);
+  }
+}
+
+#if TASK_STATS
+typedef InstrumentedTask StatTask;
+#else
+class StatTask : public Task {
+  public:
+    StatTask(unsigned long periodMs, void (*callback)(Task *), const char *)
+    : Task(periodMs, callback)
+    {
+    }
+};
+#endif
+
+#endif // _TASK_STATS_H
+// vim:ai sw=2 expandtab:
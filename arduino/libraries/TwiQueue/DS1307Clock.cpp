@@ -0,0 +1,133 @@
+/* DS1307 real time clock on the TwiQueue.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include "DS1307Clock.h"
+
+// Clock halt, in the seconds register
+#define DS1307_CH 0x80
+
+static uint8_t
+bcd2dec(uint8_t b)
+{
+  return (b >> 4) * 10 + (b & 0x0f);
+}
+
+static uint8_t
+dec2bcd(uint8_t n)
+{
+  return ((n / 10) << 4) | (n % 10);
+}
+
+DS1307Clock::DS1307Clock(void)
+: _read(DS1307_ADDRESS, &(DS1307Clock::_done), this),
+_write(DS1307_ADDRESS, &(DS1307Clock::_written), this),
+_ready(false),
+_again(false)
+{
+  _read.reg[0] = 0;
+  _read.regLen = 1;
+  _read.rx = _in;
+  _read.rxLen = DS1307_REGISTERS;
+  _write.reg[0] = 0;
+  _write.regLen = 1;
+  _write.tx = _out;
+  _write.txLen = DS1307_REGISTERS;
+}
+
+// Starts a read, unless one is already under way
+void
+DS1307Clock::request(void)
+{
+  if (_read.pending()) {
+    return;
+  }
+  _ready = false;
+  TwiBus.add(&_read);
+}
+
+bool
+DS1307Clock::ready(void)
+{
+  if (_ready) {
+    _ready = false;
+    return true;
+  }
+  return false;
+}
+
+// The time from the last read, 0 if the clock is halted
+time_t
+DS1307Clock::time(void)
+{
+  tmElements_t tm;
+  if (_in[0] & DS1307_CH) {
+    return 0;
+  }
+  tm.Second = bcd2dec(_in[0] & 0x7f);
+  tm.Minute = bcd2dec(_in[1]);
+  tm.Hour = bcd2dec(_in[2] & 0x3f);
+  tm.Wday = bcd2dec(_in[3]);
+  tm.Day = bcd2dec(_in[4]);
+  tm.Month = bcd2dec(_in[5]);
+  tm.Year = y2kYearToTm(bcd2dec(_in[6]));
+  return makeTime(tm);
+}
+
+/*
+ * Queues writing t, 24 hour and running.  If the last set() is still
+ * going out, the new time is written again after it.
+ */
+void
+DS1307Clock::set(time_t t)
+{
+  tmElements_t tm;
+  uint8_t sreg;
+  breakTime(t, tm);
+  sreg = SREG;
+  cli();
+  _out[0] = dec2bcd(tm.Second);
+  _out[1] = dec2bcd(tm.Minute);
+  _out[2] = dec2bcd(tm.Hour);
+  _out[3] = dec2bcd(tm.Wday);
+  _out[4] = dec2bcd(tm.Day);
+  _out[5] = dec2bcd(tm.Month);
+  _out[6] = dec2bcd(tmYearToY2k(tm.Year));
+  if (_write.pending()) {
+    _again = true;
+  } else {
+    TwiBus.add(&_write);
+  }
+  SREG = sreg;
+}
+
+// Reads the time and waits for it, 0 if there's no answer
+time_t
+DS1307Clock::get(void)
+{
+  request();
+  TwiBus.wait(&_read);
+  _ready = false;
+  return present() ? time() : 0;
+}
+
+void
+DS1307Clock::_done(TwiJob * job)
+{
+  ((DS1307Clock *)job->context)->_ready = true;
+}
+
+void
+DS1307Clock::_written(TwiJob * job)
+{
+  DS1307Clock * me = (DS1307Clock *)job->context;
+  if (me->_again) {
+    me->_again = false;
+    TwiBus.add(job);
+  }
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,55 @@
+#ifndef _DS1307_CLOCK_H
+#define _DS1307_CLOCK_H
+
+#include "Arduino.h"
+#include <Time.h>
+#include "TwiQueue.h"
+
+/**
+ * DS1307 real time clock on the TwiQueue.
+ *
+ * DS1307RTC::get() waits on the bus for the whole read, and as a
+ * TimeLib sync provider it does so from inside whatever now() or
+ * hour() call happens to fall due.  Here the time is requested and
+ * picked up later, so the sketch decides when the clock is synced
+ * and never waits for it:
+ *
+ *   rtc.request();
+ *   ...
+ *   if (rtc.ready() && rtc.present()) {
+ *     setTime(rtc.time());
+ *   }
+ *
+ * ready() is true once for each read, answered or not.  time() is 0
+ * if the clock is halted, as a new or flat-battery chip is.  set()
+ * queues writing the time and returns.  get() reads and waits, for
+ * setup().
+ */
+
+#define DS1307_ADDRESS 0x68
+#define DS1307_REGISTERS 7
+
+class DS1307Clock {
+  public:
+    DS1307Clock(void);
+    void request(void);
+    bool ready(void);
+    bool present(void) { return _read.status == TWI_DONE; }
+    time_t time(void);
+    void set(time_t t);
+    time_t get(void);
+
+  private:
+    static void _done(TwiJob * job);
+    static void _written(TwiJob * job);
+
+    TwiJob _read;
+    TwiJob _write;
+    uint8_t _in[DS1307_REGISTERS];
+    uint8_t _out[DS1307_REGISTERS];
+    volatile bool _ready;
+    volatile bool _again;
+};
+
+#endif // _DS1307_CLOCK_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,240 @@
+/* Interrupt driven I2C job queue.
+ *
+ * Author: Adam Donnison <adam@sakienvirotech.com>
+ * License: LGPL
+ */
+
+#include "Arduino.h"
+#include <util/twi.h>
+#include "TwiQueue.h"
+
+// Clear TWINT to let the hardware carry on, interrupting when it's done
+#define TWI_GO (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+TwiQueue TwiBus;
+
+TwiJob::TwiJob(uint8_t address, twi_callback_t done, void * context)
+: address(address),
+regLen(0),
+tx(NULL),
+txLen(0),
+rx(NULL),
+rxLen(0),
+retries(0),
+done(done),
+context(context),
+status(TWI_IDLE),
+next(NULL),
+_tries(0)
+{
+}
+
+TwiQueue::TwiQueue(void)
+: _head(NULL),
+_tail(NULL),
+_index(0),
+_finishing(false)
+{
+}
+
+// Internal pull ups on SDA and SCL, as Wire does
+void
+TwiQueue::begin(unsigned long frequency)
+{
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  TWSR = 0;
+  TWBR = ((F_CPU / frequency) - 16) / 2;
+  TWCR = _BV(TWEN) | _BV(TWIE);
+}
+
+/*
+ * Queues job, starting it straight away if the bus is free.  Returns
+ * false if the job is already pending.
+ */
+bool
+TwiQueue::add(TwiJob * job)
+{
+  uint8_t sreg;
+  if (job->pending()) {
+    return false;
+  }
+  job->next = NULL;
+  job->_tries = job->retries;
+  job->status = TWI_QUEUED;
+  sreg = SREG;
+  cli();
+  if (_head) {
+    _tail->next = job;
+    _tail = job;
+  } else {
+    _head = job;
+    _tail = job;
+    // From a callback _finish() starts it
+    if (! _finishing) {
+      _start();
+    }
+  }
+  SREG = sreg;
+  return true;
+}
+
+/*
+ * Waits for job to finish, for setup() and the like.  If the bus
+ * hangs the job under way is failed with TWI_ERROR after timeoutMs
+ * and the interface reset.  Needs interrupts on, so not for use in a
+ * callback.
+ */
+uint8_t
+TwiQueue::wait(TwiJob * job, unsigned long timeoutMs)
+{
+  unsigned long start = millis();
+  while (job->pending()) {
+    if (millis() - start > timeoutMs) {
+      uint8_t sreg = SREG;
+      cli();
+      if (_head) {
+        TWCR = 0;
+        _finish(TWI_ERROR);
+      }
+      SREG = sreg;
+      start = millis();
+    }
+  }
+  return job->status;
+}
+
+// Called with interrupts off and the bus stopped
+void
+TwiQueue::_start(void)
+{
+  while (TWCR & _BV(TWSTO))
+    ;
+  _index = 0;
+  _head->status = TWI_BUSY;
+  TWCR = TWI_GO | _BV(TWSTA);
+}
+
+/*
+ * Takes the job under way off the queue and calls back, then stops
+ * the bus or, if anything is waiting, stops and starts the next job
+ * in the one go.
+ */
+void
+TwiQueue::_finish(uint8_t status)
+{
+  TwiJob * job = _head;
+  _head = job->next;
+  if (! _head) {
+    _tail = NULL;
+  }
+  job->next = NULL;
+  job->status = status;
+  _finishing = true;
+  if (job->done) {
+    job->done(job);
+  }
+  _finishing = false;
+  _index = 0;
+  if (_head) {
+    _head->status = TWI_BUSY;
+    TWCR = TWI_GO | _BV(TWSTO) | _BV(TWSTA);
+  } else {
+    TWCR = TWI_GO | _BV(TWSTO);
+  }
+}
+
+/*
+ * _index counts the bytes of the job so far: reg, then tx, then rx.
+ * A job with nothing to send or read just addresses the device, to
+ * see if it is there.
+ */
+void
+TwiQueue::_interrupt(void)
+{
+  TwiJob * job = _head;
+  uint8_t writeLen;
+
+  if (! job) {
+    TWCR = TWI_GO | _BV(TWSTO);
+    return;
+  }
+  writeLen = job->regLen + job->txLen;
+  switch (TW_STATUS) {
+    case TW_START:
+    case TW_REP_START:
+      if (_index < writeLen || job->rxLen == 0) {
+        TWDR = (job->address << 1) | TW_WRITE;
+      } else {
+        TWDR = (job->address << 1) | TW_READ;
+      }
+      TWCR = TWI_GO;
+      break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (_index < job->regLen) {
+        TWDR = job->reg[_index++];
+        TWCR = TWI_GO;
+      } else if (_index < writeLen) {
+        TWDR = job->tx[_index++ - job->regLen];
+        TWCR = TWI_GO;
+      } else if (job->rxLen) {
+        TWCR = TWI_GO | _BV(TWSTA);
+      } else {
+        _finish(TWI_DONE);
+      }
+      break;
+
+    case TW_MR_DATA_ACK:
+      job->rx[_index++ - writeLen] = TWDR;
+      // Fall through
+    case TW_MR_SLA_ACK:
+      // Ack all but the last byte
+      if (_index + 1 < writeLen + job->rxLen) {
+        TWCR = TWI_GO | _BV(TWEA);
+      } else {
+        TWCR = TWI_GO;
+      }
+      break;
+
+    case TW_MR_DATA_NACK:
+      job->rx[_index++ - writeLen] = TWDR;
+      _finish(TWI_DONE);
+      break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MR_SLA_NACK:
+      if (! job->_tries) {
+        _finish(TWI_NACK_ADDRESS);
+        break;
+      }
+      // Try again after anything else waiting
+      job->_tries--;
+      if (job->next) {
+        _head = job->next;
+        _tail->next = job;
+        _tail = job;
+        job->next = NULL;
+        job->status = TWI_QUEUED;
+        _head->status = TWI_BUSY;
+      }
+      _index = 0;
+      TWCR = TWI_GO | _BV(TWSTO) | _BV(TWSTA);
+      break;
+
+    case TW_MT_DATA_NACK:
+      _finish(TWI_NACK_DATA);
+      break;
+
+    default:
+      // Lost arbitration or a bus error
+      _finish(TWI_ERROR);
+  }
+}
+
+ISR(TWI_vect) {
+  TwiBus._interrupt();
+}
+
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,102 @@
+#ifndef _TWI_QUEUE_H
+#define _TWI_QUEUE_H
+
+#include "Arduino.h"
+
+/**
+ * Interrupt driven I2C (TWI) job queue.
+ *
+ * Wire waits in a loop for every byte, so a 32 byte EEPROM page is
+ * about 3ms of nothing at 100kHz and the 5ms write cycle after it
+ * more again.  Here a transfer is described by a TwiJob and queued;
+ * the TWI interrupt moves it along a byte at a time and calls the
+ * job's callback when it finishes, then starts the next job.  The
+ * sketch carries on in the meantime.
+ *
+ * A job sends up to two register (or memory address) bytes, then
+ * tx, then with a repeated start reads rx:
+ *
+ *   TwiJob job(0x68, clockRead, NULL);
+ *   job.reg[0] = 0;
+ *   job.regLen = 1;
+ *   job.rx = buf;
+ *   job.rxLen = 7;
+ *   TwiBus.add(&job);
+ *
+ * The callback runs in the interrupt, so keep it short.  It may add
+ * jobs, including its own.  tx and rx must stay put until the job is
+ * finished, and a job can't be added again while it is pending().
+ *
+ * A device that doesn't answer its address is retried job->retries
+ * times, after any other jobs waiting, which is how an EEPROM is
+ * polled through its write cycle without holding up the clock.
+ *
+ * This takes the TWI interrupt, so it can't be used alongside Wire
+ * or libraries built on it, such as DS1307RTC (see DS1307Clock.h).
+ */
+
+#ifndef TWI_FREQ
+#define TWI_FREQ 100000L
+#endif
+// How long wait() gives a job before resetting the bus
+#ifndef TWI_TIMEOUT_MS
+#define TWI_TIMEOUT_MS 50
+#endif
+
+// Job status
+#define TWI_IDLE 0          // Never added
+#define TWI_QUEUED 1
+#define TWI_BUSY 2
+#define TWI_DONE 3
+#define TWI_NACK_ADDRESS 4  // No device, or still busy after the retries
+#define TWI_NACK_DATA 5
+#define TWI_ERROR 6         // Bus error, lost arbitration or timeout
+
+class TwiJob;
+typedef void (*twi_callback_t)(TwiJob * job);
+
+class TwiJob {
+  public:
+    TwiJob(uint8_t address, twi_callback_t done = NULL, void * context = NULL);
+    bool pending(void) { return status == TWI_QUEUED || status == TWI_BUSY; }
+
+    uint8_t address;
+    uint8_t reg[2];
+    uint8_t regLen;
+    const uint8_t * tx;
+    uint8_t txLen;
+    uint8_t * rx;
+    uint8_t rxLen;
+    uint8_t retries;
+    twi_callback_t done;
+    void * context;
+    volatile uint8_t status;
+    TwiJob * next;
+    uint8_t _tries;
+};
+
+class TwiQueue {
+  public:
+    TwiQueue(void);
+    void begin(unsigned long frequency = TWI_FREQ);
+    bool add(TwiJob * job);
+    bool busy(void) { return _head != NULL; }
+    uint8_t wait(TwiJob * job, unsigned long timeoutMs = TWI_TIMEOUT_MS);
+
+    // Called from the TWI interrupt
+    void _interrupt(void);
+
+  private:
+    void _start(void);
+    void _finish(uint8_t status);
+
+    TwiJob * volatile _head;
+    TwiJob * _tail;
+    uint8_t _index;
+    bool _finishing;
+};
+
+extern TwiQueue TwiBus;
+
+#endif // _TWI_QUEUE_H
+// vim:ai sw=2 expandtab:
@@ -0,0 +1,71 @@
+/*
+ * A TinyRTC board (DS1307 and AT24C32) on A4/A5.  Every five seconds
+ * 128 bytes are written to the EEPROM, four pages with a write cycle
+ * after each, while the loop keeps counting and the clock is read
+ * part way through.  The report shows how many loop passes the write
+ * took (with Wire it would have been one, of about 25ms) and that the
+ * clock answered before the EEPROM was done.
+ */
+#include <SoftTimer.h>
+#include <Time.h>
+#include <TwiQueue.h>
+#include <DS1307Clock.h>
+#include <AT24C32.h>
+
+#define BLOCK 128
+
+DS1307Clock rtc;
+AT24C32 eeprom(0);
+uint8_t block[BLOCK];
+uint8_t back[BLOCK];
+unsigned long passes;
+unsigned long started;
+bool writing = false;
+bool clockFirst;
+
+void startWrite(Task * me) {
+  for (uint8_t i = 0; i < BLOCK; i++) {
+    block[i] = passes + i;
+  }
+  passes = 0;
+  started = millis();
+  writing = true;
+  clockFirst = false;
+  eeprom.writeBytes(0, block, BLOCK);
+  rtc.request();
+}
+
+void watch(Task * me) {
+  if (! writing) {
+    return;
+  }
+  passes++;
+  if (rtc.ready()) {
+    clockFirst = eeprom.busy();
+  }
+  if (eeprom.busy()) {
+    return;
+  }
+  writing = false;
+  Serial.print(F("Write "));
+  Serial.print(eeprom.status() == TWI_DONE ? F("done") : F("failed"));
+  Serial.print(F(" in "));
+  Serial.print(millis() - started);
+  Serial.print(F("ms, "));
+  Serial.print(passes);
+  Serial.print(F(" loop passes, clock "));
+  Serial.print(rtc.present() ? rtc.time() : 0);
+  Serial.println(clockFirst ? F(" read during the write") : F(" read after"));
+  eeprom.readBytes(0, back, BLOCK);
+  Serial.println(memcmp(block, back, BLOCK) ? F("Read back differs") : F("Read back ok"));
+}
+
+Task writeTask(5000, startWrite);
+Task watchTask(0, watch);
+
+void setup() {
+  Serial.begin(9600);
+  TwiBus.begin();
+  SoftTimer.add(&writeTask);
+  SoftTimer.add(&watchTask);
+}
@@ -0,0 +1,94 @@
+/*
+ * Base station for the RF24Network sensor network.
+ *
+ * Sits at node 00, taking every frame the network delivers and
+ * passing it to the host as a record in a COBS framed batch, with
+ * the node it came from, its type and when it arrived.  The host
+ * sends frames back as:
+ *
+ *   'W' to (2), type, data   write data to node to as a frame of type
+ *
+ * which carries the config and time ('c') frames to the nodes.  A
+ * write that fails comes back as a '!' record from 00 holding the
+ * node and type.  See HostLink.h for the framing, and
+ * server/sgf/baselink.py for the host end.
+ */
+#include "setup.h"
+#include <RF24.h>
+#include <RF24Network.h>
+#include <SPI.h>
+#include <SoftTimer.h>
+#include <HostLink.h>
+
+typedef struct _base_health_t {
+  uint16_t rx;
+  uint16_t tx;
+  uint16_t tx_fail;
+  uint16_t dropped;
+  uint16_t bad_frames;
+  uint16_t batches;
+} base_health_t;
+
+RF24 radio(RADIO_CE, RADIO_CS);
+RF24Network network(radio);
+HostLink host;
+base_health_t health;
+
+void hostFrame(const uint8_t * data, uint8_t len)
+{
+  uint16_t to;
+  if (data[0] != 'W' || len < 4) {
+    return;
+  }
+  to = data[1] | (uint16_t)data[2] << 8;
+  RF24NetworkHeader hdr(to, data[3]);
+  health.tx++;
+  if ( ! network.write(hdr, data + 4, len - 4)) {
+    health.tx_fail++;
+    host.add(0, '!', data + 1, 3);
+  }
+}
+
+/*
+ * Runs every pass of the loop, draining the radio before its
+ * three frame FIFO can overflow.
+ */
+void networkTask(Task *me)
+{
+  RF24NetworkHeader header;
+  uint8_t frame[MAX_FRAME];
+  uint16_t len;
+
+  network.update();
+  while (network.available()) {
+    len = network.read(header, frame, sizeof(frame));
+    health.rx++;
+    host.add(header.from_node, header.type, frame, len);
+  }
+  host.poll();
+}
+
+void healthTask(Task *me)
+{
+  health.dropped = host.dropped;
+  health.bad_frames = host.badFrames;
+  health.batches = host.batches;
+  host.add(0, 'h', &health, sizeof(health));
+}
+
+Task networkScan(0, networkTask);
+Task healthReport(HEALTH_LOOP_MS, healthTask);
+
+void setup(void)
+{
+  Serial.begin(HOST_BAUD);
+  memset(&health, 0, sizeof(health));
+  host.begin(Serial, hostFrame);
+  SPI.begin();
+  radio.begin();
+  network.begin(CHANNEL, 00);
+  SoftTimer.add(&networkScan);
+  SoftTimer.add(&healthReport);
+}
+
+// vim:ft=cpp ai sw=2:
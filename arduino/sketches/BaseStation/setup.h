@@ -0,0 +1,30 @@
+/**
+ * Configurable items for the base station
+ */
+
+/*
+ * The base station is always node 00.  CHANNEL has to match the
+ * rest of the network.
+ */
+#define CHANNEL		90
+#define RADIO_CE	9
+#define RADIO_CS	10
+
+/*
+ * HOST_BAUD is the serial speed to the host.  Frames are read
+ * from the radio as they arrive and sent on in batches (see
+ * HostLink.h), the host taking them at this rate.
+ */
+#define HOST_BAUD	115200
+
+/*
+ * Largest frame passed on from the network, longer ones are cut
+ * short.  Saki messages are fragmented to fit 24 bytes.
+ */
+#define MAX_FRAME	32
+
+/*
+ * The base station's own counters are sent to the host as an 'h'
+ * record from node 00 this often.
+ */
+#define HEALTH_LOOP_MS	60000UL
@@ -25,11 +25,34 @@
  * Options could include an I2C or 1-Wire display, or a second
  * controller to manage the display.
  */
+/*
+ * TASK_STATS times the display and sensor tasks and prints the
+ * figures every TASK_STATS_MS, for tracking down blocking calls.
+ */
+#define TASK_STATS 0
+#define TASK_STATS_MS 60000
+/*
+ * The digits are multiplexed from the timer2 compare interrupt, so
+ * a slow DHT22 read or serial print doesn't stall them.  Each digit
+ * is lit DISPLAY_REFRESH_HZ times a second, its turn split into
+ * DISPLAY_STEPS interrupts of which the first DISPLAY_LIT_STEPS are
+ * lit.  The rest are blanked, which sets the brightness and keeps
+ * the last digit from ghosting into the next.  DISPLAY_UPDATE_MS is
+ * how often the digits are worked out from the readings.
+ */
+#define DISPLAY_REFRESH_HZ 100
+#define DISPLAY_STEPS 4
+#define DISPLAY_LIT_STEPS 3
+#define DISPLAY_UPDATE_MS 50
+
 #include <PciManager.h>
 #include <SoftTimer.h>
+#include <TaskStats.h>
 #include <Debouncer.h>
-#include <DHT22.h>
+#include <DHT22Reader.h>
+#include <NumFormat.h>
 #include <EEPROM.h>
+#include <FastPin.h>
 
 /* Inputs */
 #define SET_BUTTON 2
@@ -55,20 +78,83 @@
 #define ACTIVE LOW
 #define INACTIVE HIGH
 
+typedef FastPin<LED_1_SELECT> led1Select;
+typedef FastPin<LED_2_SELECT> led2Select;
+typedef FastPin<LED_BLANK> ledBlank;
+typedef FastPin<HEATER> heater;
+typedef FastPinGroup<BCD_0, BCD_1, BCD_2, BCD_3> bcdPins;
+
+// timer2 at clk/256, interrupting once a step
+#define DISPLAY_OCR (F_CPU / 256 / (DISPLAY_REFRESH_HZ * 2L * DISPLAY_STEPS) - 1)
+#if DISPLAY_OCR < 1 || DISPLAY_OCR > 255
+ #error DISPLAY_REFRESH_HZ * DISPLAY_STEPS out of range for timer2
+#endif
+// Set in a digit's image when it is to be lit
+#define DISPLAY_LIT 0x80
+
 boolean inSetup = false;
 boolean showDigit = true;
 int setTemp;
 int currentTemp = 0;
 int currentHumid = 0;
-boolean displayIndicator = false;
 int displayMode = SHOW_TEMP;
-DHT22 tempSensor(TEMP_SENSOR);
+DHT22Reader tempSensor(TEMP_SENSOR);
+
+/*
+ * Images of the ones (0) and tens (1) digits, the BCD value plus
+ * DISPLAY_LIT.  Only the ISR reads them.  bcdPins::write() sets the
+ * BCD pins with one port write when they share a port, as A0-A3 do,
+ * and pin by pin otherwise.
+ */
+volatile uint8_t displayImage[2];
+
+ISR(TIMER2_COMPA_vect) {
+  static uint8_t step = 0;
+  static uint8_t digit = 0;
+  uint8_t image;
+  if (step == 0) {
+    ledBlank::low();
+    if (digit == 0) {
+      led1Select::low();
+      led2Select::high();
+    } else {
+      led2Select::low();
+      led1Select::high();
+    }
+    image = displayImage[digit];
+    bcdPins::write(image & 0x0f);
+    if (image & DISPLAY_LIT) {
+      ledBlank::high();
+    }
+  } else if (step == DISPLAY_LIT_STEPS) {
+    ledBlank::low();
+  }
+  if (++step == DISPLAY_STEPS) {
+    step = 0;
+    digit ^= 1;
+  }
+}
 
-void displayBCD(int value) {
-  digitalWrite(BCD_0, (value & 0x01) == 0x01 ? HIGH : LOW);
-  digitalWrite(BCD_1, (value & 0x02) == 0x02 ? HIGH : LOW);
-  digitalWrite(BCD_2, (value & 0x04) == 0x04 ? HIGH : LOW);
-  digitalWrite(BCD_3, (value & 0x08) == 0x08 ? HIGH : LOW);
+void displayBegin() {
+  uint8_t sreg = SREG;
+  cli();
+  TCCR2A = _BV(WGM21); // CTC
+  TCCR2B = _BV(CS22) | _BV(CS21);
+  OCR2A = DISPLAY_OCR;
+  TCNT2 = 0;
+  TIMSK2 = _BV(OCIE2A);
+  SREG = sreg;
+}
+
+// Both images change together so a digit isn't shown half updated
+void displayValue(int value, boolean lit) {
+  uint8_t ones = (value % 10) | (lit ? DISPLAY_LIT : 0);
+  uint8_t tens = (value / 10) | (lit ? DISPLAY_LIT : 0);
+  uint8_t sreg = SREG;
+  cli();
+  displayImage[0] = ones;
+  displayImage[1] = tens;
+  SREG = sreg;
 }
 
 void showDisplay(Task *me) {
@@ -82,47 +168,37 @@ void showDisplay(Task *me) {
       val = currentHumid / 10;
     }
   }
-  if (displayIndicator) {
-    digitalWrite(LED_BLANK, LOW);
-    digitalWrite(LED_1_SELECT, LOW);
-    digitalWrite(LED_2_SELECT, HIGH);
-    displayIndicator = false;
-    displayBCD(val % 10);
-    if (showDigit) {
-      digitalWrite(LED_BLANK, HIGH);
-    }
-  } else {
-    digitalWrite(LED_BLANK, LOW);
-    displayIndicator = true;
-    digitalWrite(LED_2_SELECT, LOW);
-    digitalWrite(LED_1_SELECT, HIGH);
-    displayBCD(val / 10);
-    if (showDigit) {
-      digitalWrite(LED_BLANK, HIGH);
-    }
-  }
+  displayValue(val, showDigit);
 }
 
+/*
+ * The DHT22 is read in the background, checkTemp starts a reading
+ * and readTemp picks it up when the interrupt has decoded it.
+ */
 void checkTemp(Task *me) {
+  Serial.println("Checking Temp");
+  tempSensor.request();
+}
+
+void readTemp(Task *me) {
   int checkVal;
-  DHT22_ERROR_t Err;
+  uint8_t err;
   char buf[16];
-  Serial.println("Checking Temp");
-  if ((Err = tempSensor.readData()) != DHT_ERROR_NONE) {
+  if (! tempSensor.ready()) {
+    return;
+  }
+  if ((err = tempSensor.status()) != DHT22_OK) {
     Serial.print("Error ");
-    Serial.println(Err);
+    Serial.println(err);
     return;
   }
   currentTemp = tempSensor.getTemperatureCInt();
   currentHumid = tempSensor.getHumidityInt();
   checkVal = currentTemp / 10;
-  sprintf(buf, "%d.%dC %d.%d%%", currentTemp/10, currentTemp%10, currentHumid/10, currentHumid%10);
+  strcpy(formatFixed(buf, currentTemp, 1), "C ");
+  strcpy(formatFixed(buf + strlen(buf), currentHumid, 1), "%");
   Serial.println(buf);
-  if (checkVal >= setTemp) {
-    digitalWrite(HEATER, INACTIVE);
-  } else {
-    digitalWrite(HEATER, ACTIVE);
-  }
+  heater::write(checkVal >= setTemp ? INACTIVE : ACTIVE);
 }
 
 void setOn() {
@@ -171,9 +247,13 @@ void toggleDisplay(Task *me) {
 Debouncer setButton(SET_BUTTON, MODE_CLOSE_ON_PUSH, setOn, NULL);
 Debouncer upButton(UP_BUTTON, MODE_CLOSE_ON_PUSH, upOn, NULL);
 Debouncer dnButton(DN_BUTTON, MODE_CLOSE_ON_PUSH, dnOn, NULL);
-Task displayTask(10, showDisplay);
-Task checkTempTask(15000, checkTemp);
-Task toggleDisplayTask(200, toggleDisplay);
+StatTask displayTask(DISPLAY_UPDATE_MS, showDisplay, "DSP");
+StatTask checkTempTask(15000, checkTemp, "TMP");
+StatTask readTempTask(100, readTemp, "DHT");
+StatTask toggleDisplayTask(200, toggleDisplay, "TGL");
+#if TASK_STATS
+Task statsDump(TASK_STATS_MS, InstrumentedTask::printAllTask);
+#endif
 
 void setup() {
   pinMode(SET_BUTTON,INPUT);
@@ -181,27 +261,21 @@ void setup() {
   pinMode(DN_BUTTON, INPUT);
   pinMode(TEMP_SENSOR, INPUT);
   pinMode(LIGHT_SENSOR, INPUT);
-  pinMode(BCD_0, OUTPUT);
-  pinMode(BCD_1, OUTPUT);
-  pinMode(BCD_2, OUTPUT);
-  pinMode(BCD_3, OUTPUT);
-  pinMode(LED_1_SELECT, OUTPUT);
-  pinMode(LED_2_SELECT, OUTPUT);
-  pinMode(LED_BLANK, OUTPUT);
-  pinMode(HEATER, OUTPUT);
+  bcdPins::output();
+  led1Select::output();
+  led2Select::output();
+  ledBlank::output();
+  heater::output();
   pinMode(LIGHT, OUTPUT);
   
   digitalWrite(SET_BUTTON, HIGH);
   digitalWrite(UP_BUTTON, HIGH);
   digitalWrite(DN_BUTTON, HIGH);
-  digitalWrite(BCD_0, LOW);
-  digitalWrite(BCD_1, LOW);
-  digitalWrite(BCD_2, LOW);
-  digitalWrite(BCD_3, LOW);
-  digitalWrite(LED_1_SELECT, LOW);
-  digitalWrite(LED_2_SELECT, LOW);
-  digitalWrite(LED_BLANK, LOW);
-  digitalWrite(HEATER, INACTIVE);
+  bcdPins::write(0);
+  led1Select::low();
+  led2Select::low();
+  ledBlank::low();
+  heater::write(INACTIVE);
   digitalWrite(LIGHT, LOW);
   Serial.begin(9600);
   Serial.println("Starting");
@@ -214,13 +288,20 @@ void setup() {
   /* do an initial temp/humidity reading */
   delay(2500);
   
+  tempSensor.begin();
   PciManager.registerListener(SET_BUTTON, &setButton);
   PciManager.registerListener(UP_BUTTON, &upButton);
   PciManager.registerListener(DN_BUTTON, &dnButton);
   
   /* Set up the display tasks */
+  showDisplay(&displayTask);
+  displayBegin();
   SoftTimer.add(&displayTask);
   SoftTimer.add(&checkTempTask);
+  SoftTimer.add(&readTempTask);
   SoftTimer.add(&toggleDisplayTask);
+#if TASK_STATS
+  SoftTimer.add(&statsDump);
+#endif
 }
 // vim:ai sw=2 expandtab ft=cpp:
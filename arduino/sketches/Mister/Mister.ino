@@ -16,6 +16,7 @@
 #include <SoftTimer.h>
 #include <BlinkTask.h>
 #include <EEPROM.h>
+#include <Log.h>
 
 #define ONE_WIRE_IF 2
 #define PUMP_OFFSET 3
@@ -30,8 +31,13 @@
 #define RUNNING 1
 #define PENDING 2
 
-#define dprintln(x) if (DEBUG) Serial.println(x)
-#define dprint(x) if (DEBUG) Serial.print(x)
+/*
+ * Debug output is queued and written out by the menu task, so the
+ * zone code isn't held up by the serial port.
+ */
+#define dprintln(x) if (DEBUG) logDebugln(x)
+#define dprint(x) if (DEBUG) logDebug(x)
+uint8_t logBuffer[96];
 
 OneWire dataBus(ONE_WIRE_IF);
 DallasTemperature devManager(&dataBus);
@@ -46,9 +52,8 @@ int currentSensor = 0;
 
 typedef struct st_devlist {
   float temp;
-  int time;
+  unsigned long deadline; // millis() at which the current state expires
   uint8_t status;
-  uint8_t fill[3];
 } DEVICE_LIST;
 
 typedef struct _devs_t {
@@ -75,7 +80,7 @@ void readConfig(void) {
   // Now we build our devices list
   for (int i = 0; i < MAX_DEVICE_COUNT && i < cfg.devcount; i++) {
     nodes[i].status = STOPPED;
-    nodes[i].time = 0;
+    nodes[i].deadline = 0;
     nodes[i].temp = 0;
   }
   // Check for insane values and fix
@@ -113,24 +118,83 @@ void findSensors(void) {
   cfg.devcount = sensor_count;
 }
 
-boolean stopPump(Task *me) {
+/*
+ * Each zone keeps its own deadline, so run and wait periods no
+ * longer interfere with each other.  A single DelayRun is armed
+ * for whichever deadline is due first and re-armed each time it
+ * fires, so adding zones doesn't add tasks.  Nothing is armed in
+ * test mode; leaving it with 'x' schedules again.
+ */
+boolean zoneTimeout(Task *me);
+DelayRun zoneTimer(ON_TIME * 1000, zoneTimeout);
+
+boolean zoneExpired(int i, unsigned long now) {
+  return (long)(now - nodes[i].deadline) >= 0;
+}
+
+void scheduleZones(void) {
+  unsigned long now = millis();
+  unsigned long next = 0;
+  boolean pending = false;
+
+  SoftTimer.remove(&zoneTimer);
+  if (TESTMODE) {
+    return;
+  }
   for (int i = 0; i < cfg.devcount && i < MAX_DEVICE_COUNT; i++) {
-    if (nodes[i].status == RUNNING) {
-      dprint(F("Pump "));
-      dprint(cfg.sensors[i].pump + 1 - PUMP_OFFSET);
-      dprintln(" Off");
-      digitalWrite(cfg.sensors[i].pump, LOW);
-      nodes[i].status = PENDING;
-      nodes[i].time = cfg.min_wait;
+    if (nodes[i].status == STOPPED) {
+      continue;
+    }
+    unsigned long remaining = zoneExpired(i, now) ? 0 : nodes[i].deadline - now;
+    if ( ! pending || remaining < next) {
+      next = remaining;
+      pending = true;
     }
   }
-  return false;
+  if (pending) {
+    zoneTimer.delayMs = next ? next : 1;
+    zoneTimer.startDelayed();
+  }
+}
+
+void startZone(int i) {
+  dprint(F("Turning on pump "));
+  dprintln(cfg.sensors[i].pump + 1 - PUMP_OFFSET);
+  nodes[i].status = RUNNING;
+  nodes[i].deadline = millis() + (unsigned long)(cfg.run_time * 1000);
+  digitalWrite(cfg.sensors[i].pump, HIGH);
+}
+
+void stopZone(int i) {
+  dprint(F("Turning off pump "));
+  dprintln(cfg.sensors[i].pump + 1 - PUMP_OFFSET);
+  nodes[i].status = PENDING;
+  nodes[i].deadline = millis() + (unsigned long)(cfg.min_wait * 1000);
+  digitalWrite(cfg.sensors[i].pump, LOW);
 }
 
-DelayRun stopPumpTask(ON_TIME * 1000, stopPump);
+boolean zoneTimeout(Task *me) {
+  unsigned long now = millis();
+  for (int i = 0; i < cfg.devcount && i < MAX_DEVICE_COUNT; i++) {
+    if ( ! zoneExpired(i, now)) {
+      continue;
+    }
+    switch (nodes[i].status) {
+      case RUNNING:
+        stopZone(i);
+        break;
+      case PENDING:
+        nodes[i].status = STOPPED;
+        break;
+    }
+  }
+  scheduleZones();
+  return false;
+}
 
 void checkTemp(Task *me) {
   boolean show_indicator = false;
+  boolean reschedule = false;
   devManager.requestTemperatures();
   if (startup_delay || TESTMODE) {
     return;
@@ -143,27 +207,16 @@ void checkTemp(Task *me) {
     dprint(": ");
     dprintln(nodes[i].temp);
     switch (nodes[i].status) {
-      case PENDING:
-        if (nodes[i].time-- < 0) {
-          nodes[i].status = STOPPED;
-        }
-        break;
       case STOPPED:
         if (nodes[i].temp > cfg.max_temp) {
-          dprint(F("Turning on pump "));
-          dprintln(cfg.sensors[i].pump + 1 - PUMP_OFFSET);
-          nodes[i].status = RUNNING;
-          digitalWrite(cfg.sensors[i].pump, HIGH);
-          stopPumpTask.startDelayed();
+          startZone(i);
+          reschedule = true;
         }
         break;
       case RUNNING:
         if (nodes[i].temp < cfg.min_temp) {
-          dprint(F("Turning off pump "));
-          dprintln(cfg.sensors[i].pump + 1 - PUMP_OFFSET);
-          nodes[i].status = PENDING;
-          digitalWrite(cfg.sensors[i].pump, LOW);
-          nodes[i].time = cfg.min_wait;
+          stopZone(i);
+          reschedule = true;
         }
         break;
     }
@@ -171,6 +224,9 @@ void checkTemp(Task *me) {
       show_indicator = true;
     }
   }
+  if (reschedule) {
+    scheduleZones();
+  }
   digitalWrite(INDICATOR, show_indicator ? HIGH : LOW);
 }
 
@@ -234,7 +290,7 @@ void showStatus() {
 	break;
       case PENDING:
         Serial.print(F("WAITING "));
-	Serial.println(nodes[i].time);
+	Serial.println(zoneExpired(i, millis()) ? 0 : (nodes[i].deadline - millis()) / 1000);
 	break;
     }
   }
@@ -260,6 +316,7 @@ void handleCommand(int cmd) {
 	case 't':
 	  currentMenu = cmd;
 	  TESTMODE = 1;
+	  scheduleZones();
 	  Serial.println(F("Test mode"));
 	  break;
 	case 's':
@@ -298,7 +355,6 @@ void handleCommand(int cmd) {
             Serial.print(F("Setting run time to "));
             Serial.println(newval);
             cfg.run_time = newval;
-            stopPumpTask.delayMs = cfg.run_time * 1000;
             writeConfig();
           }
           break;
@@ -372,6 +428,7 @@ void handleCommand(int cmd) {
 	case 'x':
 	  TESTMODE = 0;
 	  currentMenu = 0;
+	  scheduleZones();
 	  Serial.println(F("Run mode"));
 	  break;
 	default:
@@ -390,13 +447,11 @@ void handleCommand(int cmd) {
 	    if (nodes[j].status == RUNNING) {
 	      Serial.println(F("Turning off pump "));
 	      Serial.print(cfg.sensors[j].pump + 1 - PUMP_OFFSET);
-	      nodes[j].status = STOPPED;
-	      digitalWrite(cfg.sensors[j].pump, LOW);
+	      stopZone(j);
 	    } else {
 	      Serial.println(F("Turning on pump "));
 	      Serial.print(cfg.sensors[j].pump + 1 - PUMP_OFFSET);
-	      nodes[j].status = RUNNING;
-	      digitalWrite(cfg.sensors[j].pump, HIGH);
+	      startZone(j);
 	    }
 	  }
 	  else {
@@ -414,6 +469,7 @@ void handleCommand(int cmd) {
 // Handle keyboard input
 void kint(Task *me) {
   int cmd;
+  Log.drain();
   if (Serial.available()) {
     handleCommand(Serial.read());
   }
@@ -425,6 +481,7 @@ DelayRun clearDelayTask(6000, clearDelay);
 
 void setup() {
   Serial.begin(9600);
+  Log.begin(Serial, logBuffer, sizeof(logBuffer));
   Serial.println("Starting");
   Serial.setTimeout(5000);
   
@@ -453,7 +510,6 @@ void setup() {
     currentSensor = 0;
     showSensor();
   }
-  stopPumpTask.delayMs = cfg.run_time * 1000;
   clearDelayTask.startDelayed();
 }
 
@@ -32,13 +32,28 @@
  Any change in status is reported via the XBee, and levels and timer
  values can be changed via the XBee.
 
- We use the inbuilt serial port for debug, and the SoftwareSerial library
- to talk to the XBee.
+ We use the inbuilt serial port for debug, and either the SoftwareSerial
+ library or CaptureSerial to talk to the XBee.
 
  */
+// XBee on SoftwareSerial, or CaptureSerial on pins 8/9 (see CaptureSerial.h)
+#define USE_CAPTURE_SERIAL 0
+#define XBEE_BAUD 9600
+/*
+ * The light sensors are scanned in the background, each reading the
+ * average of 4^LIGHT_OVERSAMPLE samples scaled back to 0-1023 so the
+ * DK/HL levels are unchanged.
+ */
+#define LIGHT_OVERSAMPLE 2
+
 #include <XBee.h>
-#include <SoftwareSerial.h>
+#if USE_CAPTURE_SERIAL
+ #include <CaptureSerial.h>
+#else
+ #include <SoftwareSerial.h>
+#endif
 #include <Saki.h>
+#include <AdcScanner.h>
 
 #define MOTION_1 5
 #define MOTION_2 6
@@ -56,6 +71,8 @@ int dark1 = -1;
 int dark2 = -1;
 
 int ledStatus = 0;
+uint8_t light1Channel;
+uint8_t light2Channel;
 
 /* Configurables */
 int darkValue = 200;
@@ -67,7 +84,11 @@ int onTime2 = 90;
 void reportStatus(const char ** Msg);
 
 SakiManager manager("MS", 4, 1, true);
+#if USE_CAPTURE_SERIAL
+CaptureSerial serialPort;
+#else
 SoftwareSerial serialPort(3,4);
+#endif
 
 void
 checkInputs(bool defer = false) {
@@ -82,8 +103,8 @@ checkInputs(bool defer = false) {
 
   motion1 = digitalRead(MOTION_1);
   motion2 = digitalRead(MOTION_2);
-  light1 = analogRead(LIGHT_1);
-  light2 = analogRead(LIGHT_2);
+  light1 = AdcScan.read(light1Channel, 10);
+  light2 = AdcScan.read(light2Channel, 10);
   dark1 = (light1 < darkValue);
   dark2 = (light2 > lightValue);
   alarmed = manager.isAlarmed(true);
@@ -173,8 +194,11 @@ void setup() {
   pinMode(MOTION_2, INPUT);
   pinMode(LED_OUTPUT, OUTPUT);
   digitalWrite(LED_OUTPUT, HIGH);
+  light1Channel = AdcScan.add(LIGHT_1, LIGHT_OVERSAMPLE);
+  light2Channel = AdcScan.add(LIGHT_2, LIGHT_OVERSAMPLE);
+  AdcScan.begin();
   Serial.begin(9600); 
-  serialPort.begin(9600);
+  serialPort.begin(XBEE_BAUD);
   Serial.println("Starting...");
   manager.registerHandler("ST?", &reportStatus);
   manager.registerHandler("ST", &updateStatus);
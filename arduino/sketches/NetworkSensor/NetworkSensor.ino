@@ -11,21 +11,46 @@
  */
 #include "pins.h"
 #include "setup.h"
-#include <Wire.h>
+#if HAS_RTC || HAS_EEPROM
+ #include <TwiQueue.h>
+#endif
 #include <DallasTemperature.h>
 #include <OneWire.h>
 #if HAS_RADIO
  #include <RF24.h>
  #include <RF24Network.h>
  #include <SPI.h>
+ #include <SakiRF24.h>
  #include "message.h"
+ #if USE_SLOTS
+  #include <SlotSchedule.h>
+ #endif
 #endif
 #include <Time.h>
 #if HAS_RTC
- #include <DS1307RTC.h>
+ #include <DS1307Clock.h>
+ DS1307Clock rtc;
 #endif
 #include <PciManager.h>
 #include <SoftTimer.h>
+#include <TaskStats.h>
+#include <FastPin.h>
+#if HAS_TIMED_RELAY
+ #include <Schedule.h>
+#endif
+#if LOW_POWER
+ #include <PowerManager.h>
+ PowerManager power;
+ #define addTask(t) power.add(t)
+ #define removeTask(t) power.remove(t)
+#else
+ #define addTask(t) SoftTimer.add(t)
+ #define removeTask(t) SoftTimer.remove(t)
+#endif
+
+// The relay and its indicator always switch together
+typedef FastPinGroup<RELAY, INDICATOR> relayPins;
+typedef FastPin<RELAY_2> relay2;
 
 struct _cfg {
   uint8_t sentinel;
@@ -40,11 +65,13 @@ struct _cfg {
   DeviceAddress temp_sensors[MAX_TEMP_SENSORS];
 } cfg;
 
+#include "params.h"
+
 #if HAS_LED_DISPLAY
  #include <LedControl.h>
  LedControl ld(DATA_IN, CLK, CHIP_SELECT, 1);
  #include "display.h"
- _set_mode current_top_level;
+ uint8_t current_top_level;
  _set_mode set_mode;
 #else
  #define displayTemp(s)
@@ -53,11 +80,38 @@ struct _cfg {
 #if HAS_RADIO
  RF24 radio(RADIO_CE,RADIO_CS);
  RF24Network network(radio);
+ SakiRF24Manager manager("NS", 2, 2, true);
  sensor_msg_t last_status;
+ #if USE_SLOTS
+ typedef struct _queued_frame_t {
+   uint16_t to;
+   int type;
+   uint8_t len;
+   uint8_t data[MAX_FRAME];
+ } queued_frame_t;
+ SlotSchedule slots;
+ queued_frame_t slot_queue[SLOT_QUEUE];
+ uint8_t slot_queued = 0;
+ #endif
+ #if AGGREGATE
+  #include "aggregate.h"
+ #endif
+#endif
+#if HAS_TIMED_RELAY
+ Schedule relaySchedule(TZ_OFFSET * 3600L);
+ bool timed_relay_on = false;
+#endif
+#if HAS_RTC
+ // Set once the base has sent the time
+ bool clock_from_network = false;
+ // Set once the RTC has answered
+ bool rtc_found = false;
 #endif
 #if HAS_EEPROM
  #include <AT24C32.h>
  AT24C32 eeprom(0);
+ // What the EEPROM is being written from, in the background
+ struct _cfg saved_cfg;
 #else
  #include <EEPROM.h>
 #endif
@@ -82,7 +136,12 @@ void configureTemp(void)
   Serial.print(sensor_count);
   Serial.println(" Sensors found");
   tempSensors.requestTemperatures();
-  for (int i = 0; i < MAX_TEMP_SENSORS && i < sensor_count; i++) {
+  for (int i = 0; i < MAX_TEMP_SENSORS; i++) {
+    if (i >= sensor_count) {
+      // Marks the slot empty for checkTempSensors
+      memset(cfg.temp_sensors[i], 0, sizeof(DeviceAddress));
+      continue;
+    }
     tempSensors.getAddress(cfg.temp_sensors[i], i);
     temp = tempSensors.getTempC(cfg.temp_sensors[i]);
     Serial.print(i);
@@ -91,21 +150,165 @@ void configureTemp(void)
   }
 }
 
+/*
+ * At boot the addresses saved in cfg are trusted if each passes
+ * its ROM CRC and the device answers with a good scratchpad, which
+ * takes a few milliseconds rather than the search and conversion
+ * in configureTemp.  Returns false if the bus needs searching.
+ */
+bool checkTempSensors(void)
+{
+  if (cfg.temp_sensors[0][0] == 0) {
+    return false;
+  }
+  for (uint8_t i = 0; i < MAX_TEMP_SENSORS; i++) {
+    if (cfg.temp_sensors[i][0] == 0) {
+      continue;
+    }
+    if (! tempSensors.validAddress(cfg.temp_sensors[i])
+        || ! tempSensors.isConnected(cfg.temp_sensors[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#if HAS_RADIO && LOW_POWER
+/*
+ * Leaf nodes keep the radio powered down outside a short window
+ * every RADIO_SLEEP_MS.  Sending opens a window so replies can
+ * be received.
+ */
+bool radio_awake = true;
+
+void radioPower(bool on)
+{
+  if (on == radio_awake) {
+    return;
+  }
+  if (on) {
+    radio.powerUp();
+  } else {
+    radio.powerDown();
+  }
+  radio_awake = on;
+  power.radio(on);
+}
+
+boolean radioWindowClose(Task *me)
+{
+  if ( ! cfg.relay) {
+    radioPower(false);
+  }
+  return false;
+}
+
+DelayRun radioWindowEnd(RADIO_WINDOW_MS, radioWindowClose);
+
+void radioWindowTask(Task *me)
+{
+  radioPower(true);
+  SoftTimer.remove(&radioWindowEnd);
+  radioWindowEnd.startDelayed();
+}
+
+Task radioWindow(RADIO_SLEEP_MS, radioWindowTask);
+#endif
+
 #if HAS_RADIO
-void sendMessage(int type, message_t * msg)
+bool transmitFrame(uint16_t to, int type, const void * data, uint8_t len)
 {
-  RF24NetworkHeader hdr(0, type);
-  if (network.write(hdr, (void *)msg, sizeof(message_t))) {
+  RF24NetworkHeader hdr(to, type);
+  bool sent;
+#if LOW_POWER
+  if ( ! radio_awake) {
+    radioWindowTask(NULL);
+  }
+#endif
+  sent = manager.transport().write(hdr, data, len);
 #if DEBUG
+  if (sent) {
     Serial.println(F("msg sent"));
-#endif
   } else {
-#if DEBUG
     Serial.println(F("msg send fail"));
+  }
+#endif
+  // And now we request a network update, received messages are
+  // left for the next scan.
+  network.update();
+  return sent;
+}
+
+#if USE_SLOTS
+/*
+ * Hold a frame until our slot.  Only the latest status is worth
+ * sending, and with the queue full the oldest frame is dropped
+ * and counted as an overflow.
+ */
+void queueFrame(uint16_t to, int type, const void * data, uint8_t len)
+{
+  uint8_t i = slot_queued;
+  if (type == 's') {
+    for (i = 0; i < slot_queued && slot_queue[i].type != 's'; i++)
+      ;
+  }
+  if (i == SLOT_QUEUE) {
+    manager.transport().health.overflows++;
+    memmove(slot_queue, slot_queue + 1, (SLOT_QUEUE - 1) * sizeof(queued_frame_t));
+    i--;
+  } else if (i == slot_queued) {
+    slot_queued++;
+  }
+  slot_queue[i].to = to;
+  slot_queue[i].type = type;
+  slot_queue[i].len = len;
+  memcpy(slot_queue[i].data, data, len);
+}
+
+/*
+ * Runs as our slot opens, sleeping a superframe between.
+ */
+void slotTask(Task *me)
+{
+  uint8_t i;
+  for (i = 0; i < slot_queued && slots.inSlot(); i++) {
+    transmitFrame(slot_queue[i].to, slot_queue[i].type, slot_queue[i].data, slot_queue[i].len);
+  }
+  slot_queued -= i;
+  memmove(slot_queue, slot_queue + i, slot_queued * sizeof(queued_frame_t));
+  me->setPeriodMs(slots.nextSlot());
+}
+
+Task slotSend(SLOT_MS, slotTask);
 #endif
+
+/*
+ * Returns false if the frame wasn't sent.  One held for our slot
+ * counts as sent.
+ */
+bool sendFrame(uint16_t to, int type, const void * data, uint8_t len)
+{
+#if USE_SLOTS
+  if ( ! slots.inSlot()) {
+    queueFrame(to, type, data, len);
+    return true;
   }
-  // And now we request a network update
-  networkScanTask((Task *)NULL);
+#endif
+  return transmitFrame(to, type, data, len);
+}
+
+void sendMessage(int type, message_t * msg)
+{
+  sendFrame(0, type, msg, sizeof(message_t));
+}
+
+void sendStatus(message_t * msg)
+{
+#if AGGREGATE
+  aggregateStatus(cfg.radio_address, &msg->payload.sensor);
+#else
+  sendMessage('s', msg);
+#endif
 }
 #endif
 
@@ -163,101 +366,235 @@ void sendConfigItem(uint32_t item, uint32_t value) {
 #endif
 
 #if HAS_RADIO
+/*
+ * Config items that can be read and set over the radio, either
+ * as binary 'c' frames or Saki CF messages, come from params[].
+ */
+long getConfigItem(char item)
+{
+  param_t p;
+  int8_t i = paramFind(item);
+  if (i < 0) {
+    return 0;
+  }
+  paramRead(i, &p);
+  return paramGet(&p);
+}
+
+/*
+ * Set and persist a config item, returns false if we don't know it
+ * or the value is out of range.
+ */
+bool setConfigItem(char item, long value)
+{
+  param_t p;
+  int8_t i = paramFind(item);
+  if (i < 0) {
+    return false;
+  }
+  paramRead(i, &p);
+  if ( ! paramSet(&p, value)) {
+    return false;
+  }
+  writeConfig();
+  return true;
+}
+
 void sendConfig() {
   // Send a series of config messages out.
-  message_t cmsg;
+  param_t p;
+  for (uint8_t i = 0; i < PARAM_COUNT; i++) {
+    paramRead(i, &p);
+    if (p.key && ! (p.flags & PARAM_NOREPORT)) {
+      sendConfigItem(p.key, paramGet(&p));
+    }
+  }
+}
+
+void setClock(time_t t)
+{
+#if HAS_RTC
+  rtc.set(t);
+  clock_from_network = true;
+#endif
+  setTime(t);
+  configureSchedule();
+#if USE_SLOTS
+  // The base sends the time at the top of a second
+  slots.sync(t);
+  if (slots.slot() != SLOT_NONE) {
+    removeTask(&slotSend);
+    slotSend.setPeriodMs(slots.nextSlot());
+    addTask(&slotSend);
+  }
+#endif
+}
+
+/*
+ * Saki handlers.  These replace the library defaults so the
+ * config lives in cfg rather than the Saki config store.
+ */
+void sakiSetConfig(const char ** args)
+{
+  args++;
+  while (args[0] && args[1]) {
+    setConfigItem(args[0][0], atol(args[1]));
+    args += 2;
+  }
+}
+
+/*
+ * The same items as sendConfig().  Any that would run past the
+ * message are left off.
+ */
+void sakiGetConfig(const char ** args)
+{
+  char buf[SAKI_MAX_MESSAGE];
+  param_t p;
+  int off = 2;
+  strcpy(buf, "CF");
+  for (uint8_t i = 0; i < PARAM_COUNT; i++) {
+    paramRead(i, &p);
+    if (p.key && ! (p.flags & PARAM_NOREPORT)) {
+      // ":k:" and the value with its terminator
+      if (off + 3 + NUM_FORMAT_MAX > (int)sizeof(buf)) {
+        break;
+      }
+      buf[off++] = ':';
+      buf[off++] = p.key;
+      buf[off++] = ':';
+      off = formatLong(buf + off, paramGet(&p)) - buf;
+    }
+  }
+  manager.reply(buf);
+}
+
+void sakiSetTime(const char ** args)
+{
+  if (args[1]) {
+    setClock(atol(args[1]));
+  }
+}
 
-  sendConfigItem('l', cfg.low_point);
-  sendConfigItem('h', cfg.high_point);
-  sendConfigItem('r', cfg.reference);
-  sendConfigItem('s', cfg.low_time);
-  sendConfigItem('e', cfg.high_time);
-  sendConfigItem('m', cfg.mode);
+void sakiStatus(const char ** args)
+{
+  manager.report();
+}
+
+#if TASK_STATS
+void sakiTaskStats(const char ** args)
+{
+  InstrumentedTask::replyAll(manager);
 }
 #endif
 
-#if HAS_RADIO
-void networkScanTask(Task *me)
+/*
+ * Binary message_t frames, anything that isn't a Saki message.
+ */
+void networkFrame(RF24NetworkHeader & header, const void * data, uint16_t len)
 {
   message_t msg, s_msg;
 
-  RF24NetworkHeader header;
-  network.update();
-  while (network.available()) {
-    network.read(header, (void *)&msg, sizeof(msg));
-    switch (header.type) {
-      case 'r': // Request config
-	sendConfig();
-	break;
-      case 't': // Request time
+  memset(&msg, 0, sizeof(msg));
+  memcpy(&msg, data, len < sizeof(msg) ? len : sizeof(msg));
+  switch (header.type) {
+#if AGGREGATE
+    case 'p': // Packed status from below
+      aggregateFrame(data, len);
+      break;
+#endif
+    case 'r': // Request config
+      sendConfig();
+      break;
+    case 't': // Request time
+      sendTime();
+      break;
+    case 's': // Request status
+      memcpy(&(s_msg.payload.sensor), &last_status, sizeof(sensor_msg_t));
+      sendMessage('s', &s_msg);
+      break;
+    case 'c': // Config
+      if (msg.payload.config.item == 't') { // Timestamp
+        setClock(msg.payload.config.value);
         sendTime();
-	break;
-      case 's': // Request status
-	memcpy(&(s_msg.payload.sensor), &last_status, sizeof(sensor_msg_t));
-	sendMessage('s', &s_msg);
-	break;
-      case 'c': // Config
-        switch (msg.payload.config.item) {
-	  case 't': // Timestamp
-#if HAS_RTC
-	    RTC.set(msg.payload.config.value);
-#endif
-	    setTime(msg.payload.config.value);
-	    sendTime();
-	    break;
-	  case 'h': // High Value
-	    cfg.high_point = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('h', cfg.high_point);
-	    break;
-	  case 'l': // Low Value
-	    cfg.low_point = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('l', cfg.low_point);
-	    break;
-	  case 'r': // Reference
-	    cfg.reference = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('r', cfg.reference);
-	    break;
-	  case 's': // Start time
-	    cfg.low_time = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('s', cfg.low_time);
-	    break;
-	  case 'e': // End time
-	    cfg.high_time = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('e', cfg.high_time);
-	    break;
-	  case 'm': // Mode
-	    cfg.mode = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('m', cfg.mode);
-	    break;
-	  case 'a': // Address
-	    cfg.radio_address = msg.payload.config.value;
-	    cfg.sentinel = 1;
-	    writeConfig();
-	    sendConfigItem('a', cfg.radio_address);
-	    break;
-	}
-    }
+      } else if (setConfigItem(msg.payload.config.item, msg.payload.config.value)) {
+        sendConfigItem(msg.payload.config.item, getConfigItem(msg.payload.config.item));
+      }
+      break;
+  }
+}
+
+void networkScanTask(Task *me)
+{
+#if LOW_POWER
+  if ( ! radio_awake) {
+    return;
+  }
+#endif
+  if (radio.rxFifoFull()) {
+    manager.transport().health.overflows++;
+  }
+  manager.check();
+}
+
+void healthTask(Task *me)
+{
+  saki_health_t & health = manager.transport().health;
+  message_t msg;
+  msg.id = 1;
+  msg.payload.health.tx = health.txAttempts;
+  msg.payload.health.tx_fail = health.txFailures;
+  msg.payload.health.rx = health.rxFrames;
+  msg.payload.health.relayed = health.relayed;
+  msg.payload.health.overflows = health.overflows;
+  msg.payload.health.parent = network.parent();
+  sendMessage('h', &msg);
+}
+#endif
+
+/*
+ * The timed relay only changes state at the window edges, so rather
+ * than re-checking the clock on every sensor scan this task sleeps
+ * until the next transition the schedule reports.
+ */
+void timedRelayTask(Task *me)
+{
+#if HAS_TIMED_RELAY
+  unsigned long t = now();
+  unsigned long next = relaySchedule.nextTransition(t);
+  unsigned long sleep = TIMED_RELAY_MAX_SLEEP;
+
+  timed_relay_on = relaySchedule.isActive(t);
+  relay2::write(timed_relay_on);
+  if (next && (next - t) < sleep) {
+    sleep = next - t;
   }
+  me->setPeriodMs(sleep * 1000);
+#endif
 }
+
+#if HAS_TIMED_RELAY
+Task timedRelay(TIMED_RELAY_MAX_SLEEP * 1000, timedRelayTask);
 #endif
 
+/*
+ * Called whenever the window or the clock changes.
+ */
+void configureSchedule(void)
+{
+#if HAS_TIMED_RELAY
+  relaySchedule.clear();
+  relaySchedule.addHHMM(cfg.low_time, cfg.high_time);
+  removeTask(&timedRelay);
+  timedRelayTask(&timedRelay);
+  addTask(&timedRelay);
+#endif
+}
+
 void sensorScanTask(Task *me)
 {
   float test;
   float reference;
-  uint16_t now;
 
 #if HAS_LED_DISPLAY
   if (set_mode != run_mode) {
@@ -291,33 +628,20 @@ void sensorScanTask(Task *me)
   sendTime();
  #endif
 #endif
-  now = (hour() + TZ_OFFSET)%24 * 100 + minute();
-#if HAS_TIMED_RELAY
-  if (cfg.low_time < now && now < cfg.high_time) {
-    digitalWrite(RELAY_2, HIGH);
-#if HAS_RADIO
-    msg.payload.sensor.value_3 = 1;
-#endif
-  } else {
-    digitalWrite(RELAY_2, LOW);
-#if HAS_RADIO
-    msg.payload.sensor.value_3 = 0;
-#endif
-  }
+#if HAS_TIMED_RELAY && HAS_RADIO
+  msg.payload.sensor.value_3 = timed_relay_on ? 1 : 0;
 #endif
 
   displayTemp(test);
 
   if (test < cfg.low_point) {
-    digitalWrite(RELAY,cfg.mode ? LOW : HIGH);
-    digitalWrite(INDICATOR, cfg.mode ? LOW : HIGH);
+    relayPins::write(cfg.mode ? 0x00 : 0x03);
 #if HAS_RADIO
     msg.payload.sensor.value_4 = cfg.mode ? 0 : 1;
 #endif
   }
   else if (test >= cfg.high_point && test >= reference && (test - reference) >= cfg.reference) {
-    digitalWrite(RELAY, cfg.mode ? HIGH : LOW);
-    digitalWrite(INDICATOR, cfg.mode ? HIGH : LOW);
+    relayPins::write(cfg.mode ? 0x03 : 0x00);
 #if HAS_RADIO
     msg.payload.sensor.value_4 = cfg.mode ? 1 : 0;
 #endif
@@ -325,16 +649,20 @@ void sensorScanTask(Task *me)
 
 #if HAS_RADIO
 #if DEBUG
-  sendMessage('s', &msg);
+  sendStatus(&msg);
 #else
   if (msg.payload.sensor.value != last_status.value
     || msg.payload.sensor.value_2 != last_status.value_2
     || msg.payload.sensor.value_3 != last_status.value_3
     || msg.payload.sensor.value_4 != last_status.value_4) {
-      sendMessage('s', &msg);
+      sendStatus(&msg);
   }
 #endif
   memcpy(&last_status, &(msg.payload.sensor), sizeof(sensor_msg_t));
+  manager.setAnalogInput(0, (int16_t)last_status.value, 1);
+  manager.setAnalogInput(1, (int16_t)last_status.value_2, 1);
+  manager.setDigitalOutput(0, last_status.value_4);
+  manager.setDigitalOutput(1, last_status.value_3);
 #endif
 }
 
@@ -365,8 +693,14 @@ void readConfig(void)
 #else
   EEPROM.get(0, cfg);
 #endif
-  // Always check the config for the temp sensors
-  configureTemp();
+  if (cfg.sentinel != CONFIGURED) {
+    configureTemp();
+  } else if (! checkTempSensors()) {
+    // A sensor was changed, save what the search found
+    configureTemp();
+    writeConfig();
+    cfg.sentinel = CONFIGURED;
+  }
 }
 
 void writeConfig(void)
@@ -374,7 +708,8 @@ void writeConfig(void)
   if (cfg.sentinel) {
     cfg.sentinel = CONFIGURED;
 #if HAS_EEPROM
-    eeprom.writeBytes(0, (void *)&cfg, sizeof(cfg));
+    memcpy(&saved_cfg, &cfg, sizeof(cfg));
+    eeprom.writeBytes(0, (void *)&saved_cfg, sizeof(cfg));
 #else
   EEPROM.put(0, cfg);
 #endif
@@ -382,50 +717,138 @@ void writeConfig(void)
   }
 }
 
+#if LOW_POWER
+void batteryTask(Task *me)
+{
+  unsigned long ua = power.estimateMicroAmps();
+#if HAS_RADIO
+  message_t msg;
+  msg.id = 1;
+  msg.payload.sensor.type = 2;
+  msg.payload.sensor.value = power.batteryMillivolts(BATTERY_LEVEL, BATTERY_FULL_SCALE_MV);
+  msg.payload.sensor.value_2 = ua > 0xffff ? 0xffff : ua;
+  msg.payload.sensor.value_3 = 0;
+  msg.payload.sensor.value_4 = 0;
+  msg.payload.sensor.adjust = 0;
+  sendMessage('b', &msg);
+#endif
+#if DEBUG
+  Serial.print(F("Battery:"));
+  Serial.print(power.batteryMillivolts(BATTERY_LEVEL, BATTERY_FULL_SCALE_MV));
+  Serial.print(F("mV "));
+  Serial.print(ua);
+  Serial.println(F("uA"));
+#endif
+  power.resetStats();
+}
+
+void idleTask(Task *me)
+{
+#if HAS_LED_DISPLAY
+  // Keep the buttons responsive while in the setup menus
+  if (set_mode != run_mode) {
+    return;
+  }
+#endif
+#if HAS_RTC || HAS_EEPROM
+  // The TWI stops in power down, so stay up while the bus is busy
+  if (TwiBus.busy()) {
+    return;
+  }
+#endif
+  power.sleep();
+}
+
+Task batteryCheck(BATTERY_LOOP_MS, batteryTask);
+Task idle(0, idleTask);
+#endif
+
+#if HAS_RTC
+/*
+ * Keeps the clock to the RTC every RTC_SYNC_MS without waiting on
+ * the bus: one run asks for the time and the next, RTC_READ_MS
+ * later, takes it.
+ *
+ * Without an RTC at boot the clock runs free from zero until the
+ * base sends the time or the RTC answers, looked for every
+ * RTC_RETRY_MS.  A time from the network is then written to the
+ * RTC, otherwise the RTC's time is taken.
+ */
+void rtcSyncTask(Task *me)
+{
+  time_t t;
+  if (! rtc.ready()) {
+    rtc.request();
+    me->setPeriodMs(RTC_READ_MS);
+    return;
+  }
+  if (! rtc.present()) {
+    me->setPeriodMs(rtc_found ? RTC_SYNC_MS : RTC_RETRY_MS);
+    return;
+  }
+  me->setPeriodMs(RTC_SYNC_MS);
+  t = rtc.time();
+  if (rtc_found) {
+    if (t) {
+      setTime(t);
+    }
+    return;
+  }
+  rtc_found = true;
+  if (clock_from_network || t == 0) {
+    rtc.set(now());
+  } else {
+    setTime(t);
+    configureSchedule();
+  }
+}
+
+Task rtcSync(RTC_SYNC_MS, rtcSyncTask);
+#endif
+
 #if HAS_RADIO
-Task networkScan(RADIO_ADDRESS + NETWORK_LOOP_MS, networkScanTask);
+StatTask networkScan(RADIO_ADDRESS + NETWORK_LOOP_MS, networkScanTask, "NET");
+Task healthReport(HEALTH_LOOP_MS, healthTask);
 #endif 
 
-Task sensorScan(RADIO_ADDRESS + SENSOR_LOOP_MS, sensorScanTask);
+StatTask sensorScan(RADIO_ADDRESS + SENSOR_LOOP_MS, sensorScanTask, "SNS");
+
+#if TASK_STATS
+Task statsDump(TASK_STATS_MS, InstrumentedTask::printAllTask);
+#endif
 
 void setup(void)
 {
-  pinMode(RELAY, OUTPUT);
-  digitalWrite(RELAY, LOW);
-  pinMode(INDICATOR, OUTPUT);
-  digitalWrite(INDICATOR, LOW);
+  relayPins::output();
+  relayPins::write(0);
 #if HAS_TIMED_RELAY
-  pinMode(RELAY_2, OUTPUT);
-  digitalWrite(RELAY_2, LOW);
+  relay2::output();
+  relay2::low();
 #endif
   Serial.begin(9600);
   Serial.println(F("Starting"));
   // First, check that we have time
-#if HAS_RTC
-  setSyncProvider(RTC.get);
+#if HAS_RTC || HAS_EEPROM
+  TwiBus.begin();
 #endif
-  timeStatus();
 #if HAS_RTC
-  while (! RTC.chipPresent()) {
-    timeStatus_t t;
-    Serial.println(F("Failed to find RTC ... Check connections"));
-    t = timeStatus();
-    if (t != timeSet) {
-      if (t == timeNotSet) {
-        Serial.println(F("Time NOT SET"));
-      } else {
-        Serial.println(F("Time Needs SYNC"));
-      }
+  time_t t = rtc.get();
+  if (rtc.present()) {
+    rtc_found = true;
+    if (t) {
+      setTime(t);
     }
-    delay(4000);
+  } else {
+    Serial.println(F("No RTC, clock free running"));
   }
 #endif
+  timeStatus();
 
   // check our configuration
   tempSensors.begin();
   readConfig();
   if (cfg.sentinel != CONFIGURED) {
-    cfg.radio_address = RADIO_ADDRESS;
+    paramDefaults();
     cfg.relay = RADIO_RELAY;
   }
   if (cfg.radio_address > 05555) {
@@ -437,6 +860,21 @@ void setup(void)
   SPI.begin();
   radio.begin();
   network.begin(CHANNEL, cfg.radio_address);
+  manager.start(network);
+#if WINDOW_STATS
+  manager.windowStats(true);
+#endif
+#if USE_SLOTS
+  slots.begin(cfg.radio_address);
+#endif
+  manager.transport().onFrame(networkFrame);
+  manager.registerHandler("CF", sakiSetConfig);
+  manager.registerHandler("CF?", sakiGetConfig);
+  manager.registerHandler("TM", sakiSetTime);
+  manager.registerHandler("ST?", sakiStatus);
+#if TASK_STATS
+  manager.registerHandler("TS?", sakiTaskStats);
+#endif
   if (cfg.sentinel != CONFIGURED) {
 #if DEBUG
     Serial.println(F("Request Config"));
@@ -451,15 +889,40 @@ void setup(void)
   last_status.value_4 = 0;
   last_status.adjust = 0;
 
-  SoftTimer.add(&networkScan);
+  addTask(&networkScan);
+  addTask(&healthReport);
+#if AGGREGATE
+  addTask(&aggregateRefresh);
+#endif
+#if LOW_POWER
+  power.radio(true);
+  if ( ! cfg.relay) {
+    addTask(&radioWindow);
+  }
+#endif
 #endif
 
-  SoftTimer.add(&sensorScan);
+  addTask(&sensorScan);
+#if HAS_RTC
+  if (! rtc_found) {
+    rtcSync.setPeriodMs(RTC_RETRY_MS);
+  }
+  addTask(&rtcSync);
+#endif
+#if TASK_STATS
+  addTask(&statsDump);
+#endif
+#if LOW_POWER
+  pinMode(BATTERY_LEVEL, INPUT);
+  addTask(&batteryCheck);
+  SoftTimer.add(&idle);
+#endif
 #if HAS_LED_DISPLAY
   set_mode = run_mode;
-  current_top_level = run_mode;
+  current_top_level = 0;
   display_init();
 #endif
+  configureSchedule();
 }
 
 // vim:ft=cpp ai sw=2:
@@ -0,0 +1,183 @@
+#ifndef _AGGREGATE_H
+#define _AGGREGATE_H
+
+#include <DelayRun.h>
+
+/*
+ * Relay aggregation, see AGGREGATE in setup.h.
+ *
+ * Each node's latest status is kept in aggregate[], our own and
+ * any passed up from below, marked dirty until it has been sent
+ * on to our parent.  A reading that matches what was last sent is
+ * dropped.  The first change starts the window and everything
+ * dirty goes out packed when it closes.  Leaf nodes have nothing
+ * to wait for so send straight away.  Entries stay dirty until
+ * their frame has gone, a failed send trying again a window later.
+ *
+ * So a steady node can be told from a dead one, every entry heard
+ * since the last AGGREGATE_REFRESH_MS is sent again then, changed
+ * or not.  A node that has gone quiet is not, so it stops being
+ * refreshed all the way up.
+ */
+typedef struct _aggregate_t {
+  packed_status_t status;
+  uint8_t dirty : 1;
+  uint8_t heard : 1;
+} aggregate_t;
+
+aggregate_t aggregate[AGGREGATE_NODES];
+uint8_t aggregate_count = 0;
+bool aggregate_waiting = false;
+
+void aggregateRetry(void);
+
+/*
+ * Sends the entries listed in index[], clearing them if it went.
+ */
+bool aggregateSend(const uint8_t * index, uint8_t n)
+{
+  packed_status_t frame[PACKED_PER_FRAME];
+  uint8_t i;
+
+  for (i = 0; i < n; i++) {
+    frame[i] = aggregate[index[i]].status;
+  }
+  if ( ! sendFrame(network.parent(), 'p', frame, n * sizeof(packed_status_t))) {
+    return false;
+  }
+  for (i = 0; i < n; i++) {
+    aggregate[index[i]].dirty = false;
+  }
+  return true;
+}
+
+void aggregateFlush(void)
+{
+  uint8_t index[PACKED_PER_FRAME];
+  uint8_t n = 0;
+  bool sent = true;
+
+  for (uint8_t i = 0; i < aggregate_count; i++) {
+    if ( ! aggregate[i].dirty) {
+      continue;
+    }
+    index[n++] = i;
+    if (n == PACKED_PER_FRAME) {
+      sent &= aggregateSend(index, n);
+      n = 0;
+    }
+  }
+  if (n) {
+    sent &= aggregateSend(index, n);
+  }
+  if ( ! sent) {
+    aggregateRetry();
+  }
+}
+
+boolean aggregateWindowEnd(Task *me)
+{
+  aggregate_waiting = false;
+  aggregateFlush();
+  return false;
+}
+
+DelayRun aggregateWindow(AGGREGATE_WINDOW_MS, aggregateWindowEnd);
+
+void aggregateRetry(void)
+{
+  if ( ! aggregate_waiting) {
+    aggregate_waiting = true;
+    aggregateWindow.startDelayed();
+  }
+}
+
+/*
+ * Returns false if the reading hadn't changed.  A full table
+ * reuses a clean entry, flushing first if there isn't one.  If
+ * that fails too the first entry's reading is lost, counted as
+ * an overflow.
+ */
+bool aggregateAdd(const packed_status_t * status)
+{
+  uint8_t clean = AGGREGATE_NODES;
+  uint8_t i;
+  for (i = 0; i < aggregate_count; i++) {
+    if (((aggregate[i].status.node ^ status->node) & PACKED_NODE) == 0) {
+      break;
+    }
+    if ( ! aggregate[i].dirty) {
+      clean = i;
+    }
+  }
+  if (i < aggregate_count) {
+    aggregate[i].heard = true;
+    if ( ! memcmp(&aggregate[i].status, status, sizeof(packed_status_t))) {
+      return false;
+    }
+  } else if (aggregate_count < AGGREGATE_NODES) {
+    aggregate_count++;
+  } else {
+    if (clean == AGGREGATE_NODES) {
+      aggregateFlush();
+      for (clean = 0; clean < AGGREGATE_NODES && aggregate[clean].dirty; clean++)
+        ;
+      if (clean == AGGREGATE_NODES) {
+        manager.transport().health.overflows++;
+        clean = 0;
+      }
+    }
+    i = clean;
+  }
+  aggregate[i].status = *status;
+  aggregate[i].dirty = true;
+  aggregate[i].heard = true;
+  if ( ! cfg.relay) {
+    aggregateFlush();
+  } else {
+    aggregateRetry();
+  }
+  return true;
+}
+
+void aggregateRefreshTask(Task *me)
+{
+  for (uint8_t i = 0; i < aggregate_count; i++) {
+    if (aggregate[i].heard) {
+      aggregate[i].dirty = true;
+      aggregate[i].heard = false;
+    }
+  }
+  aggregateFlush();
+}
+
+Task aggregateRefresh(AGGREGATE_REFRESH_MS, aggregateRefreshTask);
+
+void aggregateStatus(uint16_t node, const sensor_msg_t * sensor)
+{
+  packed_status_t status;
+  status.node = node & PACKED_NODE;
+  if (sensor->value_3) {
+    status.node |= PACKED_TIMED;
+  }
+  if (sensor->value_4) {
+    status.node |= PACKED_RELAY;
+  }
+  status.value = sensor->value;
+  status.value_2 = sensor->value_2;
+  aggregateAdd(&status);
+}
+
+/*
+ * A 'p' frame from one of our children, counted as relayed.
+ */
+void aggregateFrame(const void * data, uint16_t len)
+{
+  const packed_status_t * status = (const packed_status_t *)data;
+  for (uint8_t n = len / sizeof(packed_status_t); n > 0; n--) {
+    manager.transport().health.relayed++;
+    aggregateAdd(status++);
+  }
+}
+
+#endif // _AGGREGATE_H
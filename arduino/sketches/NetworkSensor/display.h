@@ -2,29 +2,20 @@
 #define _DISPLAY_HANDLER_H
 
 #include <LedControl.h>
+#include <NumFormat.h>
 #include <Debouncer.h>
 #include <DelayRun.h>
 #include "setup.h"
+#include "params.h"
 #include <avr/pgmspace.h>
 
 enum _set_mode {
   run_mode = 0,
   setup_mode,
-  hc_mode,
-  temp_mode,
-  hys_mode,
-  addr_mode,
-  time_hour_mode,
-  time_minute_mode,
-  low_hour_mode,
-  low_minute_mode,
-  high_hour_mode,
-  high_minute_mode,
-  hold_mode,
-  off_the_end
+  edit_mode
 };
 
-extern _set_mode current_top_level;
+extern uint8_t current_top_level;
 extern _set_mode set_mode;
 
 const PROGMEM char msgs[] = "    ----5trtErr HeatCoolRUN 5trtHC  TC  DiffaddrT HrT -NL HrL -NH HrH -n5et ";
@@ -66,12 +57,19 @@ void displayString_P(const char * PROGMEM str) {
   }
 }
 
-void displayNumber(const char * format, int number) {
-  char str[5];
-  sprintf(str, format, number % 10000);
+/*
+ * Show a number right aligned in the last digits places, padded
+ * on the left with pad and blanks beyond that.
+ */
+void displayNumber(int number, uint8_t digits, char pad, uint8_t base = 10) {
+  char str[NUM_FORMAT_MAX];
+  memset(str, ' ', 4 - digits);
+  if (base == 10) {
+    formatLong(str + 4 - digits, number % 10000, digits, pad);
+  } else {
+    formatUnsigned(str + 4 - digits, number, base, digits, pad);
+  }
 #if DEBUG
-  Serial.print(format);
-  Serial.print(":");
   Serial.print(number);
   Serial.print(":");
   Serial.println(str);
@@ -80,7 +78,7 @@ void displayNumber(const char * format, int number) {
 }
 
 #define displayMessage(n) displayString_P(msgs + n*4)
-#define showMode() displayString_P(msgs + (DISPLAY_CONF_BASE + current_top_level) * 4)
+#define showMode() displayString_P(msgs + (DISPLAY_CONF_MODE + current_top_level) * 4)
 
 void displayTemp(float tempC) {
   int temp;
@@ -97,187 +95,82 @@ void displayTemp(float tempC) {
 
 
 void showOptions() {
-  char str[5];
-  switch (set_mode) {
-    case hc_mode:
-      displayString_P(msgs + (DISPLAY_MODE_BASE + (cfg.mode ? 1 : 0)) * 4);
-      break;
-    case temp_mode:
-      displayNumber("  %2d", cfg.low_point);
-      break;
-    case hys_mode:
-      displayNumber("  %2d", cfg.reference);
+  param_t p;
+  long value;
+  paramRead(current_top_level, &p);
+  value = paramGet(&p);
+  switch (p.format) {
+    case PARAM_FMT_MODE:
+      displayString_P(msgs + (DISPLAY_MODE_BASE + (value ? 1 : 0)) * 4);
       break;
-    case addr_mode:
-      displayNumber("%04o", cfg.radio_address & 0xfff);
+    case PARAM_FMT_DEC:
+      displayNumber(value, 2, ' ');
       break;
-    case time_hour_mode:
-      displayNumber("  %02d", (hour() + TZ_OFFSET)%24);
+    case PARAM_FMT_OCT:
+      displayNumber(value & 0xfff, 4, '0', 8);
       break;
-    case time_minute_mode:
-      displayNumber("  %02d", minute());
+    case PARAM_FMT_HOUR:
+      displayNumber(value / 100, 2, '0');
       break;
-    case low_hour_mode:
-      displayNumber("  %02d", cfg.low_time / 100);
-      break;
-    case low_minute_mode:
-      displayNumber("  %02d", cfg.low_time % 100);
-      break;
-    case high_hour_mode:
-      displayNumber("  %02d", cfg.high_time / 100);
-      break;
-    case high_minute_mode:
-      displayNumber("  %02d", cfg.high_time % 100);
+    case PARAM_FMT_MINUTE:
+      displayNumber(value % 100, 2, '0');
       break;
   }
 }
 
 
+/*
+ * The setup menu runs through the PARAM_MENU rows of the parameter
+ * table, with one more item past the end to leave setup.
+ */
 boolean changeMode(Task *me) {
   switch (set_mode) {
     case run_mode:
       set_mode = setup_mode;
-      current_top_level = hc_mode;
+      current_top_level = 0;
       showMode();
       break;
     case setup_mode:
-      if (current_top_level == hold_mode) {
+      if (current_top_level >= paramMenuItems()) {
         set_mode = run_mode;
 	writeConfig();
       } else {
-        set_mode = current_top_level;
+        set_mode = edit_mode;
 	showOptions();
       }
       break;
-    case hc_mode:
-    case temp_mode:
-    case hys_mode:
-    case addr_mode:
-    case time_hour_mode:
-    case time_minute_mode:
-    case low_hour_mode:
-    case low_minute_mode:
-    case high_hour_mode:
-    case high_minute_mode:
+    case edit_mode:
       set_mode = setup_mode;
       showMode();
       break;
-    case hold_mode:
-      set_mode = run_mode;
-      writeConfig();
-      break;
   }
   return true;
 }
 
 DelayRun startModeChange(SETUP_TIMER, changeMode);
 
-int increment_hour(int hr, int inc) {
-  hr += inc;
-  if (hr >= 24) hr = 0;
-  if (hr < 0) hr = 23;
-  return hr;
-}
-
-int increment_minute(int min, int inc) {
-  min += inc;
-  if (min >= 60) min = 0;
-  if (min < 0) min = 59;
-  return min;
-}
-
 void setMode(int inc) {
-  int hr, min;
+  param_t p;
+  uint8_t items = paramMenuItems();
   switch (set_mode) {
   case setup_mode:
-    current_top_level = static_cast<_set_mode>(static_cast<int>(current_top_level) + inc);
-    if (inc > 0 && current_top_level > hold_mode) {
-      current_top_level = hc_mode;
-    }
-    if (inc < 0 && current_top_level < hc_mode) {
-      current_top_level = hold_mode;
+    if (inc < 0 && current_top_level == 0) {
+      current_top_level = items;
+    } else if (inc > 0 && current_top_level >= items) {
+      current_top_level = 0;
+    } else {
+      current_top_level += inc;
     }
     showMode();
     break;
-  case hc_mode:
-    cfg.mode = ! cfg.mode;
-    cfg.sentinel = 1;
-    showOptions();
-    break;
-  case temp_mode:
-    if ((inc > 0 && cfg.low_point < 99)
-      || (inc < 0 && cfg.low_point > 0)) {
-      cfg.low_point += inc;
+  case edit_mode:
+    paramRead(current_top_level, &p);
+    paramSet(&p, paramStep(&p, inc));
+    if (p.flags & PARAM_HIGH) {
       cfg.high_point = cfg.low_point + cfg.reference;
-      cfg.sentinel = 1;
     }
     showOptions();
     break;
-  case hys_mode:
-    if ((inc > 0 && cfg.reference < 99)
-      || (inc < 0 && cfg.reference > 0)) {
-      cfg.reference += inc;
-      cfg.high_point = cfg.low_point + cfg.reference;
-      cfg.sentinel = 1;
-    }
-    showOptions();
-    break;
-  case addr_mode:
-    cfg.radio_address += inc;
-    if (cfg.radio_address > 05555 || cfg.radio_address < 0) {
-      cfg.radio_address = 0;
-    }
-    cfg.sentinel = 1;
-    showOptions();
-    break;
-  case time_hour_mode:
-  case time_minute_mode:
-    int sec, dy, mth, yr;
-    sec = 0;
-    dy = day();
-    mth = month();
-    yr = year();
-    hr = hour();
-    min = minute();
-    if (set_mode == time_hour_mode) {
-     hr = increment_hour(hr, inc);
-    } else {
-     min  = increment_minute(min, inc);
-    }
-    setTime(hr, min, sec, dy, mth, yr);
-#if HAS_RTC
-    RTC.set(now());
-#endif
-    showOptions();
-    break;
-  case low_hour_mode:
-    hr = increment_hour(cfg.low_time / 100, inc);
-    min = cfg.low_time % 100;
-    cfg.low_time = (hr * 100) + min;
-    cfg.sentinel = 1;
-    showOptions();
-    break;
-  case low_minute_mode:
-    hr = cfg.low_time / 100;
-    min = increment_minute(cfg.low_time % 100, inc);
-    cfg.low_time = (hr * 100) + min;
-    cfg.sentinel = 1;
-    showOptions();
-    break;
-  case high_hour_mode:
-    hr = increment_hour(cfg.high_time / 100, inc);
-    min = cfg.high_time % 100;
-    cfg.high_time = (hr * 100) + min;
-    cfg.sentinel = 1;
-    showOptions();
-    break;
-  case high_minute_mode:
-    hr = cfg.high_time / 100;
-    min = increment_minute(cfg.high_time % 100, inc);
-    cfg.high_time = (hr * 100) + min;
-    cfg.sentinel = 1;
-    showOptions();
-    break;
   }
 }
 
@@ -321,13 +214,7 @@ void display_init() {
   if (cfg.sentinel != CONFIGURED) {
     displayMessage(DISPLAY_MSG_WRITE);
     configureTemp();
-    cfg.sentinel = 1;
-    cfg.low_point = 30;
-    cfg.high_point = 30;
-    cfg.low_time = 700;
-    cfg.high_time = 1900;
-    cfg.mode = false;
-    cfg.reference = 0;
+    paramDefaults();
     writeConfig();
   }
   ld.shutdown(0, false);
@@ -1,6 +1,9 @@
 #ifndef _MESSAGES_H
 #define _MESSAGES_H
 
+// Largest payload RF24Network sends in a single radio frame
+#define MAX_FRAME 24
+
 /**
  * Common message structure
  */
@@ -22,17 +25,48 @@ typedef struct _time_msg_t {
   uint16_t second;
 } time_msg_t;
 
+/**
+ * Link health, counted from start up and wrapping.  Sent as
+ * an 'h' frame every HEALTH_LOOP_MS.
+ */
+typedef struct _health_msg_t {
+  uint16_t tx;
+  uint16_t tx_fail;
+  uint16_t rx;
+  uint16_t relayed;
+  uint16_t overflows;
+  uint16_t parent;
+} health_msg_t;
+
 typedef struct _config_msg_t {
   uint32_t item;
   uint32_t value;
 } config_msg_t;
 
+/**
+ * Status from several nodes packed into one 'p' frame, used with
+ * AGGREGATE.  A frame carries as many entries as its length holds.
+ * The relay and timed relay states ride in the top bits of the
+ * node address, type is always 1 and adjust 0.
+ */
+typedef struct _packed_status_t {
+  uint16_t node;
+  uint16_t value;
+  uint16_t value_2;
+} packed_status_t;
+
+#define PACKED_NODE      0x0fff
+#define PACKED_TIMED     0x4000 // value_3
+#define PACKED_RELAY     0x8000 // value_4
+#define PACKED_PER_FRAME (MAX_FRAME / sizeof(packed_status_t))
+
 typedef struct _message_t {
   uint32_t id;
   union _payload {
     time_msg_t time;
     sensor_msg_t sensor;
     config_msg_t config;
+    health_msg_t health;
   } payload;
 } message_t;
 
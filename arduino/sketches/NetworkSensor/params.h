@@ -0,0 +1,172 @@
+#ifndef _PARAMS_H
+#define _PARAMS_H
+
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include "setup.h"
+
+/*
+ * Every configurable item is described by one row in params[].
+ * The radio get/set, the setup menu and the defaults written to
+ * EEPROM are all driven from this table, so a new item costs a
+ * row rather than code in each place.
+ *
+ * Rows flagged PARAM_MENU must come first and in the same order as
+ * their labels in the display msgs[] string, the menu shows them
+ * in table order followed by the exit ("no set") item.
+ */
+#define PARAM_FMT_MODE   0 // Heat/Cool
+#define PARAM_FMT_DEC    1 // Two digit number
+#define PARAM_FMT_OCT    2 // Four digit octal, radio addresses
+#define PARAM_FMT_HOUR   3 // Hour part of an HHMM value
+#define PARAM_FMT_MINUTE 4 // Minute part of an HHMM value
+
+#define PARAM_MENU       0x01 // Shown in the setup menu
+#define PARAM_NOREPORT   0x02 // Not sent with the config dump
+#define PARAM_SCHEDULE   0x04 // Reconfigure the timed relay on change
+#define PARAM_HIGH       0x08 // Menu changes recalculate high_point
+
+// Offset used for the clock, which isn't stored in cfg
+#define PARAM_CLOCK      0xff
+
+#define CFG(f) offsetof(struct _cfg, f), sizeof(((struct _cfg *)0)->f)
+
+typedef struct _param_t {
+  char key;         // Radio key, 0 if not available over the air
+  uint8_t offset;   // Offset into cfg
+  uint8_t width;    // Size in bytes, 1 or 2
+  uint8_t format;   // PARAM_FMT_*
+  uint8_t flags;    // PARAM_*
+  uint16_t min;
+  uint16_t max;
+  uint16_t def;     // Default for an unconfigured unit
+} param_t;
+
+const PROGMEM param_t params[] = {
+  // key, offset/width, format, flags, min, max, default
+  { 'm', CFG(mode), PARAM_FMT_MODE, PARAM_MENU, 0, 1, 0 },
+  { 'l', CFG(low_point), PARAM_FMT_DEC, PARAM_MENU | PARAM_HIGH, 0, 99, 30 },
+  { 'r', CFG(reference), PARAM_FMT_DEC, PARAM_MENU | PARAM_HIGH, 0, 99, 0 },
+  { 'a', CFG(radio_address), PARAM_FMT_OCT, PARAM_MENU | PARAM_NOREPORT, 0, 05555, RADIO_ADDRESS },
+  { 0, PARAM_CLOCK, 0, PARAM_FMT_HOUR, PARAM_MENU, 0, 2359, 0 },
+  { 0, PARAM_CLOCK, 0, PARAM_FMT_MINUTE, PARAM_MENU, 0, 2359, 0 },
+  { 's', CFG(low_time), PARAM_FMT_HOUR, PARAM_MENU | PARAM_SCHEDULE, 0, 2359, 700 },
+  { 0, CFG(low_time), PARAM_FMT_MINUTE, PARAM_MENU | PARAM_SCHEDULE, 0, 2359, 700 },
+  { 'e', CFG(high_time), PARAM_FMT_HOUR, PARAM_MENU | PARAM_SCHEDULE, 0, 2359, 1900 },
+  { 0, CFG(high_time), PARAM_FMT_MINUTE, PARAM_MENU | PARAM_SCHEDULE, 0, 2359, 1900 },
+  { 'h', CFG(high_point), PARAM_FMT_DEC, 0, 0, 99, 30 },
+};
+
+#define PARAM_COUNT (sizeof(params) / sizeof(param_t))
+
+void paramRead(uint8_t i, param_t * p)
+{
+  memcpy_P(p, params + i, sizeof(param_t));
+}
+
+int8_t paramFind(char key)
+{
+  for (uint8_t i = 0; i < PARAM_COUNT; i++) {
+    if (key && pgm_read_byte(&params[i].key) == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+uint8_t paramMenuItems(void)
+{
+  uint8_t i = 0;
+  while (i < PARAM_COUNT && (pgm_read_byte(&params[i].flags) & PARAM_MENU)) {
+    i++;
+  }
+  return i;
+}
+
+void paramStore(const param_t * p, uint16_t value)
+{
+  uint8_t * field = (uint8_t *)&cfg + p->offset;
+  if (p->width == 1) {
+    *field = value;
+  } else {
+    *(uint16_t *)field = value;
+  }
+  cfg.sentinel = 1;
+}
+
+long paramGet(const param_t * p)
+{
+  uint8_t * field = (uint8_t *)&cfg + p->offset;
+  if (p->offset == PARAM_CLOCK) {
+    return ((hour() + TZ_OFFSET) % 24) * 100 + minute();
+  }
+  if (p->width == 1) {
+    return *field;
+  }
+  return *(uint16_t *)field;
+}
+
+/*
+ * Set an item, marking the config as needing to be written.
+ * Returns false if the value is out of range.
+ */
+bool paramSet(const param_t * p, long value)
+{
+  if (value < (long)p->min || value > (long)p->max) {
+    return false;
+  }
+  if (p->offset == PARAM_CLOCK) {
+    setTime((value / 100 + 24 - TZ_OFFSET) % 24, value % 100, 0, day(), month(), year());
+#if HAS_RTC
+    rtc.set(now());
+#endif
+    configureSchedule();
+    return true;
+  }
+  paramStore(p, value);
+  if (p->flags & PARAM_SCHEDULE) {
+    configureSchedule();
+  }
+  return true;
+}
+
+/*
+ * Value one button press away, hours and minutes wrap.
+ */
+long paramStep(const param_t * p, int inc)
+{
+  long value = paramGet(p);
+  int hr = value / 100;
+  int min = value % 100;
+  switch (p->format) {
+    case PARAM_FMT_MODE:
+      return ! value;
+    case PARAM_FMT_HOUR:
+      hr = (hr + 24 + inc) % 24;
+      return hr * 100 + min;
+    case PARAM_FMT_MINUTE:
+      min = (min + 60 + inc) % 60;
+      return hr * 100 + min;
+  }
+  value += inc;
+  if (value < (long)p->min) {
+    value = p->min;
+  }
+  if (value > (long)p->max) {
+    value = p->max;
+  }
+  return value;
+}
+
+void paramDefaults(void)
+{
+  param_t p;
+  for (uint8_t i = 0; i < PARAM_COUNT; i++) {
+    paramRead(i, &p);
+    if (p.offset != PARAM_CLOCK) {
+      paramStore(&p, p.def);
+    }
+  }
+}
+
+#endif // _PARAMS_H
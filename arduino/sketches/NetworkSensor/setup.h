@@ -41,6 +41,57 @@
  */
 #define NETWORK_LOOP_MS	50
 
+/*
+ * HEALTH_LOOP_MS is how often the link counters (frames sent,
+ * failed, received and receive overflows) are sent to the base
+ * station, so lossy or congested relays can be found remotely.
+ */
+#define HEALTH_LOOP_MS	300000UL
+
+/*
+ * WINDOW_STATS makes ST? answer with an SX: report carrying the
+ * min, max, mean and count of each temperature since the last one,
+ * so a spike between requests still reaches the base station.
+ * Leave it off unless whatever asks understands SX:.
+ */
+#define WINDOW_STATS 0
+
+/*
+ * USE_SLOTS holds frames for the base station until this node's
+ * slot in a superframe worked out from the radio address (see
+ * SlotSchedule.h), so nodes stop talking over each other.  The
+ * slots start once the time has been set from the base station;
+ * until then frames go straight out.  SLOT_DEPTH is the number of
+ * address levels in use and with SLOT_MS sets the superframe
+ * length, so keep it as small as the network allows.  SLOT_QUEUE
+ * frames can wait for the slot, a new status replacing a waiting
+ * one.  Replies to Saki requests are not held.
+ */
+#define USE_SLOTS 0
+#define SLOT_DEPTH 2
+#define SLOT_MS 20
+#define SLOT_QUEUE 4
+
+/*
+ * AGGREGATE sends status to the parent node rather than straight
+ * to the base station.  Relays hold what their children send for
+ * AGGREGATE_WINDOW_MS and pass it on along with their own, several
+ * nodes to a 'p' frame, dropping readings that haven't changed
+ * since they were last passed on.  Every node needs the same
+ * setting.  The base station passes 'p' frames up as they come and
+ * sgf/baselink.py on the host splits them back into 's' records.
+ * AGGREGATE_NODES is how many nodes a relay can hold, ideally its
+ * whole subtree: 31 covers a first level relay of a full 5x5x5
+ * tree (itself, 5 children, 25 below them) at 7 bytes each.  With
+ * fewer a full table is sent early to make room.  Every node still
+ * heard from is sent again each AGGREGATE_REFRESH_MS, changed or
+ * not, so a node missing for a few of those is down.
+ */
+#define AGGREGATE 0
+#define AGGREGATE_WINDOW_MS 500
+#define AGGREGATE_NODES 31
+#define AGGREGATE_REFRESH_MS HEALTH_LOOP_MS
+
 /*
  * MAX_TEMP_SENSORS defines how many sensors are in
  * use.  Currently this can be either 1 or 2.
@@ -80,17 +131,49 @@
 /*
  * Using the TinyRTC board there is an RTC chip that
  * can be used as a time source.  Setting this enables
- * the RTC.  Note that if the RTC is absent and this is
- * set the unit will not start as it polls for the existence
- * of the RTC prior to going into the main loop.
+ * the RTC.  The clock is set from it every RTC_SYNC_MS,
+ * the time being read in the background and picked up
+ * RTC_READ_MS later.  If the RTC is absent at start up
+ * the clock runs free until the time is sent over the
+ * network, and the RTC is looked for again every
+ * RTC_RETRY_MS.
  */
 #define HAS_RTC 1
+#define RTC_SYNC_MS 300000UL
+#define RTC_READ_MS 10
+#define RTC_RETRY_MS 60000UL
 /*
  * For devices that have a time managed component, setting
  * this enables a second relay that can be controlled by
  * the low_time/high_time configuration items.
  */
 #define HAS_TIMED_RELAY 1
+/*
+ * The timed relay task sleeps until the next window edge.  This
+ * caps the sleep (in seconds) so clock corrections from the RTC
+ * are picked up within that time.  SoftTimer periods are kept in
+ * microseconds, so this must stay below about 71 minutes.
+ */
+#define TIMED_RELAY_MAX_SLEEP 3600UL
+
+/*
+ * LOW_POWER puts the processor to sleep between tasks, for battery
+ * powered nodes.  Leaf nodes (relay off) also power the radio down,
+ * waking it for RADIO_WINDOW_MS every RADIO_SLEEP_MS to pass
+ * messages, so anything sent to them is only received in that
+ * window.  Relays have to keep listening for their children.
+ */
+#define LOW_POWER 0
+#define RADIO_SLEEP_MS 10000
+#define RADIO_WINDOW_MS 250
+/*
+ * With LOW_POWER the battery voltage on BATTERY_LEVEL is sampled
+ * every BATTERY_LOOP_MS and reported along with an estimate of the
+ * average current drawn.  BATTERY_FULL_SCALE_MV is the battery
+ * voltage that reads as full scale, allowing for any divider.
+ */
+#define BATTERY_LOOP_MS 300000UL
+#define BATTERY_FULL_SCALE_MV 6600
 
 /*
  * DEBUG controls what appears on the serial port and how
@@ -99,6 +182,14 @@
  */
 #define DEBUG 0
 
+/*
+ * TASK_STATS times the sensor and network tasks.  The figures
+ * are printed every TASK_STATS_MS and, with a radio, returned
+ * one line per task in answer to a Saki TS? message.
+ */
+#define TASK_STATS 0
+#define TASK_STATS_MS 60000
+
 /*
  * The sentinel used in the EEPROM to determine if we have
  * been configured.  If there are changes to the structure
@@ -119,3 +210,5 @@
 void readConfig(void);
 void writeConfig(void);
 void configureTemp(void);
+void configureSchedule(void);
+bool sendFrame(uint16_t to, int type, const void * data, uint8_t len);
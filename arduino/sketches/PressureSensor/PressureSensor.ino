@@ -6,34 +6,110 @@
  * - Add output to handle fill pump
  * - Replace sensor with more accurate one
  */
+// XBee on SoftwareSerial, or CaptureSerial on pins 8/9 (see CaptureSerial.h)
+#define USE_CAPTURE_SERIAL 0
+#define XBEE_BAUD 9600
+/*
+ * TASK_STATS times the tasks, answering TS? with a line per task
+ * and printing them every TASK_STATS_MS.
+ */
+#define TASK_STATS 0
+#define TASK_STATS_MS 60000
+/*
+ * The XBee link counters are sent as an HL: message this often
+ */
+#define HEALTH_MS 300000UL
+/*
+ * The sensor is scanned in the background, PRESSURE_OVERSAMPLE extra
+ * bits from averaging 4^PRESSURE_OVERSAMPLE samples.  4 is 256
+ * samples, about 27ms, which also evens out mains hum.
+ */
+#define PRESSURE_OVERSAMPLE 4
+
 #include <XBee.h>
-#include <SoftwareSerial.h>
+#if USE_CAPTURE_SERIAL
+ #include <CaptureSerial.h>
+#else
+ #include <SoftwareSerial.h>
+#endif
 #include <Saki.h>
 #include <SoftTimer.h>
+#include <TaskStats.h>
+#include <Log.h>
+#include <AdcScanner.h>
 
 #define PRESSURE_SENSOR A0
-#define XB_TX 10
-#define XB_RX 11
 #define IND_LOW 5
 #define IND_MED 7
-#define IND_HIGH 9
+#if USE_CAPTURE_SERIAL
+/* Pin 9 is the XBee TX, so the high indicator moves to 11 */
+ #define IND_HIGH 11
+#else
+ #define XB_TX 10
+ #define XB_RX 11
+ #define IND_HIGH 9
+#endif
 
+#include "calibration.h"
+
+/*
+ * Tank profile, depth in mm to litres.  Starts at 0,0 and takes up
+ * to TANK_POINTS more from the config items V1, V2 ... each set to
+ * depth in cm * 1000000 + litres, so V3:150006780 is 6780 litres at
+ * 1.5m.  They must go up in depth.  With none set the tank is taken
+ * as a cylinder of diameter DI (mm) and height HI (cm).
+ */
+#define TANK_POINTS 8
+cal_point_t tank[TANK_POINTS + 1];
+uint8_t tankPoints = 0;
+
+uint8_t pressureChannel;
+// Pressure in Pa, depth in mm, volume in litres
 long pressure, depth;
 // Diameter in mm
 long diameter = 0;
 long volume = 0;
+// Height in cm
 long height = 0;
 
+#if USE_CAPTURE_SERIAL
+CaptureSerial ser;
+#else
 SoftwareSerial ser(XB_RX, XB_TX);
+#endif
 SakiManager manager("PS", 3, 0, true);
+// Serial logging is queued here and drained by checkManager
+uint8_t logBuffer[128];
 
 void reportStatus(const char **Msg) {
-  manager.setAnalogInput(0, depth, 0);
+  // Depth in cm and pressure in kPa, each to one place
+  manager.setAnalogInput(0, depth, 1);
   manager.setAnalogInput(1, volume, 0);
-  manager.setAnalogInput(2, pressure, 0);
+  manager.setAnalogInput(2, pressure / 100, 1);
   manager.report(Msg == NULL);
 }
 
+void loadTank(SakiConfig * cfg) {
+  char key[3] = "V1";
+  long value;
+  tank[0].x = 0;
+  tank[0].y = 0;
+  tankPoints = 1;
+  while (tankPoints <= TANK_POINTS && (value = cfg->get(key)) > 0) {
+    tank[tankPoints].x = value / 1000000L * 10;
+    tank[tankPoints].y = value % 1000000L;
+    tankPoints++;
+    key[1]++;
+  }
+  if (tankPoints == 1 && height) {
+    // pi r^2 as 355/113, mm^2 down to cm^2 and cm^3 to litres
+    long r = diameter / 2;
+    tank[1].x = height * 10;
+    tank[1].y = r * r / 113 * 355 / 100 * height / 1000;
+    tankPoints = 2;
+  }
+}
+
 void updateConfig() {
   long value;
   SakiConfig * cfg = manager.getConfig();
@@ -44,6 +120,7 @@ void updateConfig() {
   if ((value = cfg->get("HI")) != 0) {
     height = value;
   }
+  loadTank(cfg);
 }
 
 /*
@@ -68,55 +145,78 @@ void updateConfig() {
  * This gives us:
  *
  * 101.325kPa = 1024/5
- * So we get 1 tick = 495Pa = roughly 50mm which is our resolution
+ * So we get 1 tick = 495Pa = roughly 50mm.  With the oversampling
+ * there are 16 ticks to each of those, about 3mm, and the sensor
+ * noise is what limits us.
  * 
  * To get the pressure we need to remove the 0.5 atmospheres
+ *
+ * The line is held as a calibration table from the raw reading to
+ * depth, worked out by the compiler.  Points from a real sensor,
+ * raw reading against measured depth, can replace them.
  */
- 
+#define SENSOR_PA(raw) (495L * (raw) / (1 << PRESSURE_OVERSAMPLE) - 49500L)
+#define SENSOR_DEPTH_MM(raw) (SENSOR_PA(raw) * 10 / 98)
+#define SENSOR_ZERO (49500L * (1 << PRESSURE_OVERSAMPLE) / 495)
+#define SENSOR_FULL ((1024L << PRESSURE_OVERSAMPLE) - 1)
+#define SENSOR_POINT(n) { SENSOR_ZERO + (SENSOR_FULL - SENSOR_ZERO) * (n) / 4, \
+  SENSOR_DEPTH_MM(SENSOR_ZERO + (SENSOR_FULL - SENSOR_ZERO) * (n) / 4) }
+
+const cal_point_t sensorDepth[] PROGMEM = {
+  SENSOR_POINT(0),
+  SENSOR_POINT(1),
+  SENSOR_POINT(2),
+  SENSOR_POINT(3),
+  SENSOR_POINT(4)
+};
+
+
 void checkPressure(Task *me) {
-  double radius;
-  int raw_value = analogRead(PRESSURE_SENSOR);
-  double real_pressure = (495 * (long)raw_value) - 49500;
-  Serial.println(real_pressure);
-  double real_depth = real_pressure / 98.0;
-  pressure = real_pressure / 1000.0;  // Pressure in kPa
-  depth = real_depth; // Depth in cm
-  if (diameter) {
-    radius = (double)diameter / 200.0; // Get radius in decimetres
-    volume = (3.141592653 * radius * radius * real_depth / 10.0); // Volume in litres
-  }
+  long raw_value = AdcScan.read(pressureChannel);
+  pressure = SENSOR_PA(raw_value);
+  depth = interpolate_P(sensorDepth, sizeof(sensorDepth) / sizeof(cal_point_t), raw_value);
+  volume = interpolate(tank, tankPoints, depth);
+  logDebugln(pressure);
   digitalWrite(IND_HIGH, LOW);
   digitalWrite(IND_MED, LOW);
   digitalWrite(IND_LOW, LOW);
-  if (depth > (height * 0.6)) {
+  // height is in cm, depth in mm
+  if (depth * 10 > height * 60) {
     digitalWrite(IND_HIGH, HIGH);
-  } else if (depth > (height * 0.2)) {
+  } else if (depth * 10 > height * 20) {
     digitalWrite(IND_MED, HIGH);
   } else {
     digitalWrite(IND_LOW, HIGH);
   }
   reportStatus(NULL);
-  Serial.print(raw_value);
-  Serial.print("P:");
-  Serial.print(real_pressure);
-  Serial.print(":");
-  Serial.print(pressure);
-  Serial.print(" D:");
-  Serial.print(real_depth);
-  Serial.print(":");
-  Serial.println(depth);
-  
+  logInfo(raw_value);
+  logInfo(F(" P:"));
+  logInfo(pressure);
+  logInfo(F(" D:"));
+  logInfo(depth);
+  logInfo(F(" V:"));
+  logInfoln(volume);
+
 }
 
 void checkManager(Task *me) {
+  Log.drain();
   manager.check();
   if (manager.configChanged) {
     updateConfig();
   }
 }
 
-Task checkPressureTask(10000, checkPressure);
-Task checkManagerTask(100, checkManager);
+StatTask checkPressureTask(10000, checkPressure, "PR");
+StatTask checkManagerTask(100, checkManager, "MGR");
+
+#if TASK_STATS
+void reportTaskStats(const char **Msg) {
+  InstrumentedTask::replyAll(manager);
+}
+
+Task statsDump(TASK_STATS_MS, InstrumentedTask::printAllTask);
+#endif
 
 void setup() {
   pinMode(IND_LOW, OUTPUT);
@@ -129,10 +229,16 @@ void setup() {
   SakiConfig * cfg;
   manager.debug(false);  
   Serial.begin(9600);
-  ser.begin(9600);
+  Log.begin(Serial, logBuffer, sizeof(logBuffer));
+  ser.begin(XBEE_BAUD);
   manager.registerHandler("ST?", &reportStatus);
+#if TASK_STATS
+  manager.registerHandler("TS?", &reportTaskStats);
+  SoftTimer.add(&statsDump);
+#endif
   manager.debug(true);
   manager.start(ser);
+  manager.healthInterval(HEALTH_MS);
   cfg = manager.getConfig();
   cfg->load();
   cfg->setDefault("HI", 210);
@@ -140,6 +246,8 @@ void setup() {
   cfg->save();
   updateConfig();
   manager.send("Starting");
+  pressureChannel = AdcScan.add(PRESSURE_SENSOR, PRESSURE_OVERSAMPLE);
+  AdcScan.begin();
   SoftTimer.add(&checkPressureTask);
   SoftTimer.add(&checkManagerTask);
 }
@@ -0,0 +1,71 @@
+#ifndef _CALIBRATION_H
+#define _CALIBRATION_H
+/*
+ * Piecewise linear calibration, all in integers.
+ *
+ * A table is a list of points in increasing x.  interpolate() finds
+ * the pair either side of x and works out y on the line between
+ * them, holding at the first or last y outside the table.  Tables
+ * can be in RAM or, with the _P version, PROGMEM.
+ */
+
+typedef struct _cal_point_t {
+  long x;
+  long y;
+} cal_point_t;
+
+/*
+ * y0 + dy * t / dx, split so dy * t can't overflow: dy can be
+ * litres in the hundreds of thousands with t in millimetres.
+ */
+long calLine(const cal_point_t * a, const cal_point_t * b, long x)
+{
+  long dx = b->x - a->x;
+  long dy = b->y - a->y;
+  long t = x - a->x;
+  if (dx <= 0) {
+    return a->y;
+  }
+  return a->y + (dy / dx) * t + (dy % dx) * t / dx;
+}
+
+long interpolate(const cal_point_t * table, uint8_t n, long x)
+{
+  uint8_t i;
+  if (n == 0) {
+    return 0;
+  }
+  if (x <= table[0].x) {
+    return table[0].y;
+  }
+  for (i = 1; i < n; i++) {
+    if (x <= table[i].x) {
+      return calLine(&table[i - 1], &table[i], x);
+    }
+  }
+  return table[n - 1].y;
+}
+
+long interpolate_P(const cal_point_t * table, uint8_t n, long x)
+{
+  cal_point_t a, b;
+  uint8_t i;
+  if (n == 0) {
+    return 0;
+  }
+  memcpy_P(&a, &table[0], sizeof(a));
+  if (x <= a.x) {
+    return a.y;
+  }
+  for (i = 1; i < n; i++) {
+    memcpy_P(&b, &table[i], sizeof(b));
+    if (x <= b.x) {
+      return calLine(&a, &b, x);
+    }
+    a = b;
+  }
+  return a.y;
+}
+
+#endif // _CALIBRATION_H
+// vim:ai sw=2 expandtab:
@@ -11,8 +11,16 @@
  * - Add timer for daily flush out
  * - Change to use SoftTimer
  */
+// XBee on SoftwareSerial, or CaptureSerial on pins 8/9 (see CaptureSerial.h)
+#define USE_CAPTURE_SERIAL 0
+#define XBEE_BAUD 9600
+
 #include <XBee.h>
-#include <SoftwareSerial.h>
+#if USE_CAPTURE_SERIAL
+ #include <CaptureSerial.h>
+#else
+ #include <SoftwareSerial.h>
+#endif
 #include <Saki.h>
 
 /* Inputs are active low */
@@ -45,7 +53,11 @@ unsigned long flushTimer = 0;
 
 /* Set up the manager using SerialSoftware on port 3/4 */
 SakiManager manager("WW", 3, 1, true);
+#if USE_CAPTURE_SERIAL
+CaptureSerial serialPort;
+#else
 SoftwareSerial serialPort(3, 4);
+#endif
 
 /* Simple method to turn the pump on */
 void startPump(boolean force = false) {
@@ -120,7 +132,8 @@ void setStatus(const char ** Msg) {
 void setError(char *msg) {
   char * buf;
   buf = (char *)malloc(strlen(msg)+4);
-  sprintf(buf, "ER:%s", msg);
+  strcpy(buf, "ER:");
+  strcpy(buf + 3, msg);
   manager.send(buf);
   free(buf);
 }
@@ -185,7 +198,7 @@ void setup() {
   /* Set the pump off, just to be sure */
   digitalWrite(pumpRelay, HIGH);
   Serial.begin(9600);
-  serialPort.begin(9600);
+  serialPort.begin(XBEE_BAUD);
   Serial.println("0Starting...");
   manager.registerHandler("ST", &setStatus);
   manager.registerHandler("ST?", &reportStatus);
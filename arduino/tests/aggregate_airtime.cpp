@@ -0,0 +1,146 @@
+/*
+ * The airtime NetworkSensor's AGGREGATE saves in a full 5x5x5 tree,
+ * 155 nodes three levels deep.
+ *
+ * Sent direct, each node's 16 byte message_t goes all the way to
+ * 00, taking the air once per hop.  Aggregated, every node sends
+ * one hop to its parent, once per window: the changed readings
+ * from its subtree, its own included, four 6 byte entries to a 'p'
+ * frame.  A frame's airtime is the nRF24 packet at 1Mbps with its
+ * 8 byte RF24Network header, the auto ack and a 130us turnaround
+ * each way.  Collisions and retries are left out, see slot_schedule
+ * for those, and so are the AGGREGATE_REFRESH_MS resends, one
+ * window's worth every few minutes.
+ *
+ * Each row is a share of nodes changing per window, once with only
+ * those sending and once with every node sending each scan, as
+ * nodes without AGGREGATE do.  Aggregation drops the unchanged
+ * readings either way.  Times are the airtime for one window.
+ */
+
+#include <SlotSchedule.h>
+#include "host/check.h"
+
+#define DEPTH 3
+#define MAX_NODES 155
+#define ROUNDS 200
+#define MESSAGE_BYTES 16
+#define ENTRY_BYTES 6
+#define ENTRIES_PER_FRAME 4
+// Preamble, address, packet control and CRC bits
+#define PACKET_BITS (8 + 40 + 9 + 16)
+#define TURNAROUND_US 130
+#define HEADER_BYTES 8
+
+static uint16_t addresses[MAX_NODES];
+static uint8_t depth[MAX_NODES];
+static bool changed[MAX_NODES];
+
+// Microseconds at 1Mbps for one hop with its ack
+static unsigned long
+hopUs(uint8_t payload)
+{
+  return PACKET_BITS + 8 * (HEADER_BYTES + payload)
+    + PACKET_BITS + 2 * TURNAROUND_US;
+}
+
+// Breadth first, as in slot_schedule
+static void
+listAddresses(void)
+{
+  uint16_t n = 0;
+  uint16_t first = 0;
+  uint16_t last;
+  uint8_t digit;
+  for (digit = 1; digit <= SLOT_FANOUT; digit++) {
+    depth[n] = 1;
+    addresses[n++] = digit;
+  }
+  for (uint8_t level = 1; level < DEPTH; level++) {
+    last = n;
+    for (uint16_t p = first; p < last; p++) {
+      for (digit = 1; digit <= SLOT_FANOUT; digit++) {
+        depth[n] = level + 1;
+        addresses[n++] = addresses[p] | (digit << (3 * level));
+      }
+    }
+    first = last;
+  }
+}
+
+static bool
+inSubtree(uint16_t node, uint16_t relay)
+{
+  return depth[node] >= depth[relay]
+    && (addresses[node] & ((1 << (3 * depth[relay])) - 1)) == addresses[relay];
+}
+
+static unsigned long
+direct(bool everyScan)
+{
+  unsigned long us = 0;
+  for (uint16_t i = 0; i < MAX_NODES; i++) {
+    if (changed[i] || everyScan) {
+      us += depth[i] * hopUs(MESSAGE_BYTES);
+    }
+  }
+  return us;
+}
+
+static unsigned long
+packed(void)
+{
+  unsigned long us = 0;
+  uint8_t entries;
+  for (uint16_t relay = 0; relay < MAX_NODES; relay++) {
+    entries = 0;
+    for (uint16_t i = 0; i < MAX_NODES; i++) {
+      if (changed[i] && inSubtree(i, relay)) {
+        entries++;
+      }
+    }
+    us += (entries / ENTRIES_PER_FRAME) * hopUs(ENTRIES_PER_FRAME * ENTRY_BYTES);
+    if (entries % ENTRIES_PER_FRAME) {
+      us += hopUs((entries % ENTRIES_PER_FRAME) * ENTRY_BYTES);
+    }
+  }
+  return us;
+}
+
+// Percentage of the direct airtime saved
+static int
+simulate(int percent, bool everyScan)
+{
+  unsigned long plain = 0;
+  unsigned long aggregated = 0;
+  for (int r = 0; r < ROUNDS; r++) {
+    for (uint16_t i = 0; i < MAX_NODES; i++) {
+      changed[i] = random(100) < percent;
+    }
+    plain += direct(everyScan);
+    aggregated += packed();
+  }
+  int saving = 100 - aggregated * 100 / plain;
+  printf("%7d%% %8s %8.1f %8.1f %6d%%\n", percent, everyScan ? "every" : "changed",
+    plain / ROUNDS / 1000.0, aggregated / ROUNDS / 1000.0, saving);
+  return saving;
+}
+
+int
+main(void)
+{
+  srand(1);
+  listAddresses();
+  CHECK(inSubtree(MAX_NODES - 1, SLOT_FANOUT - 1));
+  CHECK( ! inSubtree(SLOT_FANOUT - 1, MAX_NODES - 1));
+  // A 6 byte entry costs 48us of a frame, a 16 byte message_t 128us
+  CHECK(hopUs(MESSAGE_BYTES) - hopUs(0) == 128);
+
+  printf("changing  sending   direct   packed  saving\n");
+  CHECK(simulate(100, false) >= 50);
+  CHECK(simulate(50, false) >= 45);
+  CHECK(simulate(50, true) >= 70);
+  CHECK(simulate(10, false) >= 30);
+  CHECK(simulate(10, true) >= 90);
+  return checkFailures("aggregate_airtime");
+}
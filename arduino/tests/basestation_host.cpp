@@ -0,0 +1,90 @@
+/*
+ * The BaseStation sketch on Linux: its serial port is a pty and the
+ * radio a mock network of five nodes, each sending 's' frames
+ * carrying a running count.  Writes to node 077 fail.  The pty name
+ * is printed first, for server/tests/test_baselink.py to connect
+ * the host end to.  It stops a few seconds after the last frame.
+ *
+ *   basestation_host [frames]
+ */
+
+#include <pty.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "../sketches/BaseStation/BaseStation.ino"
+
+static unsigned long frames = 2000;
+static unsigned long sent;
+static unsigned long nextAt;
+
+static unsigned long
+now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000UL + tv.tv_usec / 1000;
+}
+
+uint8_t RF24Network::update(void) { return 0; }
+
+// A frame a millisecond, round the nodes
+bool
+RF24Network::available(void)
+{
+  return sent < frames && millis() >= nextAt;
+}
+
+uint16_t
+RF24Network::read(RF24NetworkHeader & header, void * message, uint16_t maxlen)
+{
+  static const uint16_t nodes[] = { 01, 02, 011, 0125, 05555 };
+  uint32_t count = sent;
+  header.from_node = nodes[sent % 5];
+  header.type = 's';
+  memset(message, 0, 16);
+  memcpy(message, &count, sizeof(count));
+  sent++;
+  nextAt = millis() + 1;
+  return 16;
+}
+
+bool
+RF24Network::write(RF24NetworkHeader & header, const void * message, uint16_t len)
+{
+  return header.to_node != 077;
+}
+
+int
+main(int argc, char ** argv)
+{
+  int slave;
+  char name[64];
+  struct termios tio;
+  unsigned long start = now();
+  unsigned long end = 0;
+
+  if (argc > 1) {
+    frames = atol(argv[1]);
+  }
+  openpty(&hostSerialFd, &slave, name, NULL, NULL);
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fcntl(hostSerialFd, F_SETFL, O_NONBLOCK);
+  printf("%s\n", name);
+  fflush(stdout);
+
+  setup();
+  while ( ! end || millis() < end) {
+    hostMillis = now() - start;
+    SoftTimer.run();
+    if (sent >= frames && ! end) {
+      end = millis() + 3000;
+    }
+    usleep(50);
+  }
+  fprintf(stderr, "base: dropped %u bad %u batches %u\n", host.dropped, host.badFrames, host.batches);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Recorded DHT22 pulse trains replayed through DHT22Decoder.
+ *
+ * Each train is the time in microseconds between falling edges as
+ * the pin change interrupt sees them: the reply edge (timed from
+ * letting the line go, and ignored), the ack, then the 40 bits.
+ * They have a few microseconds of jitter, as from the timer0 and
+ * display interrupts, and the last three are damaged: a bad
+ * checksum, an edge missed so two bits run together, and an ack
+ * cut short by noise.
+ */
+
+#include <DHT22Reader.h>
+#include "host/check.h"
+
+// 65.2%, 23.5C
+static const uint8_t warm[] = {
+  29, 158, 78, 72, 73, 80, 73, 77, 116, 80, 119, 72, 73, 78,
+  122, 117, 75, 73, 80, 78, 72, 73, 75, 72, 78, 72, 119, 116,
+  124, 74, 120, 78, 118, 124, 73, 120, 124, 118, 117, 75, 77, 117
+};
+
+// 87.4%, -10.1C
+static const uint8_t frost[] = {
+  32, 157, 72, 75, 79, 80, 78, 77, 123, 123, 77, 120, 119, 74,
+  119, 73, 120, 80, 123, 77, 79, 76, 73, 73, 80, 78, 74, 121,
+  118, 79, 78, 116, 73, 124, 77, 121, 77, 123, 79, 73, 117, 76
+};
+
+// 40.1%, 31.8C with +/-12us jitter
+static const uint8_t jitter[] = {
+  31, 170, 85, 66, 65, 87, 86, 73, 84, 126, 129, 78, 73, 130,
+  76, 85, 75, 108, 78, 75, 69, 83, 67, 79, 65, 114, 88, 73,
+  112, 131, 115, 120, 120, 79, 110, 113, 78, 120, 81, 72, 68, 121
+};
+
+static const uint8_t checksum[] = {
+  32, 160, 78, 77, 78, 75, 74, 73, 118, 74, 119, 75, 72, 79,
+  118, 120, 76, 72, 74, 78, 80, 77, 77, 74, 80, 72, 123, 124,
+  122, 78, 122, 78, 117, 123, 78, 72, 75, 117, 75, 79, 118, 73
+};
+
+static const uint8_t missed[] = {
+  29, 156, 73, 72, 74, 80, 73, 77, 72, 117, 119, 122, 118, 120,
+  77, 121, 79, 73, 73, 79, 158, 79, 76, 73, 74, 117, 121, 76,
+  79, 118, 80, 72, 75, 124, 77, 118, 124, 116, 124, 76, 117
+};
+
+static const uint8_t noack[] = {
+  28, 90, 77, 74, 77, 75, 80, 80, 80, 121, 119, 119, 119, 122,
+  75, 119, 80, 79, 77, 72, 72, 76, 79, 76, 75, 77, 123, 121,
+  77, 73, 119, 73, 75, 79, 119, 77, 119, 123, 116, 123, 77, 117
+};
+
+static DHT22Decoder decoder;
+
+// The status the reader would give, a train that stops early timing out
+static uint8_t
+replay(const uint8_t * train, uint8_t length)
+{
+  decoder.reset();
+  for (uint8_t i = 0; i < length; i++) {
+    if (decoder.edge(train[i])) {
+      break;
+    }
+  }
+  return decoder.finished() ? decoder.status : DHT22_NO_REPLY;
+}
+
+int
+main(void)
+{
+  CHECK(replay(warm, sizeof(warm)) == DHT22_OK);
+  CHECK(decoder.temperature() == 235);
+  CHECK(decoder.humidity() == 652);
+
+  CHECK(replay(frost, sizeof(frost)) == DHT22_OK);
+  CHECK(decoder.temperature() == -101);
+  CHECK(decoder.humidity() == 874);
+
+  CHECK(replay(jitter, sizeof(jitter)) == DHT22_OK);
+  CHECK(decoder.temperature() == 318);
+  CHECK(decoder.humidity() == 401);
+
+  CHECK(replay(checksum, sizeof(checksum)) == DHT22_CHECKSUM);
+  CHECK(replay(missed, sizeof(missed)) == DHT22_BAD_BIT);
+  CHECK(replay(noack, sizeof(noack)) == DHT22_BAD_ACK);
+
+  // Cut off part way, as a sensor that stops answering
+  CHECK(replay(warm, 20) == DHT22_NO_REPLY);
+  return checkFailures("dht22_replay");
+}
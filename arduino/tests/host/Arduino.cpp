@@ -0,0 +1,101 @@
+/* Host side of the Arduino core, for the tests. */
+
+#include "Arduino.h"
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <unistd.h>
+
+unsigned long hostMillis;
+HardwareSerial Serial;
+int hostSerialFd = -1;
+// Quiet unless HOST_VERBOSE is set in the environment
+static bool verbose = getenv("HOST_VERBOSE") != NULL;
+static uint8_t eeprom[1024];
+
+volatile unsigned long timer0_millis;
+volatile unsigned long timer0_overflow_count;
+unsigned long millis(void) { return hostMillis + timer0_millis; }
+unsigned long micros(void) { return millis() * 1000UL; }
+void delay(unsigned long ms) { hostMillis += ms; }
+
+long random(long howbig) { return howbig > 0 ? rand() % howbig : 0; }
+long random(long howsmall, long howbig) { return howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { srand(seed); }
+
+uint8_t SREG;
+uint8_t UCSR0B, ADCSRA, MCUSR, WDTCSR;
+uint8_t hostSleepMode;
+void (*hostSleep)(uint8_t mode);
+
+uint8_t hostPins[HOST_PINS];
+uint16_t hostAnalog[HOST_PINS];
+
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+  if (mode == INPUT_PULLUP && pin < HOST_PINS) {
+    hostPins[pin] = HIGH;
+  }
+}
+
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < HOST_PINS) {
+    hostPins[pin] = value ? HIGH : LOW;
+  }
+}
+
+int
+digitalRead(uint8_t pin)
+{
+  return pin < HOST_PINS ? hostPins[pin] : LOW;
+}
+
+int
+analogRead(uint8_t pin)
+{
+  return pin < HOST_PINS ? hostAnalog[pin] : 0;
+}
+
+int HardwareSerial::available(void) { return 0; }
+
+int
+HardwareSerial::read(void)
+{
+  uint8_t c;
+  if (hostSerialFd >= 0 && ::read(hostSerialFd, &c, 1) == 1) {
+    return c;
+  }
+  return -1;
+}
+
+size_t
+HardwareSerial::write(uint8_t c)
+{
+  if (hostSerialFd >= 0) {
+    return ::write(hostSerialFd, &c, 1) == 1;
+  }
+  if (verbose) {
+    putchar(c);
+  }
+  return 1;
+}
+
+size_t Print::print(const __FlashStringHelper * s) { return print((const char *)s); }
+size_t Print::print(const char s[]) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(int n, int b) { return print((long)n, b); }
+size_t Print::print(unsigned int n, int b) { return print((unsigned long)n, b); }
+size_t Print::print(long n, int b) { char buf[24]; snprintf(buf, sizeof(buf), b == 16 ? "%lx" : "%ld", n); return write(buf); }
+size_t Print::print(unsigned long n, int b) { char buf[24]; snprintf(buf, sizeof(buf), b == 16 ? "%lx" : "%lu", n); return write(buf); }
+size_t Print::println(const __FlashStringHelper * s) { return print(s) + println(); }
+size_t Print::println(const char s[]) { return print(s) + println(); }
+size_t Print::println(int n, int b) { return print(n, b) + println(); }
+size_t Print::println(unsigned int n, int b) { return print(n, b) + println(); }
+size_t Print::println(long n, int b) { return print(n, b) + println(); }
+size_t Print::println(unsigned long n, int b) { return print(n, b) + println(); }
+size_t Print::println(void) { return write("\r\n"); }
+
+void eeprom_read_block(void * dst, const void * src, size_t n) { memcpy(dst, eeprom + (size_t)src, n); }
+void eeprom_write_block(const void * src, void * dst, size_t n) { memcpy(eeprom + (size_t)dst, src, n); }
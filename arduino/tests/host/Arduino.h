@@ -0,0 +1,104 @@
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+/**
+ * Just enough of the Arduino core to build libraries on Linux for
+ * the host tests.  millis() is hostMillis, which the tests move on
+ * themselves, plus timer0_millis, which PowerManager moves on after
+ * a sleep.  Serial goes to hostSerialFd if a test sets it, or
+ * else to stdout.  Pins are levels in hostPins[], which tests may
+ * set to stand in for inputs, and analogRead() gives hostAnalog[].
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define HEX 16
+#define DEC 10
+#define F_CPU 16000000UL
+#define clockCyclesPerMicrosecond() (F_CPU / 1000000L)
+#define _BV(b) (1 << (b))
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+extern unsigned long hostMillis;
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+#define HOST_PINS 20
+extern uint8_t hostPins[HOST_PINS];
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+extern uint16_t hostAnalog[HOST_PINS];
+int analogRead(uint8_t pin);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+class Print {
+  public:
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t * b, size_t n) { size_t r = 0; while (n--) r += write(*b++); return r; }
+    size_t write(const char * s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t write(const char * b, size_t n) { return write((const uint8_t *)b, n); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+    size_t print(const __FlashStringHelper *);
+    size_t print(const char[]);
+    size_t print(char);
+    size_t print(int, int = DEC);
+    size_t print(unsigned int, int = DEC);
+    size_t print(long, int = DEC);
+    size_t print(unsigned long, int = DEC);
+    size_t println(const __FlashStringHelper *);
+    size_t println(const char[]);
+    size_t println(int, int = DEC);
+    size_t println(unsigned int, int = DEC);
+    size_t println(long, int = DEC);
+    size_t println(unsigned long, int = DEC);
+    size_t println(void);
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    virtual int available();
+    virtual int read();
+    virtual int peek() { return -1; }
+    virtual size_t write(uint8_t);
+    virtual int availableForWrite() { return 64; }
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+extern int hostSerialFd;
+
+#endif // _HOST_ARDUINO_H
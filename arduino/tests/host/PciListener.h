@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+class PciListener {
+  public:
+    virtual void pciHandleInterrupt(byte vect) = 0;
+    byte pin;
+    PciListener * pciNextListener;
+};
@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+#include <PciListener.h>
+// No pin change interrupts; tests call pciHandleInterrupt() themselves
+class PciManagerClass {
+  public:
+    void registerListener(byte pin, PciListener * listener) { listener->pin = pin; }
+    void removeListener(PciListener * listener) {}
+};
+static PciManagerClass PciManager __attribute__((unused));
@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+#include <RF24.h>
+// The parts of RF24Network the sketches use, for a test to implement
+struct RF24NetworkHeader {
+  uint16_t from_node;
+  uint16_t to_node;
+  uint16_t id;
+  unsigned char type;
+  unsigned char reserved;
+  RF24NetworkHeader() {}
+  RF24NetworkHeader(uint16_t to, unsigned char type = 0) : to_node(to), type(type) {}
+};
+class RF24Network {
+  public:
+    RF24Network(RF24 & radio) {}
+    void begin(uint8_t channel, uint16_t address) {}
+    uint8_t update(void);
+    bool available(void);
+    uint16_t read(RF24NetworkHeader & header, void * message, uint16_t maxlen);
+    bool write(RF24NetworkHeader & header, const void * message, uint16_t len);
+};
@@ -0,0 +1,6 @@
+#pragma once
+class SPIClass {
+  public:
+    static void begin(void) {}
+};
+static SPIClass SPI;
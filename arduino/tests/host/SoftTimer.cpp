@@ -0,0 +1,36 @@
+/* A SoftTimer that runs its tasks off the host millis() */
+
+#include "SoftTimer.h"
+
+SoftTimerClass SoftTimer;
+static Task * tasks;
+
+void
+SoftTimerClass::add(Task * task)
+{
+  task->lastCallTimeMicros = micros();
+  task->nextTask = tasks;
+  tasks = task;
+}
+
+void
+SoftTimerClass::remove(Task * task)
+{
+  for (Task ** t = &tasks; *t; t = &(*t)->nextTask) {
+    if (*t == task) {
+      *t = task->nextTask;
+      return;
+    }
+  }
+}
+
+void
+SoftTimerClass::run(void)
+{
+  for (Task * t = tasks; t; t = t->nextTask) {
+    if (micros() - t->lastCallTimeMicros >= t->periodMicros) {
+      t->lastCallTimeMicros = micros();
+      t->callback(t);
+    }
+  }
+}
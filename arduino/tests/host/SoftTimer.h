@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+#include <Task.h>
+// Tasks are run by the test, see SoftTimerClass::run()
+class SoftTimerClass {
+  public:
+    void add(Task * task);
+    void remove(Task * task);
+    void run(void);
+};
+extern SoftTimerClass SoftTimer;
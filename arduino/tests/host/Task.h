@@ -0,0 +1,12 @@
+#pragma once
+#include <Arduino.h>
+class Task {
+  public:
+    Task(unsigned long periodMs, void (*callback)(Task * me))
+    : periodMicros(periodMs * 1000), lastCallTimeMicros(0), callback(callback), nextTask(NULL) {}
+    void setPeriodMs(unsigned long periodMs) { periodMicros = periodMs * 1000; }
+    unsigned long periodMicros;
+    unsigned long lastCallTimeMicros;
+    void (*callback)(Task * me);
+    Task * nextTask;
+};
@@ -0,0 +1,5 @@
+#pragma once
+// One thread on the host, so nothing to mask
+#define ISR(v, ...) extern "C" void v(void)
+#define sei()
+#define cli()
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+// The registers the libraries touch, as plain bytes
+extern uint8_t SREG;
+extern uint8_t UCSR0B, ADCSRA, MCUSR, WDTCSR;
+#define UDRIE0 5
+#define ADEN 7
+#define WDRF 3
+#define WDP3 5
+#define WDCE 4
+#define WDE 3
+#define WDIE 6
@@ -0,0 +1,5 @@
+#pragma once
+#include <string.h>
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+// sleep_cpu() calls hostSleep, if a test sets it, to pass the time asleep
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+extern uint8_t hostSleepMode;
+extern void (*hostSleep)(uint8_t mode);
+#define set_sleep_mode(m) (hostSleepMode = (m))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() do { if (hostSleep) hostSleep(hostSleepMode); } while (0)
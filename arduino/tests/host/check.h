@@ -0,0 +1,20 @@
+#ifndef _HOST_CHECK_H
+#define _HOST_CHECK_H
+
+#include <stdio.h>
+
+// Counts and reports failures; main() returns checkFailures()
+static int _checkFailed;
+
+#define CHECK(cond) do { if ( ! (cond)) { \
+  printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+  _checkFailed++; } } while (0)
+
+static inline int
+checkFailures(const char * name)
+{
+  printf("%s: %s\n", name, _checkFailed ? "FAILED" : "ok");
+  return _checkFailed ? 1 : 0;
+}
+
+#endif // _HOST_CHECK_H
@@ -0,0 +1,52 @@
+/*
+ * HostLink credit: batches stop when the credit is used up, and it
+ * is only renewed HOST_LINK_CREDIT_MS after that if the host never
+ * acks.
+ */
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <HostLink.h>
+#include "host/check.h"
+
+static HostLink link;
+
+// Adds a record and waits long enough for it to go in a batch of its own
+static void
+batch(void)
+{
+  uint8_t data[4] = { 1, 2, 3, 4 };
+  link.add(01, 's', data, sizeof(data));
+  hostMillis += HOST_LINK_FLUSH_MS;
+  link.poll();
+}
+
+int
+main(void)
+{
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  hostSerialFd = fds[0];
+
+  link.begin(Serial, NULL);
+  // Long after the start, so the credit time isn't simply 0
+  hostMillis = 10 * HOST_LINK_CREDIT_MS;
+  for (int i = 0; i < HOST_LINK_CREDITS; i++) {
+    batch();
+  }
+  CHECK(link.batches == HOST_LINK_CREDITS);
+
+  // Out of credit: the next batch waits
+  batch();
+  CHECK(link.batches == HOST_LINK_CREDITS);
+  hostMillis += HOST_LINK_CREDIT_MS / 2;
+  link.poll();
+  CHECK(link.batches == HOST_LINK_CREDITS);
+
+  // Until the credit has been out for HOST_LINK_CREDIT_MS
+  hostMillis += HOST_LINK_CREDIT_MS / 2;
+  link.poll();
+  CHECK(link.batches == HOST_LINK_CREDITS + 1);
+  return checkFailures("host_link");
+}
@@ -0,0 +1,59 @@
+/*
+ * NumFormat against the strings sprintf would give.  long is 32 bits
+ * on the AVR, so its limits are INT32_MIN and INT32_MAX here.
+ */
+
+#include <stdint.h>
+#include <NumFormat.h>
+#include "host/check.h"
+
+static char buf[NUM_FORMAT_MAX + 8];
+
+#define FORMATS(call, text) do { \
+  char * end = call; \
+  CHECK( ! strcmp(buf, text)); \
+  CHECK(end == buf + strlen(text)); \
+  } while (0)
+
+int
+main(void)
+{
+  FORMATS(formatLong(buf, 0), "0");
+  FORMATS(formatLong(buf, INT32_MAX), "2147483647");
+  FORMATS(formatLong(buf, INT32_MIN), "-2147483648");
+  FORMATS(formatLong(buf, -42, 6), "   -42");
+  // The sign goes ahead of zero padding
+  FORMATS(formatLong(buf, -42, 6, '0'), "-00042");
+  FORMATS(formatLong(buf, 12345, 3), "12345");
+
+  FORMATS(formatUnsigned(buf, 0xffffffffUL), "4294967295");
+  FORMATS(formatUnsigned(buf, 0xbeef, 16), "beef");
+  FORMATS(formatUnsigned(buf, 7, 10, 3, '0'), "007");
+
+  // Radio addresses, in octal
+  FORMATS(formatUnsigned(buf, 0, 8), "0");
+  FORMATS(formatUnsigned(buf, 05555, 8), "5555");
+  FORMATS(formatUnsigned(buf, 011, 8, 2, '0'), "11");
+  FORMATS(formatUnsigned(buf, 01, 8, 2, '0'), "01");
+  FORMATS(formatUnsigned(buf, 0xffffffffUL, 8), "37777777777");
+
+  FORMATS(formatFixed(buf, 235, 1), "23.5");
+  FORMATS(formatFixed(buf, 5, 1), "0.5");
+  FORMATS(formatFixed(buf, -5, 1), "-0.5");
+  FORMATS(formatFixed(buf, -1234, 2), "-12.34");
+  FORMATS(formatFixed(buf, 7, 3), "0.007");
+  FORMATS(formatFixed(buf, -7, 3, 7, '0'), "-00.007");
+  FORMATS(formatFixed(buf, -101, 1, 6), " -10.1");
+  FORMATS(formatFixed(buf, 0, 2), "0.00");
+  FORMATS(formatFixed(buf, -42, 0), "-42");
+  FORMATS(formatFixed(buf, INT32_MIN, 2), "-21474836.48");
+  FORMATS(formatFixed(buf, INT32_MAX, 9), "2.147483647");
+
+  // Fields append in turn
+  char * p = buf;
+  p = formatLong(p, -3);
+  *p++ = ':';
+  p = formatFixed(p, 1005, 2);
+  CHECK( ! strcmp(buf, "-3:10.05"));
+  return checkFailures("num_format");
+}
@@ -0,0 +1,164 @@
+/*
+ * PowerManager's current estimate for NetworkSensor with LOW_POWER,
+ * as a relay and as a leaf.
+ *
+ * The node's tasks run off SoftTimer through the power manager and
+ * sleep() is called between them, as the sketch's idle task does.
+ * Sleeping is simulated: idle lasts until the next timer0 tick, and
+ * power down until the watchdog fires, after which PowerManager
+ * moves the clock on itself.  The time in each state is also added
+ * up here, and estimateMicroAmps() has to agree with the datasheet
+ * figures weighted by it.  A relay keeps its radio on; a leaf opens
+ * it for RADIO_WINDOW_MS every RADIO_SLEEP_MS, closing it from a
+ * DelayRun the power manager doesn't see, so late.
+ *
+ * long is 64 bits on the host, so this doesn't show a 32 bit
+ * overflow; the estimate's parts per 10000 keep each term under
+ * 10000 * POWER_RADIO_ON_UA.
+ */
+
+#include <math.h>
+#include <avr/sleep.h>
+#include <PowerManager.h>
+#include "host/check.h"
+
+#define HOUR_MS 3600000UL
+#define NETWORK_LOOP_MS 50
+#define NETWORK_WORK_MS 1
+#define SENSOR_LOOP_MS 395
+#define SENSOR_WORK_MS 5
+#define RADIO_SLEEP_MS 10000
+#define RADIO_WINDOW_MS 250
+
+extern "C" void WDT_vect(void);
+
+static PowerManager power;
+static unsigned long idleMs, downMs, radioMs;
+static unsigned long radioSince, radioClose;
+static bool radioOn;
+
+static void
+sleeping(uint8_t mode)
+{
+  uint8_t wdto;
+  if (mode == SLEEP_MODE_IDLE) {
+    // Until the next timer0 interrupt
+    hostMillis++;
+    idleMs++;
+    return;
+  }
+  wdto = (WDTCSR & 0x07) | ((WDTCSR & _BV(WDP3)) ? 0x08 : 0);
+  downMs += 16UL << wdto;
+  WDT_vect();
+}
+
+static void
+radioPower(bool on)
+{
+  if (radioOn && ! on) {
+    radioMs += millis() - radioSince;
+  }
+  radioOn = on;
+  radioSince = millis();
+  power.radio(on);
+}
+
+static void
+networkScan(Task * me)
+{
+  delay(NETWORK_WORK_MS);
+}
+
+static void
+sensorScan(Task * me)
+{
+  delay(SENSOR_WORK_MS);
+}
+
+static void
+radioWindow(Task * me)
+{
+  radioPower(true);
+  radioClose = millis() + RADIO_WINDOW_MS;
+}
+
+static Task network(NETWORK_LOOP_MS, networkScan);
+static Task sensor(SENSOR_LOOP_MS, sensorScan);
+static Task window(RADIO_SLEEP_MS, radioWindow);
+
+// Average current in uA over an hour: the estimate, and the exact figure
+static void
+run(bool relay, unsigned long * estimate, double * exact)
+{
+  unsigned long start;
+  unsigned long total;
+  double ua;
+
+  idleMs = downMs = radioMs = 0;
+  radioOn = false;
+  radioClose = 0;
+  power.add(&network);
+  power.add(&sensor);
+  if (relay) {
+    power.remove(&window);
+  } else {
+    power.add(&window);
+  }
+  radioPower(relay);
+  power.resetStats();
+  start = millis();
+  while (millis() - start < HOUR_MS) {
+    SoftTimer.run();
+    if (radioOn && ! relay && (long)(millis() - radioClose) >= 0) {
+      radioPower(false);
+    }
+    power.sleep();
+  }
+  total = millis() - start;
+  *estimate = power.estimateMicroAmps();
+  if (radioOn) {
+    radioMs += millis() - radioSince;
+  }
+  ua = (double)(total - idleMs - downMs) * POWER_ACTIVE_UA
+    + (double)idleMs * POWER_IDLE_UA
+    + (double)downMs * POWER_DOWN_UA
+    + (double)radioMs * POWER_RADIO_ON_UA
+    + (double)(total - radioMs) * POWER_RADIO_OFF_UA;
+  *exact = ua / total + POWER_BOARD_UA;
+  printf("%s: %lu uA estimated, %.1f exact, awake %.2f%% radio %.2f%%\n",
+    relay ? "relay" : "leaf", *estimate, *exact,
+    100.0 * (total - idleMs - downMs) / total, 100.0 * radioMs / total);
+}
+
+int
+main(void)
+{
+  unsigned long relay, leaf;
+  double relayExact, leafExact;
+
+  hostSleep = sleeping;
+
+  // A task due in 600ms, with one 400ms through its period
+  Task due(1000, networkScan);
+  power.add(&due);
+  hostMillis += 400;
+  CHECK(power.nextDue() == 600);
+  power.remove(&due);
+
+  hostAnalog[0] = 512;
+  CHECK(power.batteryMillivolts(0, 6600) == 3303);
+
+  run(true, &relay, &relayExact);
+  CHECK(fabs(relay - relayExact) <= relayExact / 100 + 1);
+  CHECK(relay > POWER_RADIO_ON_UA);
+
+  run(false, &leaf, &leafExact);
+  CHECK(fabs(leaf - leafExact) <= leafExact / 100 + 1);
+  CHECK(leaf < relay / 10);
+
+  // Counts start again from resetStats()
+  power.resetStats();
+  hostMillis += 1000;
+  CHECK(power.estimateMicroAmps() == POWER_ACTIVE_UA + POWER_RADIO_OFF_UA + POWER_BOARD_UA);
+  return checkFailures("power_estimate");
+}
@@ -0,0 +1,125 @@
+/*
+ * Fragmented Saki messages between two managers: delivery with and
+ * without loss, and after either end restarts.
+ */
+
+#include <deque>
+#include <string>
+#define protected public
+#include <SakiCore.h>
+#include "host/check.h"
+#include "saki_loopback.h"
+
+static std::string received;
+static int deliveries;
+
+static void
+big(const char ** args)
+{
+  received.clear();
+  for (const char ** p = args; *p; p++) {
+    if (p != args) {
+      received += ":";
+    }
+    received += *p;
+  }
+  deliveries++;
+}
+
+static std::string
+bigMessage(int n)
+{
+  std::string msg = "BG";
+  char item[16];
+  for (int i = 0; i < n; i++) {
+    snprintf(item, sizeof(item), ":%d", i * 7777777);
+    msg += item;
+  }
+  return msg;
+}
+
+int
+main(void)
+{
+  std::string msg = bigMessage(19);
+  srand(1);
+
+  {
+    SakiCore<LoopA> a("A", 0, 0, true);
+    SakiCore<LoopB> b("B", 0, 0, true);
+    a.start(loopPort);
+    b.start(loopPort);
+    b.registerHandler("BG", big);
+
+    // Whole, with no loss
+    a.send(msg.c_str());
+    loopRun(a, b, 2000);
+    CHECK(msg.size() > 150);
+    CHECK(deliveries == 1);
+    CHECK(received == msg);
+    CHECK(a._txBuf == NULL);
+
+    // Most get through 20% loss, and none are delivered twice
+    lossPercent = 20;
+    int good = 0;
+    deliveries = 0;
+    for (int i = 0; i < 50; i++) {
+      std::string m = bigMessage(10 + i % 10);
+      received.clear();
+      a.send(m.c_str());
+      loopRun(a, b, 6000);
+      good += received == m;
+    }
+    printf("20%% loss: %d/50 delivered\n", good);
+    CHECK(good >= 45);
+    CHECK(deliveries <= 50);
+    lossPercent = 0;
+  }
+
+  // The sender restarts: its sequence carries on from the last one
+  {
+    SakiCore<LoopB> b("B", 0, 0, true);
+    b.start(loopPort);
+    b.registerHandler("BG", big);
+    uint8_t seq;
+    {
+      SakiCore<LoopA> a("A", 0, 0, true);
+      a.start(loopPort);
+      a.send(msg.c_str());
+      loopRun(a, b, 2000);
+      seq = a._txSeq;
+    }
+    SakiCore<LoopA> a("A", 0, 0, true);
+    a.start(loopPort);
+    CHECK(a._txSeq == seq);
+    deliveries = 0;
+    a.send(msg.c_str());
+    loopRun(a, b, 2000);
+    CHECK(deliveries == 1);
+
+    // Or powers up on the very sequence last used: taken once the
+    // last message is too old to be a resend
+    a._txSeq = b._rxSeq - 1;
+    hostMillis += SAKI_FRAGMENT_TIMEOUT * (SAKI_FRAGMENT_RETRIES + 1) + 1;
+    deliveries = 0;
+    a.send(msg.c_str());
+    loopRun(a, b, 2000);
+    CHECK(deliveries == 1);
+    CHECK(received == msg);
+  }
+
+  // The receiver restarts, and the next sequence is the one it starts on
+  {
+    SakiCore<LoopA> a("A", 0, 0, true);
+    SakiCore<LoopB> b("B", 0, 0, true);
+    a.start(loopPort);
+    b.start(loopPort);
+    b.registerHandler("BG", big);
+    a._txSeq = b._rxSeq - 1;
+    deliveries = 0;
+    a.send(msg.c_str());
+    loopRun(a, b, 2000);
+    CHECK(deliveries == 1);
+  }
+  return checkFailures("saki_fragment");
+}
@@ -0,0 +1,70 @@
+#ifndef _SAKI_LOOPBACK_H
+#define _SAKI_LOOPBACK_H
+
+#include <deque>
+#include <string>
+#include <stdlib.h>
+
+/*
+ * Two Saki managers wired back to back.  Transport A talks to B and
+ * B to A, dropping lossPercent of the frames at random.
+ */
+
+typedef std::deque<std::string> frame_queue_t;
+static frame_queue_t loopToA, loopToB;
+static int lossPercent;
+static unsigned long loopFrames;
+
+template <int Side>
+class LoopTransport {
+  public:
+    static const uint8_t payload = 24;
+    saki_health_t health;
+
+    template <class Port> void begin(Port &) {}
+    void sendController(const char * frame, uint8_t len) { _put(frame, len); }
+    void sendRespondant(const char * frame, uint8_t len) { _put(frame, len); }
+    void respondant(char * buf) { strcpy(buf, Side ? "A" : "B"); }
+    int receive(char * buf, int size) {
+      frame_queue_t & in = Side ? loopToB : loopToA;
+      if (in.empty()) {
+        return -1;
+      }
+      int len = in.front().size();
+      if (len >= size) {
+        len = size - 1;
+      }
+      memcpy(buf, in.front().data(), len);
+      buf[len] = 0;
+      in.pop_front();
+      return len;
+    }
+
+  private:
+    void _put(const char * frame, uint8_t len) {
+      loopFrames++;
+      if (rand() % 100 < lossPercent) {
+        return;
+      }
+      (Side ? loopToA : loopToB).push_back(std::string(frame, len));
+    }
+};
+
+typedef LoopTransport<0> LoopA;
+typedef LoopTransport<1> LoopB;
+
+// Runs both managers, stepping the clock, for up to ms
+template <class A, class B>
+static void
+loopRun(A & a, B & b, unsigned long ms)
+{
+  for (unsigned long t = 0; t < ms; t += 20) {
+    a.check();
+    b.check();
+    hostMillis += 20;
+  }
+}
+
+static int loopPort;
+
+#endif // _SAKI_LOOPBACK_H
@@ -0,0 +1,140 @@
+/*
+ * SakiStaticManager soak: a node reports three inputs and an output
+ * to a controller, which changes its config and asks for it back
+ * every tenth report.  Every report must arrive intact, the config
+ * must follow, and neither end may touch the heap.
+ *
+ * Linked with --wrap=malloc,--wrap=realloc so calls from the Saki
+ * code are counted.  Runs 20000 reports by default; give a count to
+ * soak longer, e.g. ./saki_static_soak 2000000.
+ */
+
+#include <deque>
+#include <string>
+#define protected public
+#include <SakiCore.h>
+#include "host/check.h"
+#include "saki_loopback.h"
+
+static long heapCalls;
+static bool counting;
+
+extern "C" void * __real_malloc(size_t size);
+extern "C" void * __real_realloc(void * ptr, size_t size);
+
+extern "C" void *
+__wrap_malloc(size_t size)
+{
+  heapCalls += counting;
+  return __real_malloc(size);
+}
+
+extern "C" void *
+__wrap_realloc(void * ptr, size_t size)
+{
+  heapCalls += counting;
+  return __real_realloc(ptr, size);
+}
+
+static long reports, configs, bad;
+static std::string expected;
+
+static void
+received(const char ** args)
+{
+  std::string msg;
+  for (const char ** p = args; *p; p++) {
+    if (p != args) {
+      msg += ":";
+    }
+    msg += *p;
+  }
+  if ( ! strcmp(args[0], "SX")) {
+    reports++;
+    if (msg != expected && ++bad < 5) {
+      printf("got %s\n  not %s\n", msg.c_str(), expected.c_str());
+    }
+  } else if ( ! strcmp(args[0], "CF")) {
+    configs++;
+  } else {
+    bad++;
+    printf("unexpected %s\n", msg.c_str());
+  }
+}
+
+// Runs both ends until nothing is left in flight
+template <class A, class B>
+static void
+settle(A & a, B & b)
+{
+  for (int i = 0; i < 500; i++) {
+    a.check();
+    b.check();
+    hostMillis += 20;
+    if (i >= 2 && loopToA.empty() && loopToB.empty() && ! a._txBuf && ! b._txBuf) {
+      break;
+    }
+  }
+}
+
+int
+main(int argc, char ** argv)
+{
+  long n = argc > 1 ? atol(argv[1]) : 20000;
+  SakiStaticCore<LoopA, 6, 3, 1, 6> a("A", true);
+  SakiStaticCore<LoopB, 5, 0, 0, 4> b("B", true);
+  char buf[64];
+  char values[3][NUM_FORMAT_MAX];
+
+  a.start(loopPort);
+  b.start(loopPort);
+  b.registerDefaultHandler(received);
+  b.registerHandler("CF", received);
+  a.windowStats(true);
+  a.getConfig()->setDefault("C1", 1);
+  a.getConfig()->setDefault("C2", -2000000);
+  // The wrap is in place
+  counting = true;
+  free(malloc(1));
+  CHECK(heapCalls == 1);
+  heapCalls = 0;
+
+  // Every counter in its own place
+  saki_health_t health = { 1, 2, 3, 4, 5, 6, 65535, 255 };
+  char hl[SAKI_HEALTH_MESSAGE];
+  a._formatHealth(hl, &health);
+  CHECK( ! strcmp(hl, "HL:1:2:3:4:5:6:65535:255"));
+
+  for (long i = 0; i < n; i++) {
+    long v = (i * 7919) % 2000001 - 1000000;
+    std::string e = "SX:3:1";
+    for (int k = 0; k < 3; k++) {
+      a.setAnalogInput(k, v + k, 2);
+      formatFixed(values[k], v + k, 2);
+      e = e + ":" + values[k] + "/" + values[k] + "/" + values[k] + "/" + values[k] + "/1";
+    }
+    a.setDigitalOutput(0, i & 1);
+    // Past capacity, ignored
+    a.setAnalogInput(7, 1, 0);
+    expected = e + ((i & 1) ? ":Y" : ":N");
+    a.report();
+    settle(a, b);
+    if (i % 10 == 0) {
+      snprintf(buf, sizeof(buf), "CF:C1:%ld:C3:%ld", i, -i);
+      b.send(buf);
+      b.send("CF?");
+      settle(a, b);
+    }
+  }
+  counting = false;
+
+  printf("%ld reports, %ld configs, %lu frames, %ld heap calls\n",
+    reports, configs, loopFrames, heapCalls);
+  CHECK(reports == n);
+  CHECK(configs == (n + 9) / 10);
+  CHECK(bad == 0);
+  CHECK(heapCalls == 0);
+  CHECK(a.getConfig()->get("C1") == (n - 1) / 10 * 10);
+  CHECK(a.getConfig()->count() == 3);
+  return checkFailures("saki_static_soak");
+}
@@ -0,0 +1,213 @@
+/*
+ * SlotSchedule: the post-order slot mapping, the slot window across
+ * the end of a superframe, and how often frames collide as the
+ * network grows, with and without slots.
+ *
+ * The simulation has every node send one frame toward 00 per
+ * superframe, and each relay on the way forward it straight away,
+ * so a frame holds the air for AIR_TICKS per hop.  All nodes are
+ * taken to hear each other, which is the worst case.  Unslotted
+ * nodes send at random times; slotted nodes send at the start of
+ * their slot plus a random clock error, once within the guard time
+ * and once with an error larger than the guard.  Nodes are added
+ * breadth first, 01-05 then 011-055 and so on.  Times are in
+ * TICK_US units.
+ */
+
+#include <SlotSchedule.h>
+#include "host/check.h"
+
+#define DEPTH 3
+#define MAX_NODES 155
+#define ROUNDS 20
+#define TICK_US 100
+// A 32 byte frame with its auto ack and turnaround, per hop
+#define AIR_TICKS 10
+
+typedef struct _frame {
+  uint16_t start;
+  uint8_t hops;
+} frame_t;
+
+static SlotSchedule schedule(DEPTH);
+static uint16_t addresses[MAX_NODES];
+static frame_t frames[MAX_NODES];
+static uint16_t frameTicks;
+static uint16_t slotTicks;
+
+static uint8_t
+hops(uint16_t address)
+{
+  uint8_t n = 0;
+  while (address) {
+    n++;
+    address >>= 3;
+  }
+  return n;
+}
+
+// Breadth first, the order a network tends to grow in
+static void
+listAddresses(void)
+{
+  uint16_t n = 0;
+  uint16_t first = 0;
+  uint16_t last;
+  uint8_t digit;
+  for (digit = 1; digit <= SLOT_FANOUT; digit++) {
+    addresses[n++] = digit;
+  }
+  for (uint8_t level = 1; level < DEPTH; level++) {
+    last = n;
+    for (uint16_t p = first; p < last; p++) {
+      for (digit = 1; digit <= SLOT_FANOUT; digit++) {
+        addresses[n++] = addresses[p] | (digit << (3 * level));
+      }
+    }
+    first = last;
+  }
+}
+
+static int
+byStart(const void * a, const void * b)
+{
+  uint16_t sa = ((const frame_t *)a)->start;
+  uint16_t sb = ((const frame_t *)b)->start;
+  return sa < sb ? -1 : sa > sb;
+}
+
+// Frames overlapping any other, after sorting by start time
+static uint16_t
+collisions(uint16_t count)
+{
+  uint16_t n = 0;
+  unsigned long end;
+  unsigned long latest = 0;
+  qsort(frames, count, sizeof(frame_t), byStart);
+  for (uint16_t i = 0; i < count; i++) {
+    end = frames[i].start + (unsigned long)frames[i].hops * AIR_TICKS;
+    if ((i && latest > frames[i].start)
+        || (i + 1 < count && frames[i + 1].start < end)) {
+      n++;
+    }
+    if (end > latest) {
+      latest = end;
+    }
+  }
+  return n;
+}
+
+static uint16_t
+unslotted(uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++) {
+    frames[i].start = random(frameTicks);
+    frames[i].hops = hops(addresses[i]);
+  }
+  return collisions(count);
+}
+
+static uint16_t
+slotted(uint16_t count, int errorMs)
+{
+  long error = errorMs * 1000L / TICK_US;
+  long start;
+  for (uint16_t i = 0; i < count; i++) {
+    start = (long)schedule.slotFor(addresses[i]) * slotTicks
+      + SLOT_GUARD_MS * 1000L / TICK_US + random(-error, error + 1);
+    frames[i].start = (start + frameTicks) % frameTicks;
+    frames[i].hops = hops(addresses[i]);
+  }
+  return collisions(count);
+}
+
+// Percentages of frames colliding: unslotted, slotted, drifted
+static void
+simulate(uint16_t count, double * percent)
+{
+  unsigned long hit[3] = { 0, 0, 0 };
+  for (uint8_t r = 0; r < ROUNDS; r++) {
+    hit[0] += unslotted(count);
+    hit[1] += slotted(count, SLOT_GUARD_MS - 1);
+    hit[2] += slotted(count, SLOT_MS / 2);
+  }
+  for (int i = 0; i < 3; i++) {
+    percent[i] = 100.0 * hit[i] / ((unsigned long)count * ROUNDS);
+  }
+}
+
+int
+main(void)
+{
+  // Post-order at depth 2: 011-051 then 01 take slots 0-5
+  SlotSchedule two(2, 20, 3);
+  CHECK(two.slots() == 31);
+  CHECK(two.slotFor(01) == 5);
+  CHECK(two.slotFor(011) == 0);
+  CHECK(two.slotFor(021) == 1);
+  CHECK(two.slotFor(051) == 4);
+  CHECK(two.slotFor(02) == 11);
+  CHECK(two.slotFor(055) == 28);
+  CHECK(two.slotFor(05) == 29);
+  CHECK(two.slotFor(00) == two.slots() - 1);
+  CHECK(two.slotFor(0111) == SLOT_NONE);
+  CHECK(two.slotFor(06) == SLOT_NONE);
+  CHECK(two.slotFor(010) == SLOT_NONE);
+
+  // Unsynced, always free to send
+  two.begin(011);
+  CHECK(two.inSlot());
+  CHECK(two.nextSlot() == 0);
+
+  // Slot 0 is open 3-17ms into a 620ms superframe
+  hostMillis = 5000;
+  two.sync(0);
+  CHECK(two.position() == 0);
+  CHECK( ! two.inSlot());
+  CHECK(two.nextSlot() == 3);
+  hostMillis += 610;
+  CHECK( ! two.inSlot());
+  CHECK(two.nextSlot() == 13);
+  CHECK(two.untilSlot() == 13);
+  hostMillis += 13;
+  CHECK(two.position() == 3);
+  CHECK(two.inSlot());
+  CHECK(two.untilSlot() == 0);
+  CHECK(two.nextSlot() == 620);
+  hostMillis += 13;
+  CHECK(two.inSlot());
+  hostMillis += 1;
+  CHECK( ! two.inSlot());
+
+  // 00's slot is the last, open 603-617ms, so the wait runs over the end
+  SlotSchedule base(2, 20, 3);
+  base.begin(00);
+  base.sync(0);
+  hostMillis += 620 - base.position() + 615;
+  CHECK(base.inSlot());
+  hostMillis += 4;
+  CHECK(base.position() == 619);
+  CHECK( ! base.inSlot());
+  CHECK(base.nextSlot() == 604);
+
+  // Superframes start on whole epoch seconds: 1000s is 560ms in
+  base.sync(1000);
+  CHECK(base.position() == 560);
+
+  uint16_t sizes[] = { 5, 10, 20, 30, 60, 100, MAX_NODES };
+  double percent[3];
+  srand(1);
+  slotTicks = SLOT_MS * 1000L / TICK_US;
+  frameTicks = schedule.superframe() * 1000L / TICK_US;
+  listAddresses();
+  printf("Superframe %lums, %u slots\n", schedule.superframe(), schedule.slots());
+  printf("nodes unslotted  slotted  drifted\n");
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    simulate(sizes[i], percent);
+    printf("%5u %8.1f%% %7.1f%% %7.1f%%\n", sizes[i], percent[0], percent[1], percent[2]);
+  }
+  // Within the guard nothing overlaps, and even drifted beats unslotted
+  CHECK(percent[1] == 0);
+  CHECK(percent[2] < percent[0] / 4);
+  return checkFailures("slot_schedule");
+}
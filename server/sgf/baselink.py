@@ -0,0 +1,172 @@
+"""
+    Host end of the RF24Network base station sketch
+    (arduino/sketches/BaseStation), see HostLink.h for the framing.
+
+    Frames are COBS encoded, end in a zero byte and carry a
+    CRC-16/CCITT, high byte first.  Batches of records come in and
+    the callback is called with a dict for each record:
+      from    node address
+      type    frame type character
+      millis  base station clock when it arrived
+      time    the same as a host timestamp, estimated
+      data    the frame
+    A credit is returned for every batch taken.
+
+    Relays built with AGGREGATE send 'p' frames packing the status
+    of several nodes (packed_status_t in NetworkSensor/message.h).
+    Each entry comes out as an 's' record from the node it is for,
+    its data the message_t that node would have sent, with 'via'
+    set to the relay it arrived from.
+"""
+import binascii
+import struct
+import threading
+import time
+
+RECORD = 6
+PACKED = 6
+PACKED_NODE = 0x0fff
+PACKED_TIMED = 0x4000
+PACKED_RELAY = 0x8000
+
+def crc(data):
+    return binascii.crc_hqx(data, 0xffff)
+
+def cobs_encode(data):
+    out = ''
+    for block in data.split('\x00'):
+        while len(block) >= 254:
+            out += '\xff' + block[:254]
+            block = block[254:]
+        out += chr(len(block) + 1) + block
+    return out
+
+def cobs_decode(data):
+    out = ''
+    i = 0
+    while i < len(data):
+        code = ord(data[i])
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS frame")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xff and i < len(data):
+            out += '\x00'
+    return out
+
+class BaseLink(object):
+    def __init__(self, serial_obj, callback):
+        self.serial = serial_obj
+        self.callback = callback
+        self.bad_frames = 0
+        self.lost_batches = 0
+        self.seq = None
+        self.start = None
+        # Host time less base time, the smallest seen so the delay
+        # in batching and sending is mostly taken out
+        self.offset = None
+        self.lock = threading.Lock()
+        self.running = True
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def stop(self):
+        self.running = False
+        self.thread.join()
+
+    def run(self):
+        buf = ''
+        while self.running:
+            data = self.serial.read(self.serial.inWaiting() or 1)
+            for c in data:
+                if c == '\x00':
+                    self.frame(buf)
+                    buf = ''
+                else:
+                    buf += c
+
+    def frame(self, encoded):
+        try:
+            data = cobs_decode(encoded)
+        except ValueError:
+            data = ''
+        if len(data) < 3 or crc(data) != 0:
+            self.bad_frames += 1
+            return
+        data = data[:-2]
+        if data[0] == 'B' and len(data) >= 6:
+            self.batch(data)
+
+    def batch(self, data):
+        received = time.time()
+        seq, start = struct.unpack('<BI', data[1:6])
+        if self.start is not None and start < self.start:
+            # The base clock went back: either millis() wrapped, and
+            # the offset moves on 49.7 days, or the base restarted,
+            # and its batches start again from 0
+            self.offset = None
+            if self.start - start < 0x80000000:
+                self.seq = None
+        self.start = start
+        if self.seq is not None and seq != (self.seq + 1) & 0xff:
+            self.lost_batches += (seq - self.seq - 1) & 0xff
+        self.seq = seq
+        self.send_frame('A' + chr(1))
+        records = []
+        body = data[6:]
+        i = 0
+        while i + RECORD <= len(body):
+            node, ftype, at, length = struct.unpack('<HcHB', body[i:i + RECORD])
+            record = {
+                'from': node,
+                'type': ftype,
+                'millis': (start + at) & 0xffffffff,
+                'data': body[i + RECORD:i + RECORD + length],
+            }
+            if ftype == 'p':
+                records.extend(self.unpack(record))
+            else:
+                records.append(record)
+            i += RECORD + length
+        if records:
+            offset = received - records[-1]['millis'] / 1000.0
+            if self.offset is None or offset < self.offset:
+                self.offset = offset
+        for record in records:
+            record['time'] = self.offset + record['millis'] / 1000.0
+            self.callback(record)
+
+    def unpack(self, record):
+        """ Split a 'p' record into an 's' record for each node """
+        data = record['data']
+        for i in range(0, len(data) - PACKED + 1, PACKED):
+            node, value, value_2 = struct.unpack('<HHH', data[i:i + PACKED])
+            yield {
+                'from': node & PACKED_NODE,
+                'via': record['from'],
+                'type': 's',
+                'millis': record['millis'],
+                'data': struct.pack('<IHHHHHH', 0, 1, value, value_2,
+                                    int(bool(node & PACKED_TIMED)),
+                                    int(bool(node & PACKED_RELAY)), 0),
+            }
+
+    def send_frame(self, data):
+        with self.lock:
+            self.serial.write(cobs_encode(data + struct.pack('>H', crc(data))) + '\x00')
+
+    def write(self, node, ftype, data):
+        """ Send data to node as a frame of type ftype """
+        self.send_frame('W' + struct.pack('<Hc', node, ftype) + data)
+
+    def send_config(self, node, item, value):
+        self.write(node, 'c', struct.pack('<III', 1, ord(item), value))
+
+    def send_time(self, node):
+        """ Nodes align their slots to the second, so send on one """
+        now = time.time()
+        time.sleep(1 - (now - int(now)))
+        self.send_config(node, 't', int(time.time() + 0.5))
+
+# vim:ai sw=4 expandtab:
@@ -13,6 +13,24 @@ import xbee
 import serial
 import time
 import sys
+from sgf import fragment
+
+def config_hash(items):
+    """ Saki config hash: sum of the CRC16 of each key and value """
+    total = 0
+    for key, value in items.items():
+        crc = 0xffff
+        data = [ord(c) for c in key[:2].ljust(2, '\x00')]
+        data += [(value >> (8 * i)) & 0xff for i in range(4)]
+        for byte in data:
+            crc ^= byte
+            for bit in range(8):
+                if crc & 1:
+                    crc = (crc >> 1) ^ 0xa001
+                else:
+                    crc >>= 1
+        total += crc
+    return total & 0xffff
 
 class ZigBee(object):
     zigbee = None
@@ -21,9 +39,11 @@ class ZigBee(object):
     process_list = {
         'ID': 'handle_id_response',
         'ST': 'handle_status',
+        'SX': 'handle_status',
         'NK': 'handle_nak',
         'ER': 'handle_error',
         'CF': 'handle_config',
+        'CG': 'handle_config_changes',
     }
 
     # top level handlers are based on the node ID
@@ -47,6 +67,11 @@ class ZigBee(object):
 
     def __init__(self, serial_obj):
         self.zigbee = xbee.ZigBee(serial_obj, callback=self.handler)
+        # Per node fragment handling, keyed by long address
+        self.reassemblers = {}
+        self.senders = {}
+        # Config as last seen, with its generation, keyed by address
+        self.configs = {}
 
     def handle_response(self,source, args):
         if args[1] in self.response_list:
@@ -91,6 +116,34 @@ class ZigBee(object):
             node_id = "UNKNOWN"
         print node_id, ": CF:", args
 
+    def handle_config_changes(self, source, args):
+        """ CG:generation:hash, then the items changed since the
+        generation asked for """
+        if source in self.discovered:
+            node_id = self.discovered[source]['node_id']
+        else:
+            node_id = "UNKNOWN"
+        generation = int(args[1])
+        node_hash = int(args[2])
+        changes = dict(zip(args[3::2], [int(v) for v in args[4::2]]))
+        config = self.configs.setdefault(source, {'generation': 0, 'items': {}})
+        if config['generation'] == 0:
+            config['items'] = {}
+        config['items'].update(changes)
+        if config_hash(config['items']) != node_hash:
+            # Missed a change, or the node restarted; ask for it all
+            print node_id, ": CF out of step, refreshing"
+            config['generation'] = 0
+            config['items'] = {}
+            if source in self.discovered:
+                self.send_message(self.discovered[source], "CF?:0")
+            return
+        config['generation'] = generation
+        if changes:
+            print node_id, ": CF:", changes
+        else:
+            print node_id, ": CF unchanged"
+
     def handle_on_response(self, source, args):
         if source in self.discovered:
             node_id = self.discovered[source]['node_id']
@@ -158,10 +211,24 @@ class ZigBee(object):
             self.send("tx", data="ID?", dest_addr = data['source_addr'], dest_addr_long = data['source_addr_long'])
 
     def read_data(self, data):
-        args = data['rf_data'].split(':')
+        rf_data = data['rf_data']
         source_addr = '\x00\x00'
         if 'source_addr' in data:
             source_addr = data['source_addr']
+        source_long = data.get('source_addr_long')
+        if fragment.is_ack(rf_data):
+            if source_long in self.senders:
+                self.senders[source_long].ack(rf_data)
+            return
+        if fragment.is_fragment(rf_data):
+            if source_long not in self.reassemblers:
+                self.reassemblers[source_long] = fragment.Reassembler()
+            ack, rf_data = self.reassemblers[source_long].add(rf_data)
+            if ack:
+                self.send("tx", data=ack, dest_addr=source_addr, dest_addr_long=source_long)
+            if rf_data is None:
+                return
+        args = rf_data.split(':')
         if args[0] in self.process_list:
             method = getattr(self, self.process_list[args[0]])
             method(source_addr, args)
@@ -200,6 +267,16 @@ class ZigBee(object):
     def send(self, cmd, **data):
         self.zigbee.send(cmd, **data)
 
+    def send_message(self, node, data):
+        """ Send a Saki message to a discovered node, in fragments if need be """
+        addr = node['source_addr']
+        addr_long = node['source_addr_long']
+        if addr_long not in self.senders:
+            def send_frame(frame):
+                self.send("tx", data=frame, dest_addr=addr, dest_addr_long=addr_long)
+            self.senders[addr_long] = fragment.Sender(send_frame)
+        self.senders[addr_long].send(data)
+
     def send_at(self, data):
         self.zigbee.send('at', command=data)
 
@@ -213,20 +290,26 @@ class ZigBee(object):
     def request(self, cmd):
         for target in self.discovered:
             print  cmd, "> ", self.discovered[target]['node_id']
-            self.send("tx", data=cmd, dest_addr = self.discovered[target]['source_addr'], dest_addr_long = self.discovered[target]['source_addr_long'])
+            self.send_message(self.discovered[target], cmd)
             time.sleep(1)
 
     def request_from(self, node, cmd):
         for target in self.discovered:
             if node in self.discovered[target]['node_id']:
                 print  cmd, "> ", self.discovered[target]['node_id']
-                self.send("tx", data=cmd, dest_addr = self.discovered[target]['source_addr'], dest_addr_long = self.discovered[target]['source_addr_long'])
+                self.send_message(self.discovered[target], cmd)
 
     def request_status(self, data):
         self.request("ST?")
 
     def request_config(self, data):
-        self.request("CF?")
+        """ Ask each node for its config changes since we last looked """
+        for target in self.discovered:
+            config = self.configs.get(target, {'generation': 0})
+            cmd = "CF?:%d" % config['generation']
+            print  cmd, "> ", self.discovered[target]['node_id']
+            self.send_message(self.discovered[target], cmd)
+            time.sleep(1)
 
     def request_id(self, data):
         self.request("ID?")
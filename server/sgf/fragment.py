@@ -0,0 +1,164 @@
+"""
+    Saki message fragmentation, matching SakiCore.h on the nodes.
+
+    Messages longer than one frame are split into fragments, each
+    with a 6 byte header: FRAGMENT, or FRAGMENT_LAST when an ack is
+    wanted, the message sequence, then the offset and total length
+    as little endian 16 bit values.  The receiver acks with
+    FRAGMENT_ACK, the sequence and the offset it expects next, and
+    only takes fragments in order.
+
+    The sender sends WINDOW fragments at a time, asking for an ack
+    on the last, and carries on from wherever the ack says.  With no
+    ack in TIMEOUT seconds it goes back to the last offset acked,
+    giving up after RETRIES.
+
+    Either end may restart and begin its sequence again, so the
+    sender starts from a random sequence, and the receiver takes the
+    start of a message with the last sequence once the last message
+    is too old to still be being resent.
+"""
+import random
+import struct
+import threading
+import time
+
+FRAGMENT = '\x1f'
+FRAGMENT_LAST = '\x1d'
+FRAGMENT_ACK = '\x1e'
+HEADER = 6
+# Must not be more than the nodes' SAKI_XBEE_PAYLOAD
+PAYLOAD = 72
+WINDOW = 4
+TIMEOUT = 1.0
+RETRIES = 3
+MAX_MESSAGE = 4096
+# How long a sender keeps resending a message before giving up
+SPAN = TIMEOUT * (RETRIES + 1)
+
+def is_fragment(data):
+    return data[:1] in (FRAGMENT, FRAGMENT_LAST)
+
+def is_ack(data):
+    return data[:1] == FRAGMENT_ACK and len(data) >= 4
+
+class Reassembler(object):
+    """ Rebuilds the messages from one sender """
+    def __init__(self):
+        self.seq = None
+        self.total = 0
+        self.data = ''
+        self.time = 0
+
+    def add(self, frame):
+        """
+            Returns the ack to send back (or None) and the completed
+            message (or None).
+        """
+        if len(frame) <= HEADER:
+            return None, None
+        seq, offset, total = struct.unpack('<BHH', frame[1:HEADER])
+        now = time.time()
+        stale = now - self.time > SPAN
+        if offset == 0 and (seq != self.seq or stale):
+            self.seq = seq
+            self.time = now
+            self.total = total
+            self.data = ''
+            if total > MAX_MESSAGE:
+                # Refused, ack it as done so the sender stops
+                self.data = None
+        message = None
+        if (seq == self.seq and self.data is not None
+                and offset == len(self.data) and total == self.total
+                and offset < total):
+            self.data += frame[HEADER:]
+            self.time = now
+            if len(self.data) >= total:
+                message = self.data[:total]
+        ack = None
+        if frame[0] == FRAGMENT_LAST:
+            if seq != self.seq:
+                done = 0
+            elif self.data is None:
+                done = self.total
+            else:
+                done = len(self.data)
+            ack = FRAGMENT_ACK + struct.pack('<BH', seq, done)
+        return ack, message
+
+class Sender(object):
+    """
+        Sends one message at a time to one destination.  send_frame
+        is called with each frame to go out.
+    """
+    def __init__(self, send_frame):
+        self.send_frame = send_frame
+        self.seq = random.randint(0, 0xff)
+        self.message = None
+        self.acked = 0
+        self.tries = 0
+        self.timer = None
+        self.lock = threading.Lock()
+
+    def send(self, message):
+        if len(message) <= PAYLOAD:
+            self.send_frame(message)
+            return
+        with self.lock:
+            self.seq = (self.seq + 1) & 0xff
+            self.message = message
+            self.acked = 0
+            self.tries = 0
+            self._window()
+
+    def ack(self, frame):
+        seq, offset = struct.unpack('<BH', frame[1:4])
+        with self.lock:
+            if self.message is None or seq != self.seq or offset <= self.acked:
+                return
+            if offset >= len(self.message):
+                self._done()
+                return
+            self.acked = offset
+            self.tries = 0
+            self._window()
+
+    def _done(self):
+        self.message = None
+        if self.timer:
+            self.timer.cancel()
+            self.timer = None
+
+    def _timeout(self):
+        with self.lock:
+            if self.message is None:
+                return
+            self.tries += 1
+            if self.tries > RETRIES:
+                print "Fragmented message not acked"
+                self._done()
+                return
+            self._window()
+
+    def _window(self):
+        total = len(self.message)
+        offset = self.acked
+        size = PAYLOAD - HEADER
+        for n in range(1, WINDOW + 1):
+            if offset >= total:
+                break
+            chunk = self.message[offset:offset + size]
+            if n == WINDOW or offset + size >= total:
+                marker = FRAGMENT_LAST
+            else:
+                marker = FRAGMENT
+            self.send_frame(marker + struct.pack('<BHH', self.seq, offset, total) + chunk)
+            offset += len(chunk)
+        if self.timer:
+            self.timer.cancel()
+        self.timer = threading.Timer(TIMEOUT, self._timeout)
+        self.timer.daemon = True
+        self.timer.start()
+
+# vim:ai sw=4 expandtab:
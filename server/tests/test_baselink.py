@@ -0,0 +1,113 @@
+"""
+    sgf.baselink: batches across a base station restart and a
+    millis() wrap, and end to end against the BaseStation sketch
+    built for Linux (arduino/tests/basestation_host, from make
+    there) with a mocked RF24Network, over a pty.
+"""
+import os
+import select
+import struct
+import subprocess
+import time
+import unittest
+from sgf import baselink
+
+HARNESS = os.path.join(os.path.dirname(__file__), '..', '..',
+                       'arduino', 'tests', 'basestation_host')
+
+class NoSerial(object):
+    def inWaiting(self):
+        return 0
+    def read(self, n):
+        time.sleep(0.01)
+        return ''
+    def write(self, data):
+        pass
+
+class PtySerial(object):
+    def __init__(self, name):
+        self.fd = os.open(name, os.O_RDWR | os.O_NOCTTY)
+    def inWaiting(self):
+        return 0
+    def read(self, n):
+        ready, _, _ = select.select([self.fd], [], [], 0.1)
+        return os.read(self.fd, 4096) if ready else ''
+    def write(self, data):
+        os.write(self.fd, data)
+
+def batch(seq, start, count=1, frames=None):
+    """ An encoded batch of count records, or of frames as (node,
+    type, data), without the closing zero """
+    if frames is None:
+        frames = [(01, 's', 'x')] * count
+    data = 'B' + struct.pack('<BI', seq, start)
+    for i, (node, ftype, frame) in enumerate(frames):
+        data += struct.pack('<HcHB', node, ftype, i, len(frame)) + frame
+    return baselink.cobs_encode(data + struct.pack('>H', baselink.crc(data)))
+
+class BatchTest(unittest.TestCase):
+    def setUp(self):
+        self.records = []
+        self.link = baselink.BaseLink(NoSerial(), self.records.append)
+
+    def tearDown(self):
+        self.link.stop()
+
+    def test_lost(self):
+        self.link.frame(batch(1, 1000))
+        self.link.frame(batch(4, 2000))
+        self.assertEqual(self.link.lost_batches, 2)
+
+    def test_restart(self):
+        for seq in range(10, 13):
+            self.link.frame(batch(seq, 3600000 + seq))
+        self.link.frame(batch(0, 50))
+        self.link.frame(batch(1, 60))
+        self.assertEqual(self.link.lost_batches, 0)
+        # Timed from the new uptime, not an hour out
+        self.assertTrue(abs(self.records[-1]['time'] - time.time()) < 1)
+
+    def test_wrap(self):
+        self.link.frame(batch(7, 0xffffff00))
+        self.link.frame(batch(8, 0x100))
+        self.assertEqual(self.link.lost_batches, 0)
+        self.assertTrue(abs(self.records[-1]['time'] - time.time()) < 1)
+        self.link.frame(batch(10, 0x200))
+        self.assertEqual(self.link.lost_batches, 1)
+
+    def test_packed(self):
+        packed = struct.pack('<HHH', 011 | 0x8000, 250, 3)
+        packed += struct.pack('<HHH', 0111 | 0x4000, 180, 0)
+        self.link.frame(batch(0, 0, frames=[(01, 'p', packed), (01, 'h', 'y')]))
+        self.assertEqual([(r['from'], r['type'], r.get('via')) for r in self.records],
+                         [(011, 's', 01), (0111, 's', 01), (01, 'h', None)])
+        self.assertEqual(struct.unpack('<IHHHHHH', self.records[0]['data']),
+                         (0, 1, 250, 3, 0, 1, 0))
+        self.assertEqual(struct.unpack('<IHHHHHH', self.records[1]['data']),
+                         (0, 1, 180, 0, 1, 0, 0))
+
+class BaseStationTest(unittest.TestCase):
+    @unittest.skipUnless(os.path.exists(HARNESS), "make in arduino/tests first")
+    def test_pty(self):
+        base = subprocess.Popen([HARNESS, '2000'], stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE)
+        records = []
+        link = baselink.BaseLink(PtySerial(base.stdout.readline().strip()), records.append)
+        time.sleep(0.3)
+        link.write(0125, 'c', struct.pack('<III', 1, ord('l'), 32))
+        link.write(077, 'c', 'x' * 12)
+        base.wait()
+        link.stop()
+        counts = [struct.unpack('<I', r['data'][:4])[0] for r in records if r['type'] == 's']
+        failed = [r for r in records if r['type'] == '!']
+        self.assertEqual(counts, sorted(counts))
+        self.assertEqual(len(counts), len(set(counts)))
+        # Only what the base itself dropped is missing
+        dropped = int(base.stderr.read().split()[2])
+        self.assertEqual(len(counts) + dropped, 2000)
+        self.assertEqual(link.bad_frames, 0)
+        self.assertEqual(link.lost_batches, 0)
+        self.assertEqual([(r['from'], r['data']) for r in failed], [(0, struct.pack('<Hc', 077, 'c'))])
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,92 @@
+"""
+    sgf.fragment, a Sender and Reassembler back to back.
+
+    Run from server/ with: python -m unittest discover tests
+"""
+import random
+import unittest
+from sgf import fragment
+
+class Link(object):
+    """ Frames one way to a Reassembler, acks back, with loss """
+    def __init__(self, loss=0):
+        self.loss = loss
+        self.frames = []
+        self.sender = fragment.Sender(self.frames.append)
+        self.receiver = fragment.Reassembler()
+        self.messages = []
+
+    def run(self, rounds=60):
+        for i in range(rounds):
+            frames, self.frames[:] = self.frames[:], []
+            for frame in frames:
+                if random.randint(0, 99) < self.loss:
+                    continue
+                ack, message = self.receiver.add(frame)
+                if message:
+                    self.messages.append(message)
+                if ack and random.randint(0, 99) >= self.loss:
+                    self.sender.ack(ack)
+            if self.sender.message is None:
+                break
+            if not self.frames:
+                self.sender._timeout()
+        self.sender._done()
+
+def message(n):
+    return 'CF' + ''.join(':%s:%d' % (chr(65 + i % 26) * 2, i * 99991) for i in range(n))
+
+class FragmentTest(unittest.TestCase):
+    def setUp(self):
+        random.seed(1)
+        self.now = 1000.0
+        self._time = fragment.time
+        fragment.time = self
+        self.time = lambda: self.now
+
+    def tearDown(self):
+        fragment.time = self._time
+
+    def test_whole(self):
+        link = Link()
+        link.sender.send(message(30))
+        link.run()
+        self.assertEqual(link.messages, [message(30)])
+
+    def test_loss(self):
+        good = 0
+        for i in range(30):
+            link = Link(loss=20)
+            link.sender.send(message(30))
+            link.run()
+            self.assertTrue(len(link.messages) <= 1)
+            good += link.messages == [message(30)]
+        self.assertTrue(good >= 25, good)
+
+    def test_sender_restart(self):
+        link = Link()
+        link.sender.send(message(20))
+        link.run()
+        # A new sender that happens to start on the same sequence
+        seq = link.sender.seq
+        link.sender = fragment.Sender(link.frames.append)
+        link.sender.seq = (seq - 1) & 0xff
+        self.now += fragment.SPAN + 1
+        link.sender.send(message(25))
+        link.run()
+        self.assertEqual(link.messages, [message(20), message(25)])
+
+    def test_resend_not_duplicated(self):
+        link = Link()
+        link.sender.send(message(20))
+        # Deliver everything but drop the final ack, so it resends
+        for frame in link.frames[:]:
+            link.receiver.add(frame)
+        del link.frames[:]
+        link.sender._timeout()
+        for frame in link.frames[:]:
+            ack, m = link.receiver.add(frame)
+            self.assertEqual(m, None)
+
+if __name__ == '__main__':
+    unittest.main()